@@ -0,0 +1,522 @@
+#include "async_io.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace MyEd {
+    namespace {
+        int IoUringSetup(unsigned entries, io_uring_params *params) {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+            return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                                            nullptr, 0));
+        }
+
+        template<typename T>
+        T *RingField(void *ring, uint32_t offset) {
+            return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+        }
+    }
+
+    IoRing::IoRing() : m_ring_fd(-1), m_sq_ring(MAP_FAILED), m_sq_ring_size(0), m_cq_ring(MAP_FAILED),
+                       m_cq_ring_size(0), m_sqes(MAP_FAILED), m_sqes_size(0), m_sq_tail(nullptr),
+                       m_sq_mask(nullptr), m_sq_array(nullptr), m_cq_head(nullptr), m_cq_tail(nullptr),
+                       m_cq_mask(nullptr), m_cqes(nullptr), m_unsubmitted(0) {}
+
+    IoRing::~IoRing() {
+        if (m_sqes != MAP_FAILED) {
+            munmap(m_sqes, m_sqes_size);
+        }
+        if (m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring) {
+            munmap(m_cq_ring, m_cq_ring_size);
+        }
+        if (m_sq_ring != MAP_FAILED) {
+            munmap(m_sq_ring, m_sq_ring_size);
+        }
+        if (m_ring_fd >= 0) {
+            close(m_ring_fd);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    std::unique_ptr<IoRing> IoRing::Create(unsigned entries) {
+        std::unique_ptr<IoRing> ring(new IoRing());
+        io_uring_params params{};
+        ring->m_ring_fd = IoUringSetup(entries, &params);
+        if (ring->m_ring_fd < 0) {
+            return nullptr;
+        }
+
+        ring->m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            ring->m_sq_ring_size = ring->m_cq_ring_size = std::max(ring->m_sq_ring_size, ring->m_cq_ring_size);
+        }
+        ring->m_sq_ring = mmap(nullptr, ring->m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               ring->m_ring_fd, IORING_OFF_SQ_RING);
+        if (ring->m_sq_ring == MAP_FAILED) {
+            return nullptr;
+        }
+        if (single_mmap) {
+            ring->m_cq_ring = ring->m_sq_ring;
+        } else {
+            ring->m_cq_ring = mmap(nullptr, ring->m_cq_ring_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring->m_ring_fd, IORING_OFF_CQ_RING);
+            if (ring->m_cq_ring == MAP_FAILED) {
+                return nullptr;
+            }
+        }
+        ring->m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        ring->m_sqes = mmap(nullptr, ring->m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->m_ring_fd, IORING_OFF_SQES);
+        if (ring->m_sqes == MAP_FAILED) {
+            return nullptr;
+        }
+
+        ring->m_sq_tail = RingField<unsigned>(ring->m_sq_ring, params.sq_off.tail);
+        ring->m_sq_mask = RingField<unsigned>(ring->m_sq_ring, params.sq_off.ring_mask);
+        ring->m_sq_array = RingField<unsigned>(ring->m_sq_ring, params.sq_off.array);
+        ring->m_cq_head = RingField<unsigned>(ring->m_cq_ring, params.cq_off.head);
+        ring->m_cq_tail = RingField<unsigned>(ring->m_cq_ring, params.cq_off.tail);
+        ring->m_cq_mask = RingField<unsigned>(ring->m_cq_ring, params.cq_off.ring_mask);
+        ring->m_cqes = RingField<void>(ring->m_cq_ring, params.cq_off.cqes);
+        return ring;
+    }
+
+    void IoRing::PrepareRead(int fd, char *data, size_t size, uint64_t offset, uint64_t tag) {
+        Prepare_(IORING_OP_READ, fd, reinterpret_cast<uint64_t>(data), size, offset, tag);
+    }
+
+    void IoRing::PrepareWrite(int fd, const char *data, size_t size, uint64_t offset, uint64_t tag) {
+        Prepare_(IORING_OP_WRITE, fd, reinterpret_cast<uint64_t>(data), size, offset, tag);
+    }
+
+    int64_t IoRing::WaitCompletion(uint64_t &tag) {
+        while (true) {
+            unsigned head = *m_cq_head;
+            if (head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe &cqe = static_cast<const io_uring_cqe *>(m_cqes)[head & *m_cq_mask];
+                tag = cqe.user_data;
+                int64_t result = cqe.res;
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+                return result;
+            }
+            if (!Enter_(1)) {
+                throw std::runtime_error(AsyncIoConstant::EXCEPTION_MESSAGE_RING_FAILED);
+            }
+        }
+    }
+
+    void IoRing::Submit() {
+        if (m_unsubmitted != 0 && !Enter_(0)) {
+            throw std::runtime_error(AsyncIoConstant::EXCEPTION_MESSAGE_RING_FAILED);
+        }
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void IoRing::Prepare_(uint8_t opcode, int fd, uint64_t address, size_t size, uint64_t offset, uint64_t tag) {
+        // only this side moves the tail of the submission queue
+        unsigned tail = *m_sq_tail;
+        unsigned index = tail & *m_sq_mask;
+        io_uring_sqe &sqe = static_cast<io_uring_sqe *>(m_sqes)[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = address;
+        sqe.len = static_cast<uint32_t>(size);
+        sqe.off = offset;
+        sqe.user_data = tag;
+        m_sq_array[index] = index;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++m_unsubmitted;
+    }
+
+    bool IoRing::Enter_(unsigned min_complete) {
+        unsigned flags = min_complete != 0 ? IORING_ENTER_GETEVENTS : 0;
+        int submitted;
+        do {
+            submitted = IoUringEnter(m_ring_fd, m_unsubmitted, min_complete, flags);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < 0) {
+            return false;
+        }
+        m_unsubmitted -= std::min(static_cast<unsigned>(submitted), m_unsubmitted);
+        return true;
+    }
+
+    AsyncFileReader::AsyncFileReader(int fd, uint64_t offset)
+            : m_fd(fd), m_file_size(0), m_next_offset(offset), m_current(0),
+              m_block_capacity(AsyncIoConstant::REQUEST_SIZE) {
+        struct stat buffer{};
+        if (fstat(fd, &buffer) == 0 && S_ISREG(buffer.st_mode)) {
+            m_file_size = static_cast<uint64_t>(buffer.st_size);
+            m_ring = IoRing::Create(AsyncIoConstant::BLOCKS_IN_FLIGHT);
+            // no need for a megabyte to read a small file
+            uint64_t rest = m_file_size > offset ? m_file_size - offset : 0;
+            m_block_capacity = static_cast<size_t>(std::clamp<uint64_t>(rest, 1, m_block_capacity));
+            if (m_ring == nullptr && offset != 0) {
+                lseek(fd, static_cast<off_t>(offset), SEEK_SET);
+            }
+        }
+        m_blocks.resize(m_ring != nullptr ? AsyncIoConstant::BLOCKS_IN_FLIGHT : 1);
+        m_current = m_blocks.size();
+        if (m_ring != nullptr) {
+            for (size_t i = 0; i < m_blocks.size(); ++i) {
+                Request_(i);
+            }
+            m_ring->Submit();
+        }
+    }
+
+    AsyncFileReader::~AsyncFileReader() {
+        if (m_ring == nullptr) {
+            return;
+        }
+        try {
+            for (Block &block: m_blocks) {
+                while (block.pending) {
+                    uint64_t tag;
+                    m_ring->WaitCompletion(tag);
+                    m_blocks[tag].pending = false;
+                }
+            }
+        } catch (const std::runtime_error &) {
+            // the ring is unusable, closing it is all that is left
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    size_t AsyncFileReader::NextBlock(char *&data) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "AsyncFileReader::NextBlock");
+        if (m_ring == nullptr) {
+            Block &block = m_blocks.front();
+            if (block.data == nullptr) {
+                block.data = std::make_unique<char[]>(m_block_capacity);
+            }
+            ssize_t size;
+            do {
+                size = read(m_fd, block.data.get(), m_block_capacity);
+            } while (size < 0 && errno == EINTR);
+            if (size < 0) {
+                throw std::runtime_error(AsyncIoConstant::EXCEPTION_MESSAGE_READ_FAILED);
+            }
+            data = block.data.get();
+            return static_cast<size_t>(size);
+        }
+
+        // the caller is done with the block handed out last, it can read further on
+        size_t index = 0;
+        if (m_current < m_blocks.size()) {
+            m_blocks[m_current].requested = false;
+            Request_(m_current);
+            m_ring->Submit();
+            index = (m_current + 1) % m_blocks.size();
+        }
+        m_current = index;
+        Block &block = m_blocks[index];
+        if (!block.requested) {
+            return 0;
+        }
+        while (block.pending) {
+            uint64_t tag;
+            int64_t result = m_ring->WaitCompletion(tag);
+            m_blocks[tag].result = result;
+            m_blocks[tag].pending = false;
+        }
+        if (block.result != static_cast<int64_t>(block.size)) {
+            Complete_(block);
+        }
+        data = block.data.get();
+        return block.size;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void AsyncFileReader::Request_(size_t index) {
+        if (m_next_offset >= m_file_size) {
+            return;
+        }
+        Block &block = m_blocks[index];
+        block.offset = m_next_offset;
+        block.size = static_cast<size_t>(std::min<uint64_t>(AsyncIoConstant::REQUEST_SIZE, m_file_size - m_next_offset));
+        // later requests of a block are never larger than its first one
+        if (block.data == nullptr) {
+            block.data = std::make_unique<char[]>(block.size);
+        }
+        block.requested = true;
+        block.pending = true;
+        m_ring->PrepareRead(m_fd, block.data.get(), block.size, block.offset, index);
+        m_next_offset += block.size;
+    }
+
+    void AsyncFileReader::Complete_(Block &block) {
+        // a failed request (e.g. a kernel without IORING_OP_READ) is read again synchronously, which reports
+        // the error if it persists; a file shrunk meanwhile ends early
+        size_t done = block.result > 0 ? static_cast<size_t>(block.result) : 0;
+        while (done < block.size) {
+            ssize_t size = pread(m_fd, block.data.get() + done, block.size - done,
+                                 static_cast<off_t>(block.offset + done));
+            if (size < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(AsyncIoConstant::EXCEPTION_MESSAGE_READ_FAILED);
+            }
+            if (size == 0) {
+                break;
+            }
+            done += static_cast<size_t>(size);
+        }
+        block.size = done;
+    }
+
+    AsyncFileWriter::AsyncFileWriter(int fd, uint64_t offset) : m_fd(fd), m_seekable(false), m_offset(offset),
+                                                                m_current(0), m_failed(false) {
+        struct stat buffer{};
+        m_seekable = fstat(fd, &buffer) == 0 && S_ISREG(buffer.st_mode);
+        if (m_seekable) {
+            m_ring = IoRing::Create(AsyncIoConstant::BLOCKS_IN_FLIGHT);
+        }
+        m_blocks.resize(m_ring != nullptr ? AsyncIoConstant::BLOCKS_IN_FLIGHT : 1);
+    }
+
+    AsyncFileWriter::~AsyncFileWriter() {
+        try {
+            Finish();
+        } catch (const std::runtime_error &) {
+            // the ring is unusable, closing it is all that is left
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    char *AsyncFileWriter::GetBuffer() {
+        Block &block = m_blocks[m_current];
+        while (block.pending) {
+            Reap_();
+        }
+        if (block.data == nullptr) {
+            block.data = std::make_unique<char[]>(AsyncIoConstant::REQUEST_SIZE);
+        }
+        return block.data.get();
+    }
+
+    void AsyncFileWriter::Commit(size_t size) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "AsyncFileWriter::Commit");
+        if (size == 0) {
+            return;
+        }
+        Block &block = m_blocks[m_current];
+        if (m_ring == nullptr) {
+            m_failed = !WriteAll_(block.data.get(), size, m_offset) || m_failed;
+            m_offset += size;
+            return;
+        }
+        block.size = size;
+        block.offset = m_offset;
+        block.pending = true;
+        m_ring->PrepareWrite(m_fd, block.data.get(), size, m_offset, m_current);
+        m_ring->Submit();
+        m_offset += size;
+        m_current = (m_current + 1) % m_blocks.size();
+    }
+
+    bool AsyncFileWriter::Finish() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "AsyncFileWriter::Finish");
+        if (m_ring != nullptr) {
+            for (Block &block: m_blocks) {
+                while (block.pending) {
+                    Reap_();
+                }
+            }
+        }
+        return !m_failed;
+    }
+
+    uint64_t AsyncFileWriter::GetOffset() const {
+        return m_offset;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void AsyncFileWriter::Reap_() {
+        uint64_t tag;
+        int64_t result = m_ring->WaitCompletion(tag);
+        Block &block = m_blocks[tag];
+        block.pending = false;
+        // the rest of a short write, or a failed request (e.g. a kernel without IORING_OP_WRITE) is written
+        // synchronously, which reports the error if it persists
+        size_t done = result > 0 ? static_cast<size_t>(result) : 0;
+        if (done < block.size) {
+            m_failed = !WriteAll_(block.data.get() + done, block.size - done, block.offset + done) || m_failed;
+        }
+    }
+
+    bool AsyncFileWriter::WriteAll_(const char *data, size_t size, uint64_t offset) const {
+        while (size > 0) {
+            ssize_t written = m_seekable ? pwrite(m_fd, data, size, static_cast<off_t>(offset))
+                                         : write(m_fd, data, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    AsyncInputStreamBuffer::AsyncInputStreamBuffer() : m_fd(-1), m_block_offset(0), m_block_size(0) {}
+
+    AsyncInputStreamBuffer::~AsyncInputStreamBuffer() {
+        // the reader waits for its requests on the descriptor
+        m_reader.reset();
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool AsyncInputStreamBuffer::Open(const std::string &file_name) {
+        return Open(file_name, 0);
+    }
+
+    bool AsyncInputStreamBuffer::Open(const std::string &file_name, uint64_t offset) {
+        m_fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fd < 0) {
+            return false;
+        }
+        m_reader = std::make_unique<AsyncFileReader>(m_fd, offset);
+        m_block_offset = offset;
+        return true;
+    }
+
+    bool AsyncInputStreamBuffer::IsOpen() const {
+        return m_fd >= 0;
+    }
+
+    ////////////////////////////////// Protected //////////////////////////////////
+    AsyncInputStreamBuffer::int_type AsyncInputStreamBuffer::underflow() {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (m_reader == nullptr) {
+            return traits_type::eof();
+        }
+        char *data = nullptr;
+        size_t size = m_reader->NextBlock(data);
+        if (size == 0) {
+            // the last block stays seekable, a file shorter than a magic number can be read again
+            return traits_type::eof();
+        }
+        m_block_offset += m_block_size;
+        m_block_size = size;
+        setg(data, data, data + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    AsyncInputStreamBuffer::pos_type AsyncInputStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                                     std::ios_base::openmode which) {
+        if (dir == std::ios_base::beg) {
+            return seekpos(pos_type(off), which);
+        }
+        if (dir == std::ios_base::cur) {
+            return seekpos(pos_type(static_cast<off_type>(m_block_offset) + (gptr() - eback()) + off), which);
+        }
+        return pos_type(off_type(-1));
+    }
+
+    AsyncInputStreamBuffer::pos_type AsyncInputStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+        auto target = static_cast<off_type>(pos);
+        auto block_offset = static_cast<off_type>(m_block_offset);
+        if ((which & std::ios_base::in) == 0 || target < block_offset ||
+            target > block_offset + static_cast<off_type>(m_block_size)) {
+            return pos_type(off_type(-1));
+        }
+        if (m_block_size != 0) {
+            setg(eback(), eback() + (target - block_offset), egptr());
+        }
+        return pos;
+    }
+
+    AsyncOutputStreamBuffer::AsyncOutputStreamBuffer() : m_fd(-1), m_failed(false) {}
+
+    AsyncOutputStreamBuffer::~AsyncOutputStreamBuffer() {
+        Close();
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool AsyncOutputStreamBuffer::Open(const std::string &file_name) {
+        m_fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, AsyncIoConstant::DEFAULT_FILE_MODE);
+        if (m_fd < 0) {
+            return false;
+        }
+        m_writer = std::make_unique<AsyncFileWriter>(m_fd, 0);
+        char *buffer = m_writer->GetBuffer();
+        setp(buffer, buffer + AsyncIoConstant::REQUEST_SIZE);
+        return true;
+    }
+
+    bool AsyncOutputStreamBuffer::IsOpen() const {
+        return m_fd >= 0;
+    }
+
+    bool AsyncOutputStreamBuffer::Close() {
+        if (m_fd < 0) {
+            return false;
+        }
+        try {
+            CommitBuffer_();
+            m_failed = !m_writer->Finish() || m_failed;
+        } catch (const std::runtime_error &) {
+            m_failed = true;
+        }
+        m_writer.reset();
+        m_failed = close(m_fd) != 0 || m_failed;
+        m_fd = -1;
+        setp(nullptr, nullptr);
+        return !m_failed;
+    }
+
+    ////////////////////////////////// Protected //////////////////////////////////
+    AsyncOutputStreamBuffer::int_type AsyncOutputStreamBuffer::overflow(int_type ch) {
+        if (m_writer == nullptr) {
+            return traits_type::eof();
+        }
+        CommitBuffer_();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int AsyncOutputStreamBuffer::sync() {
+        if (m_writer == nullptr) {
+            return -1;
+        }
+        CommitBuffer_();
+        return m_writer->Finish() ? 0 : -1;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void AsyncOutputStreamBuffer::CommitBuffer_() {
+        m_writer->Commit(static_cast<size_t>(pptr() - pbase()));
+        char *buffer = m_writer->GetBuffer();
+        setp(buffer, buffer + AsyncIoConstant::REQUEST_SIZE);
+    }
+}
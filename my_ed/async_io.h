@@ -0,0 +1,202 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace MyEd {
+
+    class AsyncIoConstant {
+    public:
+        // bytes of one read or write request
+        constexpr static const size_t REQUEST_SIZE = 1 << 20;
+        // requests kept in flight per file
+        constexpr static const size_t BLOCKS_IN_FLIGHT = 4;
+        constexpr static const mode_t DEFAULT_FILE_MODE = 0666;
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_READ_FAILED = "Cannot read file.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_RING_FAILED = "Asynchronous I/O failed.";
+    };
+
+    // Minimal io_uring instance on the raw system calls, for the requests of one file.
+    // Requests are prepared, then submitted together; completions are reaped one at a time.
+    class IoRing {
+    private:
+        int m_ring_fd;
+        void *m_sq_ring;
+        size_t m_sq_ring_size;
+        void *m_cq_ring;
+        size_t m_cq_ring_size;
+        void *m_sqes;
+        size_t m_sqes_size;
+        // fields of the rings shared with the kernel
+        unsigned *m_sq_tail;
+        unsigned *m_sq_mask;
+        unsigned *m_sq_array;
+        unsigned *m_cq_head;
+        unsigned *m_cq_tail;
+        unsigned *m_cq_mask;
+        void *m_cqes;
+        unsigned m_unsubmitted;
+    public:
+        // null when the kernel does not offer io_uring (too old, disabled, or filtered by seccomp)
+        static std::unique_ptr<IoRing> Create(unsigned entries);
+        ~IoRing();
+
+        IoRing(const IoRing &) = delete;
+        IoRing &operator=(const IoRing &) = delete;
+
+        void PrepareRead(int fd, char *data, size_t size, uint64_t offset, uint64_t tag);
+        void PrepareWrite(int fd, const char *data, size_t size, uint64_t offset, uint64_t tag);
+        // submit the prepared requests and wait for one completion: its tag, and its result like the one of
+        // pread/pwrite, but -errno on failure
+        int64_t WaitCompletion(uint64_t &tag);
+        // submit the prepared requests without waiting
+        void Submit();
+
+    private:
+        IoRing();
+
+        void Prepare_(uint8_t opcode, int fd, uint64_t address, size_t size, uint64_t offset, uint64_t tag);
+        // io_uring_enter for the unsubmitted requests, waiting for min_complete completions
+        bool Enter_(unsigned min_complete);
+    };
+
+    // Reads a file from start to end in blocks.
+    // For regular files BLOCKS_IN_FLIGHT reads are kept in flight through io_uring, so the kernel reads the
+    // next blocks while the caller parses the current one. Without io_uring, and for pipes and the like, the
+    // blocks are read one after another with read(2).
+    class AsyncFileReader {
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            uint64_t offset = 0;
+            size_t size = 0;
+            int64_t result = 0;
+            bool requested = false;
+            bool pending = false;
+        };
+
+        int m_fd;
+        std::unique_ptr<IoRing> m_ring;
+        uint64_t m_file_size;
+        uint64_t m_next_offset;
+        std::vector<Block> m_blocks;
+        // block handed out last, m_blocks.size() before the first one
+        size_t m_current;
+        // of the block read without io_uring
+        size_t m_block_capacity;
+    public:
+        // read fd from offset on, fd stays owned by the caller
+        AsyncFileReader(int fd, uint64_t offset);
+        // waits for the reads in flight, which write into the blocks
+        ~AsyncFileReader();
+
+        AsyncFileReader(const AsyncFileReader &) = delete;
+        AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+        // the next block, valid until the following call; 0 at the end of the file
+        size_t NextBlock(char *&data);
+
+    private:
+        // read the next part of the file into the block, unless the whole file is requested already
+        void Request_(size_t index);
+        // read what a short read left out of a block
+        void Complete_(Block &block);
+    };
+
+    // Writes consecutive data to a file from an offset on in blocks.
+    // For regular files a filled block is handed to io_uring and the caller goes on filling the next one while
+    // it is written, with up to BLOCKS_IN_FLIGHT blocks in flight. Without io_uring, and for pipes and the
+    // like, blocks are written at once with pwrite(2)/write(2).
+    class AsyncFileWriter {
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            size_t size = 0;
+            uint64_t offset = 0;
+            bool pending = false;
+        };
+
+        int m_fd;
+        bool m_seekable;
+        std::unique_ptr<IoRing> m_ring;
+        uint64_t m_offset;
+        std::vector<Block> m_blocks;
+        size_t m_current;
+        bool m_failed;
+    public:
+        // fd stays owned by the caller
+        AsyncFileWriter(int fd, uint64_t offset);
+        ~AsyncFileWriter();
+
+        AsyncFileWriter(const AsyncFileWriter &) = delete;
+        AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+        // REQUEST_SIZE bytes to fill
+        [[nodiscard]] char *GetBuffer();
+        // write the first size bytes of the buffer, GetBuffer() hands out a free one afterwards
+        void Commit(size_t size);
+        // wait until everything committed is written, false if anything failed
+        bool Finish();
+        [[nodiscard]] uint64_t GetOffset() const;
+
+    private:
+        // wait for one completion
+        void Reap_();
+        // write data synchronously, false on failure
+        bool WriteAll_(const char *data, size_t size, uint64_t offset) const;
+    };
+
+    // std::streambuf reading a file through an AsyncFileReader, a drop-in for an input std::filebuf.
+    // Seeking is only possible within the current block, enough to look at the first bytes and go back.
+    class AsyncInputStreamBuffer : public std::streambuf {
+    private:
+        int m_fd;
+        std::unique_ptr<AsyncFileReader> m_reader;
+        // file offset of the current block
+        uint64_t m_block_offset;
+        size_t m_block_size;
+    public:
+        AsyncInputStreamBuffer();
+        ~AsyncInputStreamBuffer() override;
+
+        bool Open(const std::string &file_name);
+        // read file_name from offset on, e.g. what was appended to it after offset
+        bool Open(const std::string &file_name, uint64_t offset);
+        [[nodiscard]] bool IsOpen() const;
+
+    protected:
+        int_type underflow() override;
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    };
+
+    // std::streambuf writing a file through an AsyncFileWriter, a drop-in for an output std::filebuf
+    class AsyncOutputStreamBuffer : public std::streambuf {
+    private:
+        int m_fd;
+        std::unique_ptr<AsyncFileWriter> m_writer;
+        bool m_failed;
+    public:
+        AsyncOutputStreamBuffer();
+        ~AsyncOutputStreamBuffer() override;
+
+        // create or truncate file_name
+        bool Open(const std::string &file_name);
+        [[nodiscard]] bool IsOpen() const;
+        // write everything and close the file, false if anything failed
+        bool Close();
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        void CommitBuffer_();
+    };
+}
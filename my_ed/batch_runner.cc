@@ -0,0 +1,112 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "editor.h"
+#include "trace.h"
+
+namespace MyEd {
+    BatchRunner::BatchRunner(std::string script, std::vector<std::string> file_names, size_t worker_count)
+            : m_script(std::move(script)),
+              m_file_names(std::move(file_names)),
+              m_worker_count(std::max<size_t>(1, std::min(worker_count, m_file_names.size()))),
+              m_results(m_file_names.size()),
+              m_next_file(0),
+              m_next_print(0) {}
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool BatchRunner::Run(OutputSink &output) {
+        std::vector<std::thread> workers;
+        workers.reserve(m_worker_count);
+        for (size_t i = 0; i < m_worker_count; ++i) {
+            workers.emplace_back(&BatchRunner::Work_, this);
+        }
+
+        bool all_loaded = true;
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            Result result;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_result_ready.wait(lock, [this, i]() { return m_results[i].done; });
+                result = std::move(m_results[i]);
+                m_results[i].output.clear();
+                m_results[i].output.shrink_to_fit();
+                m_next_print = i + 1;
+            }
+            m_window_moved.notify_all();
+
+            all_loaded &= !result.failed;
+            output << BatchRunnerConstant::FILE_HEADER_BEGIN << m_file_names[i] << BatchRunnerConstant::FILE_HEADER_END
+                   << '\n' << result.output;
+        }
+        output.Flush();
+
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        return all_loaded;
+    }
+
+    std::string BatchRunner::ReadScript(const std::string &script_file_name) {
+        std::ifstream script_stream(script_file_name, std::ios::binary);
+        if (!script_stream) {
+            throw std::runtime_error(std::string(BatchRunnerConstant::EXCEPTION_MESSAGE_SCRIPT_READ_FAILED) +
+                                     script_file_name + ": " + std::strerror(errno));
+        }
+        return std::string(std::istreambuf_iterator<char>(script_stream), std::istreambuf_iterator<char>());
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void BatchRunner::Work_() {
+        size_t window = BatchRunnerConstant::PENDING_RESULTS_PER_WORKER * m_worker_count;
+        while (true) {
+            size_t file_index;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_window_moved.wait(lock, [this, window]() {
+                    return m_next_file >= m_results.size() || m_next_file < m_next_print + window;
+                });
+                if (m_next_file >= m_results.size()) {
+                    return;
+                }
+                file_index = m_next_file++;
+            }
+
+            Result result = Process_(m_file_names[file_index]);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_results[file_index] = std::move(result);
+                m_results[file_index].done = true;
+            }
+            m_result_ready.notify_one();
+        }
+    }
+
+    BatchRunner::Result BatchRunner::Process_(const std::string &file_name) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_EDITOR, "BatchRunner::Process_");
+        Result result;
+        std::istringstream input(m_script);
+        StringOutputSink output;
+        Editor editor(input, output);
+        try {
+            if (!editor.Init(file_name)) {
+                output << BatchRunnerConstant::STR_FILE_OPEN_FAILED << '\n';
+                result.failed = true;
+            }
+            editor.Run();
+        } catch (const std::exception &ex) {
+            output << ex.what() << '\n';
+            result.failed = true;
+        }
+        editor.Destroys();
+        result.output = output.TakeString();
+        return result;
+    }
+}
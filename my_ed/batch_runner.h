@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "output_sink.h"
+
+namespace MyEd {
+
+    class BatchRunnerConstant {
+    public:
+        // results which may wait for an earlier file to finish, per worker, before workers stop taking files
+        constexpr static const size_t PENDING_RESULTS_PER_WORKER = 4;
+
+        // printed in front of the output of every file, like head(1) does for several files
+        constexpr static inline const char *FILE_HEADER_BEGIN = "==> ";
+        constexpr static inline const char *FILE_HEADER_END = " <==";
+
+        constexpr static inline const char *STR_FILE_OPEN_FAILED = "File does not exist, opened a new file.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_SCRIPT_READ_FAILED = "Cannot read script: ";
+    };
+
+    // Runs the same command script against many files, one independent Editor per file, on a pool of workers.
+    // At most worker_count editors exist at a time, and a worker does not start a file while more than
+    // PENDING_RESULTS_PER_WORKER * worker_count finished results wait to be printed, so memory stays bounded
+    // however many files there are. Results are printed in the order of the files, whatever order they finish in.
+    class BatchRunner {
+    private:
+        struct Result {
+            std::string output;
+            bool failed = false;
+            bool done = false;
+        };
+
+        std::string m_script;
+        std::vector<std::string> m_file_names;
+        size_t m_worker_count;
+
+        std::mutex m_mutex;
+        std::condition_variable m_result_ready;
+        std::condition_variable m_window_moved;
+        std::vector<Result> m_results;
+        size_t m_next_file;
+        size_t m_next_print;
+    public:
+        BatchRunner(std::string script, std::vector<std::string> file_names, size_t worker_count);
+
+        BatchRunner(const BatchRunner &) = delete;
+        BatchRunner &operator=(const BatchRunner &) = delete;
+
+        // process every file, printing results to output; false when any file could not be loaded
+        bool Run(OutputSink &output);
+
+        static std::string ReadScript(const std::string &script_file_name);
+
+    private:
+        void Work_();
+        Result Process_(const std::string &file_name) const;
+    };
+}
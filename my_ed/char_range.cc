@@ -0,0 +1,207 @@
+#include "char_range.h"
+
+namespace MyEd {
+    ////////////////////////////////// Iterator //////////////////////////////////
+    void CharRange::Iterator::SkipPieceEnds_() {
+        while (m_text != nullptr && m_pos == m_chars.size()) {
+            if (m_piece + 1 < m_text->GetPieceCount()) {
+                SetPiece_(m_piece + 1);
+                continue;
+            }
+            ++m_index;
+            if (m_index == m_range->m_end_index) {
+                m_text = nullptr;
+                SetPiece_(0);
+                return;
+            }
+            if (++m_line == m_range->ChunkLineCount_(m_chunk)) {
+                ++m_chunk;
+                m_line = 0;
+            }
+            m_text = &m_range->Text_(m_chunk, m_line);
+            SetPiece_(0);
+        }
+    }
+
+    void CharRange::Iterator::PreviousPiece_() {
+        if (m_text != nullptr && m_piece > 0) {
+            SetPiece_(m_piece - 1);
+            m_pos = m_chars.size();
+            return;
+        }
+        // at the end of the range the position already is the one of the last line
+        if (m_text != nullptr) {
+            if (m_line == 0) {
+                --m_chunk;
+                m_line = m_range->ChunkLineCount_(m_chunk);
+            }
+            --m_line;
+        }
+        --m_index;
+        m_text = &m_range->Text_(m_chunk, m_line);
+        size_t piece_count = m_text->GetPieceCount();
+        SetPiece_(piece_count == 0 ? 0 : piece_count - 1);
+        m_pos = m_chars.size();
+    }
+
+    void CharRange::Iterator::SetPiece_(size_t piece) {
+        m_piece = piece;
+        m_chars = m_text != nullptr && piece < m_text->GetPieceCount() ? m_text->GetPiece(piece) : std::string_view();
+        m_pos = 0;
+    }
+
+    ////////////////////////////////// CharRange //////////////////////////////////
+    CharRange::CharRange(const LineStorage &lines, size_t index, size_t count)
+            : m_lines(lines),
+              m_first_index(index),
+              m_end_index(index + count),
+              m_first_chunk(0) {
+        if (count != 0) {
+            m_first_chunk = m_lines.FindChunk(index);
+            m_pins.resize(m_lines.FindChunk(m_end_index - 1) - m_first_chunk + 1);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    CharRange::Iterator CharRange::begin() const {
+        return At_(m_first_index);
+    }
+
+    CharRange::Iterator CharRange::end() const {
+        Iterator itr;
+        itr.m_range = this;
+        itr.m_index = m_end_index;
+        if (m_end_index != m_first_index) {
+            itr.m_chunk = m_lines.FindChunk(m_end_index - 1);
+            itr.m_line = m_end_index - 1 - m_lines.GetChunkBegin(itr.m_chunk);
+        }
+        return itr;
+    }
+
+    CharRange::Iterator CharRange::LineBegin(size_t index) const {
+        return At_(index);
+    }
+
+    CharRange::Iterator CharRange::Find(Iterator from, std::string_view text) const {
+        if (text.empty()) {
+            return from;
+        }
+        Iterator itr = from;
+        while (itr.m_text != nullptr) {
+            std::string_view rest = itr.GetRestOfPiece();
+            size_t found = rest.find(text);
+            if (found != std::string_view::npos) {
+                itr.m_pos += found;
+                return itr;
+            }
+            // an occurrence starting in the last text.size() - 1 characters goes on in the following pieces,
+            // which may be those of the next lines
+            size_t tail = rest.size() >= text.size() ? rest.size() - text.size() + 1 : 0;
+            for (found = rest.find(text[0], tail); found != std::string_view::npos;
+                 found = rest.find(text[0], found + 1)) {
+                Iterator probe = itr;
+                probe.m_pos += found;
+                size_t matched = 0;
+                while (matched < text.size() && probe.m_text != nullptr && *probe == text[matched]) {
+                    ++probe;
+                    ++matched;
+                }
+                if (matched == text.size()) {
+                    itr.m_pos += found;
+                    return itr;
+                }
+            }
+            itr.m_pos = itr.m_chars.size();
+            itr.SkipPieceEnds_();
+        }
+        return itr;
+    }
+
+    bool CharRange::Search(Iterator from, Regex &regex, Iterator &match_begin) const {
+        // where the leftmost match ends, running forward over whole pieces
+        RegexDfa &forward = regex.GetForwardDfa();
+        const RegexDfa::State *state = forward.GetStart(ByteBefore_(from));
+        Iterator match_end;
+        bool found = false;
+        bool alive = true;
+        for (Iterator itr = from; itr.m_text != nullptr;) {
+            std::string_view piece = itr.GetRestOfPiece();
+            size_t offset = std::string_view::npos;
+            alive = forward.Scan(state, piece.data(), piece.size(), offset);
+            if (offset != std::string_view::npos) {
+                match_end = itr;
+                match_end.m_pos += offset;
+                found = true;
+            }
+            if (!alive) {
+                break;
+            }
+            itr.m_pos = itr.m_chars.size();
+            itr.SkipPieceEnds_();
+        }
+        if (alive && forward.Step(state, RegexConstant::NO_BYTE)->match) {
+            match_end = end();
+            found = true;
+        }
+        if (!found) {
+            return false;
+        }
+
+        // and where it starts, running the reversed pattern backward from there
+        RegexDfa &reverse = regex.GetReverseDfa();
+        state = reverse.GetStart(match_end.m_text == nullptr ? RegexConstant::NO_BYTE
+                                                             : static_cast<uint8_t>(*match_end));
+        match_begin = match_end;
+        for (Iterator itr = match_end; itr != from;) {
+            Iterator prev = itr;
+            --prev;
+            state = reverse.Step(state, static_cast<uint8_t>(*prev));
+            if (state->match) {
+                match_begin = itr;
+            }
+            if (RegexDfa::IsDead(state)) {
+                return true;
+            }
+            itr = prev;
+        }
+        if (reverse.Step(state, ByteBefore_(from))->match) {
+            match_begin = from;
+        }
+        return true;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    const LineText &CharRange::Text_(size_t chunk, size_t line) const {
+        std::shared_ptr<const LineChunk::Entries> &pin = m_pins[chunk - m_first_chunk];
+        if (pin == nullptr) {
+            pin = m_lines.PinChunk(chunk);
+        }
+        return *(*pin)[line].text;
+    }
+
+    size_t CharRange::ChunkLineCount_(size_t chunk) const {
+        return m_lines.GetChunkLineCount(chunk);
+    }
+
+    CharRange::Iterator CharRange::At_(size_t index) const {
+        if (index >= m_end_index) {
+            return end();
+        }
+        Iterator itr;
+        itr.m_range = this;
+        itr.m_index = index;
+        itr.m_chunk = m_lines.FindChunk(index);
+        itr.m_line = index - m_lines.GetChunkBegin(itr.m_chunk);
+        itr.m_text = &Text_(itr.m_chunk, itr.m_line);
+        itr.SetPiece_(0);
+        itr.SkipPieceEnds_();
+        return itr;
+    }
+
+    int CharRange::ByteBefore_(Iterator itr) const {
+        if (itr == begin()) {
+            return RegexConstant::NO_BYTE;
+        }
+        return static_cast<uint8_t>(*--itr);
+    }
+}
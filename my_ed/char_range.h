@@ -0,0 +1,139 @@
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "line_storage.h"
+#include "regex.h"
+
+namespace MyEd {
+
+    // The characters of consecutive lines of a LineStorage seen as one sequence, newlines included, without copying
+    // them into one string, nor the pieces of a rope line. The range reads a snapshot of the store, so later edits do not affect it, and every
+    // chunk it reaches stays pinned for its lifetime, so spilling does not either.
+    // Its bidirectional iterators work with std::regex_search and any other algorithm over characters.
+    class CharRange {
+    public:
+        class Iterator {
+            friend class CharRange;
+
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const char *;
+            using reference = const char &;
+
+        private:
+            const CharRange *m_range = nullptr;
+            // store index of the line, the end of the range is one past its last line
+            size_t m_index = 0;
+            // chunk of the store and position of the line in it, those of the last line at the end of the range
+            size_t m_chunk = 0;
+            size_t m_line = 0;
+            // null at the end of the range
+            const LineText *m_text = nullptr;
+            // piece of the line and position in it
+            size_t m_piece = 0;
+            std::string_view m_chars;
+            size_t m_pos = 0;
+        public:
+            Iterator() = default;
+
+            reference operator*() const {
+                return m_chars[m_pos];
+            }
+
+            pointer operator->() const {
+                return m_chars.data() + m_pos;
+            }
+
+            Iterator &operator++() {
+                ++m_pos;
+                SkipPieceEnds_();
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator tmp = *this;
+                ++*this;
+                return tmp;
+            }
+
+            Iterator &operator--() {
+                while (m_text == nullptr || m_pos == 0) {
+                    PreviousPiece_();
+                }
+                --m_pos;
+                return *this;
+            }
+
+            Iterator operator--(int) {
+                Iterator tmp = *this;
+                --*this;
+                return tmp;
+            }
+
+            bool operator==(const Iterator &another) const {
+                return m_index == another.m_index && m_piece == another.m_piece && m_pos == another.m_pos;
+            }
+
+            bool operator!=(const Iterator &another) const {
+                return !(*this == another);
+            }
+
+            // 0-based index in the store of the line the character belongs to
+            [[nodiscard]] size_t GetLineIndex() const {
+                return m_index;
+            }
+
+            // the rest of the current piece of the line, empty at the end of the range
+            [[nodiscard]] std::string_view GetRestOfPiece() const {
+                return m_chars.substr(m_pos);
+            }
+
+        private:
+            // step over the end of the piece to the next one which is not empty, which may be in one of the
+            // following lines, or to the end of the range
+            void SkipPieceEnds_();
+            // to the end of the previous piece
+            void PreviousPiece_();
+            void SetPiece_(size_t piece);
+        };
+
+    private:
+        LineStorage m_lines;
+        size_t m_first_index;
+        size_t m_end_index;
+        size_t m_first_chunk;
+        // of the chunks from m_first_chunk on, made when an iterator first reaches them
+        mutable std::vector<std::shared_ptr<const LineChunk::Entries>> m_pins;
+    public:
+        // lines [index, index + count) of lines
+        CharRange(const LineStorage &lines, size_t index, size_t count);
+
+        // iterators refer to their range
+        CharRange(const CharRange &) = delete;
+        CharRange &operator=(const CharRange &) = delete;
+
+        [[nodiscard]] Iterator begin() const;
+        [[nodiscard]] Iterator end() const;
+        // the first character of the line with store index index, end when it is past the range
+        [[nodiscard]] Iterator LineBegin(size_t index) const;
+
+        // first occurrence of text at or after from, which may span lines, end when there is none
+        [[nodiscard]] Iterator Find(Iterator from, std::string_view text) const;
+        // first match of regex at or after from, which may span lines, false when there is none
+        bool Search(Iterator from, Regex &regex, Iterator &match_begin) const;
+
+    private:
+        [[nodiscard]] const LineText &Text_(size_t chunk, size_t line) const;
+        [[nodiscard]] size_t ChunkLineCount_(size_t chunk) const;
+        [[nodiscard]] Iterator At_(size_t index) const;
+        // the byte before itr as the automata take it, NO_BYTE at the beginning of the range
+        [[nodiscard]] int ByteBefore_(Iterator itr) const;
+    };
+}
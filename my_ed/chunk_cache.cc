@@ -0,0 +1,182 @@
+#include "chunk_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "line_store.h"
+#include "trace.h"
+
+namespace MyEd {
+    ChunkCache::ChunkCache()
+            : m_budget(ChunkCacheConstant::UNLIMITED),
+              m_may_spill(false),
+              m_resident_cost(0),
+              m_spill_fd(-1),
+              m_spill_end(0) {}
+
+    ////////////////////////////////// Public //////////////////////////////////
+    ChunkCache &ChunkCache::Instance() {
+        // never destroyed, chunks may outlive static destruction
+        static auto *instance = new ChunkCache();
+        return *instance;
+    }
+
+    void ChunkCache::SetBudget(uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget.store(bytes, std::memory_order_relaxed);
+        if (bytes != ChunkCacheConstant::UNLIMITED) {
+            m_may_spill.store(true, std::memory_order_relaxed);
+        }
+        if (bytes == ChunkCacheConstant::UNLIMITED) {
+            for (const LineChunk *chunk: m_lru) {
+                chunk->m_cached = false;
+            }
+            m_lru.clear();
+            m_resident_cost = 0;
+        } else {
+            Shrink_();
+        }
+    }
+
+    bool ChunkCache::IsEnabled() const {
+        return m_budget.load(std::memory_order_relaxed) != ChunkCacheConstant::UNLIMITED;
+    }
+
+    bool ChunkCache::MaySpill() const {
+        return m_may_spill.load(std::memory_order_relaxed);
+    }
+
+    uint64_t ChunkCache::ParseSize(const std::string &size) {
+        size_t end = 0;
+        uint64_t bytes;
+        try {
+            bytes = std::stoull(size, &end);
+        } catch (const std::logic_error &) {
+            throw std::runtime_error(ChunkCacheConstant::EXCEPTION_MESSAGE_BAD_SIZE);
+        }
+        if (end + 1 == size.size()) {
+            switch (size[end]) {
+                case 'K':
+                case 'k':
+                    return bytes << 10;
+                case 'M':
+                case 'm':
+                    return bytes << 20;
+                case 'G':
+                case 'g':
+                    return bytes << 30;
+                default:
+                    break;
+            }
+        } else if (end == size.size()) {
+            return bytes;
+        }
+        throw std::runtime_error(ChunkCacheConstant::EXCEPTION_MESSAGE_BAD_SIZE);
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void ChunkCache::Touch_(const LineChunk &chunk) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!IsEnabled()) {
+            return;
+        }
+        if (chunk.m_cached) {
+            m_lru.splice(m_lru.begin(), m_lru, chunk.m_lru_position);
+            return;
+        }
+        m_lru.push_front(&chunk);
+        chunk.m_lru_position = m_lru.begin();
+        chunk.m_cached = true;
+        chunk.m_cached_cost = chunk.GetCost_();
+        m_resident_cost += chunk.m_cached_cost;
+        Shrink_();
+    }
+
+    void ChunkCache::Resize_(const LineChunk &chunk) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!chunk.m_cached) {
+            return;
+        }
+        m_resident_cost -= chunk.m_cached_cost;
+        chunk.m_cached_cost = chunk.GetCost_();
+        m_resident_cost += chunk.m_cached_cost;
+        Shrink_();
+    }
+
+    void ChunkCache::Remove_(const LineChunk &chunk) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!chunk.m_cached) {
+            return;
+        }
+        m_lru.erase(chunk.m_lru_position);
+        m_resident_cost -= chunk.m_cached_cost;
+        chunk.m_cached = false;
+    }
+
+    void ChunkCache::Shrink_() {
+        // every chunk is tried once at most, pinned ones go back to the front
+        size_t tries = m_lru.size();
+        while (m_resident_cost > m_budget.load(std::memory_order_relaxed) && tries-- > 0 && IsEnabled()) {
+            const LineChunk *chunk = m_lru.back();
+            if (!chunk->Spill_()) {
+                m_lru.splice(m_lru.begin(), m_lru, chunk->m_lru_position);
+                continue;
+            }
+            m_lru.pop_back();
+            m_resident_cost -= chunk->m_cached_cost;
+            chunk->m_cached = false;
+        }
+    }
+
+    bool ChunkCache::WriteSpill_(const std::string &data, uint64_t &offset) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "ChunkCache::WriteSpill_");
+        if (m_spill_fd < 0) {
+            const char *dir = std::getenv(ChunkCacheConstant::SPILL_DIR_ENV);
+            std::string path = std::string(dir != nullptr ? dir : ChunkCacheConstant::DEFAULT_SPILL_DIR) +
+                               ChunkCacheConstant::SPILL_FILE_TEMPLATE;
+            m_spill_fd = mkostemp(path.data(), O_CLOEXEC);
+            if (m_spill_fd >= 0) {
+                // nobody else needs to see it, and it must not outlive us
+                unlink(path.c_str());
+            }
+        }
+        size_t done = 0;
+        while (m_spill_fd >= 0 && done < data.size()) {
+            ssize_t written = pwrite(m_spill_fd, data.data() + done, data.size() - done,
+                                     static_cast<off_t>(m_spill_end + done));
+            if (written < 0 && errno != EINTR) {
+                break;
+            }
+            done += written > 0 ? static_cast<size_t>(written) : 0;
+        }
+        if (m_spill_fd < 0 || done < data.size()) {
+            // e.g. the disk is full: keep everything in memory from now on
+            m_budget.store(ChunkCacheConstant::UNLIMITED, std::memory_order_relaxed);
+            return false;
+        }
+        offset = m_spill_end;
+        m_spill_end += data.size();
+        return true;
+    }
+
+    void ChunkCache::ReadSpill_(uint64_t offset, std::string &data) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "ChunkCache::ReadSpill_");
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t read_size = pread(m_spill_fd, data.data() + done, data.size() - done,
+                                      static_cast<off_t>(offset + done));
+            if (read_size == 0 || (read_size < 0 && errno != EINTR)) {
+                throw std::runtime_error(ChunkCacheConstant::EXCEPTION_MESSAGE_SPILL_READ_FAILED);
+            }
+            done += read_size > 0 ? static_cast<size_t>(read_size) : 0;
+        }
+    }
+
+    void ChunkCache::AdviseSpill_(uint64_t offset, uint64_t length) const {
+        posix_fadvise(m_spill_fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace MyEd {
+
+    class LineChunk;
+
+    class ChunkCacheConstant {
+    public:
+        // no budget, everything stays in memory
+        constexpr static const uint64_t UNLIMITED = 0;
+        // bookkeeping of one line besides its text: entry, shared_ptr control block, string header
+        constexpr static const uint64_t LINE_OVERHEAD = 80;
+        constexpr static inline const char *SPILL_FILE_TEMPLATE = "/myed-spill-XXXXXX";
+        constexpr static inline const char *DEFAULT_SPILL_DIR = "/tmp";
+        constexpr static inline const char *SPILL_DIR_ENV = "TMPDIR";
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_BAD_SIZE = "Bad memory size, expected a number with an optional K, M or G suffix.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_SPILL_READ_FAILED = "Cannot read spill file.";
+    };
+
+    // Process-wide memory budget for line chunks.
+    // Resident chunks are kept in LRU order, when they use more than the budget the least recently used ones
+    // which nobody is reading are written to an anonymous spill file (created in $TMPDIR, unlinked at once)
+    // and dropped from memory. Chunks are immutable, so a chunk is written at most once and evicting it again
+    // after it was paged back in costs nothing. The spill file only grows, it goes away with the process.
+    // If it cannot be written, spilling is turned off and everything stays in memory as without a budget.
+    class ChunkCache {
+        friend class LineChunk;
+
+    private:
+        std::atomic<uint64_t> m_budget;
+        // a budget was set once, chunks may be spilled even if spilling was turned off since
+        std::atomic<bool> m_may_spill;
+        std::mutex m_mutex;
+        std::list<const LineChunk *> m_lru;
+        uint64_t m_resident_cost;
+        int m_spill_fd;
+        uint64_t m_spill_end;
+    public:
+        static ChunkCache &Instance();
+
+        ChunkCache(const ChunkCache &) = delete;
+        ChunkCache &operator=(const ChunkCache &) = delete;
+
+        // to be set before any file is loaded, UNLIMITED turns spilling off (the default)
+        void SetBudget(uint64_t bytes);
+        [[nodiscard]] bool IsEnabled() const;
+        // false when no chunk can have been spilled, their entries then stay put and are read without locking
+        [[nodiscard]] bool MaySpill() const;
+
+        // "512M", "2G", "65536"...
+        static uint64_t ParseSize(const std::string &size);
+
+    private:
+        ChunkCache();
+
+        // chunk was used now, it becomes resident if it was not
+        void Touch_(const LineChunk &chunk);
+        // chunk changed size in place
+        void Resize_(const LineChunk &chunk);
+        void Remove_(const LineChunk &chunk);
+        // evict least recently used chunks until the budget is met, lock held
+        void Shrink_();
+
+        // append data to the spill file, lock held; false when it failed and spilling was turned off
+        bool WriteSpill_(const std::string &data, uint64_t &offset);
+        void ReadSpill_(uint64_t offset, std::string &data) const;
+        void AdviseSpill_(uint64_t offset, uint64_t length) const;
+    };
+}
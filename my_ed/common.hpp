@@ -2,18 +2,57 @@
 
 #include <sys/stat.h>
 
+#include <cstdint>
+#include <memory>
 #include <numeric>
 #include <regex>
 #include <string>
 
+#include "lru_cache.h"
+#include "trace.h"
+
 namespace MyEd {
 
+    // identity of a regular file's content on disk, used to tell whether it changed behind our back
+    struct FileDiskState {
+        bool valid = false;
+        dev_t device = 0;
+        ino_t inode = 0;
+        off_t size = 0;
+        int64_t mtime_ns = 0;
+
+        bool operator==(const FileDiskState &another_state) const {
+            return valid == another_state.valid && device == another_state.device &&
+                   inode == another_state.inode && size == another_state.size &&
+                   mtime_ns == another_state.mtime_ns;
+        }
+
+        bool operator!=(const FileDiskState &another_state) const {
+            return !(*this == another_state);
+        }
+    };
+
     class FileUtil {
     public:
         static bool IsFileExists(const std::string &file_name) {
             struct stat buffer{};
             return stat(file_name.c_str(), &buffer) == 0;
         }
+
+        // an invalid state when the file does not exist or is not a regular file
+        static FileDiskState GetDiskState(const std::string &file_name) {
+            struct stat buffer{};
+            FileDiskState state;
+            if (stat(file_name.c_str(), &buffer) != 0 || !S_ISREG(buffer.st_mode)) {
+                return state;
+            }
+            state.valid = true;
+            state.device = buffer.st_dev;
+            state.inode = buffer.st_ino;
+            state.size = buffer.st_size;
+            state.mtime_ns = static_cast<int64_t>(buffer.st_mtim.tv_sec) * 1000000000 + buffer.st_mtim.tv_nsec;
+            return state;
+        }
     };
 
     class StringUtil {
@@ -55,15 +94,18 @@ namespace MyEd {
 
         //regex match
         static bool Match(const std::string &str, const std::string &pattern) {
-            return std::regex_match(str, std::regex(pattern));
+            MYED_TRACE_SCOPE(TraceConstant::CATEGORY_PARSE, "StringUtil::Match");
+            return std::regex_match(str, *CompiledRegex_(pattern));
         }
 
         static bool Match(const std::string &str, const std::string &pattern, std::smatch &sm) {
-            return std::regex_match(str, sm, std::regex(pattern));
+            MYED_TRACE_SCOPE(TraceConstant::CATEGORY_PARSE, "StringUtil::Match");
+            return std::regex_match(str, sm, *CompiledRegex_(pattern));
         }
 
         static bool Match(const char *str, const std::string &pattern, std::cmatch &cm) {
-            return std::regex_match(str, cm, std::regex(pattern));
+            MYED_TRACE_SCOPE(TraceConstant::CATEGORY_PARSE, "StringUtil::Match");
+            return std::regex_match(str, cm, *CompiledRegex_(pattern));
         }
 
         // find the n-th substring of input string
@@ -90,5 +132,16 @@ namespace MyEd {
             }
             return replaced;
         }
+
+    private:
+        // command patterns are matched against every command, so each is compiled once per thread
+        constexpr static const size_t COMPILED_REGEX_CACHE_SIZE = 64;
+
+        static std::shared_ptr<const std::regex> CompiledRegex_(const std::string &pattern) {
+            thread_local LruCache<const std::regex> cache(COMPILED_REGEX_CACHE_SIZE);
+            return cache.Get(pattern, [&pattern]() {
+                return std::make_shared<const std::regex>(pattern);
+            });
+        }
     };
 }
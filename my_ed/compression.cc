@@ -0,0 +1,383 @@
+#include "compression.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef MYED_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "trace.h"
+
+namespace MyEd {
+    ////////////////////////////////// Gzip //////////////////////////////////
+    GzipInputStreamBuffer::GzipInputStreamBuffer(std::streambuf *source)
+            : m_source(source),
+              m_z_stream(),
+              m_in_buffer(CompressionConstant::STREAM_BUFFER_SIZE),
+              m_out_buffer(CompressionConstant::STREAM_BUFFER_SIZE),
+              m_end_of_stream(false) {
+        if (inflateInit2(&m_z_stream, CompressionConstant::GZIP_AUTO_WINDOW_BITS) != Z_OK) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CORRUPT_GZIP);
+        }
+    }
+
+    GzipInputStreamBuffer::~GzipInputStreamBuffer() {
+        inflateEnd(&m_z_stream);
+    }
+
+    GzipInputStreamBuffer::int_type GzipInputStreamBuffer::underflow() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "GzipInputStreamBuffer::underflow");
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        bool member_open = true;
+        while (!m_end_of_stream) {
+            if (m_z_stream.avail_in == 0) {
+                std::streamsize read_size = m_source->sgetn(m_in_buffer.data(),
+                                                            static_cast<std::streamsize>(m_in_buffer.size()));
+                if (read_size <= 0) {
+                    // input ended in the middle of a gzip member
+                    if (member_open) {
+                        throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CORRUPT_GZIP);
+                    }
+                    m_end_of_stream = true;
+                    break;
+                }
+                m_z_stream.next_in = reinterpret_cast<Bytef *>(m_in_buffer.data());
+                m_z_stream.avail_in = static_cast<uInt>(read_size);
+            }
+
+            m_z_stream.next_out = reinterpret_cast<Bytef *>(m_out_buffer.data());
+            m_z_stream.avail_out = static_cast<uInt>(m_out_buffer.size());
+            int ret = inflate(&m_z_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                // rotated logs are often several gzip members concatenated together
+                member_open = false;
+                if (m_z_stream.avail_in == 0 &&
+                    traits_type::eq_int_type(m_source->sgetc(), traits_type::eof())) {
+                    m_end_of_stream = true;
+                } else {
+                    inflateReset(&m_z_stream);
+                    member_open = true;
+                }
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CORRUPT_GZIP);
+            }
+
+            size_t produced = m_out_buffer.size() - m_z_stream.avail_out;
+            if (produced > 0) {
+                setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data() + produced);
+                return traits_type::to_int_type(*gptr());
+            }
+        }
+        return traits_type::eof();
+    }
+
+    GzipOutputStreamBuffer::GzipOutputStreamBuffer(std::streambuf *sink)
+            : m_sink(sink),
+              m_z_stream(),
+              m_in_buffer(CompressionConstant::STREAM_BUFFER_SIZE),
+              m_out_buffer(CompressionConstant::STREAM_BUFFER_SIZE),
+              m_finished(false) {
+        if (deflateInit2(&m_z_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, CompressionConstant::GZIP_WINDOW_BITS,
+                         8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+        }
+        setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+    }
+
+    GzipOutputStreamBuffer::~GzipOutputStreamBuffer() {
+        try {
+            Finish();
+        } catch (const std::runtime_error &) {
+            // destructor must not throw, callers who care use Finish() directly
+        }
+        deflateEnd(&m_z_stream);
+    }
+
+    void GzipOutputStreamBuffer::Finish() {
+        if (m_finished) {
+            return;
+        }
+        m_finished = true;
+        Deflate_(Z_FINISH);
+        m_sink->pubsync();
+    }
+
+    GzipOutputStreamBuffer::int_type GzipOutputStreamBuffer::overflow(int_type ch) {
+        Deflate_(Z_NO_FLUSH);
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int GzipOutputStreamBuffer::sync() {
+        if (!m_finished) {
+            Deflate_(Z_NO_FLUSH);
+        }
+        return m_sink->pubsync();
+    }
+
+    void GzipOutputStreamBuffer::Deflate_(int flush) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "GzipOutputStreamBuffer::Deflate_");
+        m_z_stream.next_in = reinterpret_cast<Bytef *>(pbase());
+        m_z_stream.avail_in = static_cast<uInt>(pptr() - pbase());
+        int ret;
+        do {
+            m_z_stream.next_out = reinterpret_cast<Bytef *>(m_out_buffer.data());
+            m_z_stream.avail_out = static_cast<uInt>(m_out_buffer.size());
+            ret = deflate(&m_z_stream, flush);
+            if (ret == Z_STREAM_ERROR) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+            }
+            auto produced = static_cast<std::streamsize>(m_out_buffer.size() - m_z_stream.avail_out);
+            if (m_sink->sputn(m_out_buffer.data(), produced) != produced) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+            }
+        } while (m_z_stream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+        setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+    }
+
+    ////////////////////////////////// Zstd //////////////////////////////////
+#ifdef MYED_WITH_ZSTD
+    ZstdInputStreamBuffer::ZstdInputStreamBuffer(std::streambuf *source)
+            : m_source(source),
+              m_d_stream(ZSTD_createDStream()),
+              m_in_buffer(ZSTD_DStreamInSize()),
+              m_out_buffer(ZSTD_DStreamOutSize()),
+              m_in_pos(0),
+              m_in_size(0) {
+        if (m_d_stream == nullptr || ZSTD_isError(ZSTD_initDStream(static_cast<ZSTD_DStream *>(m_d_stream)))) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CORRUPT_ZSTD);
+        }
+    }
+
+    ZstdInputStreamBuffer::~ZstdInputStreamBuffer() {
+        ZSTD_freeDStream(static_cast<ZSTD_DStream *>(m_d_stream));
+    }
+
+    ZstdInputStreamBuffer::int_type ZstdInputStreamBuffer::underflow() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "ZstdInputStreamBuffer::underflow");
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        while (true) {
+            if (m_in_pos == m_in_size) {
+                std::streamsize read_size = m_source->sgetn(m_in_buffer.data(),
+                                                            static_cast<std::streamsize>(m_in_buffer.size()));
+                if (read_size <= 0) {
+                    return traits_type::eof();
+                }
+                m_in_pos = 0;
+                m_in_size = static_cast<size_t>(read_size);
+            }
+            ZSTD_inBuffer in_buffer = {m_in_buffer.data(), m_in_size, m_in_pos};
+            ZSTD_outBuffer out_buffer = {m_out_buffer.data(), m_out_buffer.size(), 0};
+            size_t ret = ZSTD_decompressStream(static_cast<ZSTD_DStream *>(m_d_stream), &out_buffer, &in_buffer);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CORRUPT_ZSTD);
+            }
+            m_in_pos = in_buffer.pos;
+            if (out_buffer.pos > 0) {
+                setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data() + out_buffer.pos);
+                return traits_type::to_int_type(*gptr());
+            }
+        }
+    }
+
+    ZstdOutputStreamBuffer::ZstdOutputStreamBuffer(std::streambuf *sink)
+            : m_sink(sink),
+              m_c_stream(ZSTD_createCStream()),
+              m_in_buffer(ZSTD_CStreamInSize()),
+              m_out_buffer(ZSTD_CStreamOutSize()),
+              m_finished(false) {
+        if (m_c_stream == nullptr ||
+            ZSTD_isError(ZSTD_initCStream(static_cast<ZSTD_CStream *>(m_c_stream),
+                                          CompressionConstant::ZSTD_LEVEL))) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+        }
+        setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+    }
+
+    ZstdOutputStreamBuffer::~ZstdOutputStreamBuffer() {
+        try {
+            Finish();
+        } catch (const std::runtime_error &) {
+            // destructor must not throw, callers who care use Finish() directly
+        }
+        ZSTD_freeCStream(static_cast<ZSTD_CStream *>(m_c_stream));
+    }
+
+    void ZstdOutputStreamBuffer::Finish() {
+        if (m_finished) {
+            return;
+        }
+        m_finished = true;
+        Compress_(true);
+        m_sink->pubsync();
+    }
+
+    ZstdOutputStreamBuffer::int_type ZstdOutputStreamBuffer::overflow(int_type ch) {
+        Compress_(false);
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int ZstdOutputStreamBuffer::sync() {
+        if (!m_finished) {
+            Compress_(false);
+        }
+        return m_sink->pubsync();
+    }
+
+    void ZstdOutputStreamBuffer::Compress_(bool end) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "ZstdOutputStreamBuffer::Compress_");
+        auto *c_stream = static_cast<ZSTD_CStream *>(m_c_stream);
+        ZSTD_inBuffer in_buffer = {pbase(), static_cast<size_t>(pptr() - pbase()), 0};
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out_buffer = {m_out_buffer.data(), m_out_buffer.size(), 0};
+            remaining = ZSTD_compressStream2(c_stream, &out_buffer, &in_buffer, end ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+            }
+            auto produced = static_cast<std::streamsize>(out_buffer.pos);
+            if (m_sink->sputn(m_out_buffer.data(), produced) != produced) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+            }
+        } while (in_buffer.pos < in_buffer.size || (end && remaining != 0));
+        setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+    }
+#endif
+
+    ////////////////////////////////// File Streams //////////////////////////////////
+    InputFileStream::InputFileStream(const std::string &file_name)
+            : std::istream(nullptr),
+              m_format(CompressionFormat::NONE) {
+        if (!m_file_buffer.Open(file_name)) {
+            setstate(std::ios::failbit);
+            return;
+        }
+        m_format = CompressionUtil::DetectFormat(&m_file_buffer);
+        switch (m_format) {
+            case CompressionFormat::GZIP:
+                m_decoder = std::make_unique<GzipInputStreamBuffer>(&m_file_buffer);
+                break;
+            case CompressionFormat::ZSTD:
+#ifdef MYED_WITH_ZSTD
+                m_decoder = std::make_unique<ZstdInputStreamBuffer>(&m_file_buffer);
+                break;
+#else
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_ZSTD_UNSUPPORTED);
+#endif
+            case CompressionFormat::NONE:
+                break;
+        }
+        rdbuf(m_decoder ? m_decoder.get() : &m_file_buffer);
+        // let decoding errors raised inside the streambuf reach the caller instead of a silent badbit
+        exceptions(std::ios::badbit);
+    }
+
+    bool InputFileStream::IsOpen() const {
+        return m_file_buffer.IsOpen();
+    }
+
+    CompressionFormat InputFileStream::GetFormat() const {
+        return m_format;
+    }
+
+    OutputFileStream::OutputFileStream(const std::string &file_name)
+            : OutputFileStream(file_name, CompressionUtil::FormatFromFileName(file_name)) {}
+
+    OutputFileStream::OutputFileStream(const std::string &file_name, CompressionFormat format)
+            : std::ostream(nullptr),
+              m_format(format) {
+#ifndef MYED_WITH_ZSTD
+        if (m_format == CompressionFormat::ZSTD) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_ZSTD_UNSUPPORTED);
+        }
+#endif
+        if (!m_file_buffer.Open(file_name)) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CANNOT_OPEN_FILE);
+        }
+        switch (m_format) {
+            case CompressionFormat::GZIP:
+                m_encoder = std::make_unique<GzipOutputStreamBuffer>(&m_file_buffer);
+                break;
+            case CompressionFormat::ZSTD:
+#ifdef MYED_WITH_ZSTD
+                m_encoder = std::make_unique<ZstdOutputStreamBuffer>(&m_file_buffer);
+#endif
+                break;
+            case CompressionFormat::NONE:
+                break;
+        }
+        rdbuf(m_encoder ? static_cast<std::streambuf *>(m_encoder.get()) : &m_file_buffer);
+        exceptions(std::ios::badbit);
+    }
+
+    OutputFileStream::~OutputFileStream() {
+        try {
+            Close();
+        } catch (const std::exception &) {
+            // destructor must not throw, callers who care use Close() directly
+        }
+    }
+
+    bool OutputFileStream::IsOpen() const {
+        return m_file_buffer.IsOpen();
+    }
+
+    CompressionFormat OutputFileStream::GetFormat() const {
+        return m_format;
+    }
+
+    void OutputFileStream::Close() {
+        if (!m_file_buffer.IsOpen()) {
+            return;
+        }
+        flush();
+        if (m_encoder) {
+            m_encoder->Finish();
+        }
+        if (!m_file_buffer.Close()) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_COMPRESS_FAILED);
+        }
+    }
+
+    ////////////////////////////////// Util //////////////////////////////////
+    CompressionFormat CompressionUtil::DetectFormat(std::streambuf *stream_buffer) {
+        unsigned char magic[sizeof(CompressionConstant::ZSTD_MAGIC)] = {};
+        std::streamsize read_size = stream_buffer->sgetn(reinterpret_cast<char *>(magic), sizeof(magic));
+        stream_buffer->pubseekpos(0, std::ios::in);
+        if (read_size >= static_cast<std::streamsize>(sizeof(CompressionConstant::ZSTD_MAGIC)) &&
+            std::memcmp(magic, CompressionConstant::ZSTD_MAGIC, sizeof(CompressionConstant::ZSTD_MAGIC)) == 0) {
+            return CompressionFormat::ZSTD;
+        }
+        if (read_size >= static_cast<std::streamsize>(sizeof(CompressionConstant::GZIP_MAGIC)) &&
+            std::memcmp(magic, CompressionConstant::GZIP_MAGIC, sizeof(CompressionConstant::GZIP_MAGIC)) == 0) {
+            return CompressionFormat::GZIP;
+        }
+        return CompressionFormat::NONE;
+    }
+
+    CompressionFormat CompressionUtil::FormatFromFileName(const std::string &file_name) {
+        auto ends_with = [&file_name](const std::string &suffix) {
+            return file_name.size() >= suffix.size() &&
+                   file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        if (ends_with(CompressionConstant::GZIP_SUFFIX)) {
+            return CompressionFormat::GZIP;
+        }
+        if (ends_with(CompressionConstant::ZSTD_SUFFIX)) {
+            return CompressionFormat::ZSTD;
+        }
+        return CompressionFormat::NONE;
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_io.h"
+
+namespace MyEd {
+
+    class CompressionConstant {
+    public:
+        constexpr static const size_t STREAM_BUFFER_SIZE = 1 << 16;
+        constexpr static const int GZIP_WINDOW_BITS = 15 + 16;       // zlib window with gzip wrapper
+        constexpr static const int GZIP_AUTO_WINDOW_BITS = 15 + 32;  // inflate detects gzip or zlib header
+        constexpr static const int ZSTD_LEVEL = 3;
+
+        constexpr static const unsigned char GZIP_MAGIC[] = {0x1f, 0x8b};
+        constexpr static const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+        constexpr static inline const char *GZIP_SUFFIX = ".gz";
+        constexpr static inline const char *ZSTD_SUFFIX = ".zst";
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_CANNOT_OPEN_FILE = "Cannot open file.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_CORRUPT_GZIP = "Corrupt gzip data.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_CORRUPT_ZSTD = "Corrupt zstd data.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_COMPRESS_FAILED = "Compression failed.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_ZSTD_UNSUPPORTED = "zstd support is not compiled in.";
+    };
+
+    enum class CompressionFormat {
+        NONE,
+        GZIP,
+        ZSTD
+    };
+
+    // streambuf which inflates a gzip stream read from another streambuf
+    class GzipInputStreamBuffer : public std::streambuf {
+    private:
+        std::streambuf *m_source;
+        z_stream m_z_stream;
+        std::vector<char> m_in_buffer;
+        std::vector<char> m_out_buffer;
+        bool m_end_of_stream;
+    public:
+        explicit GzipInputStreamBuffer(std::streambuf *source);
+        ~GzipInputStreamBuffer() override;
+
+    protected:
+        int_type underflow() override;
+    };
+
+    // output streambuf which has to write a trailer once all data are written
+    class CompressingStreamBuffer : public std::streambuf {
+    public:
+        virtual void Finish() = 0;
+    };
+
+    // streambuf which deflates everything written to it into another streambuf
+    class GzipOutputStreamBuffer : public CompressingStreamBuffer {
+    private:
+        std::streambuf *m_sink;
+        z_stream m_z_stream;
+        std::vector<char> m_in_buffer;
+        std::vector<char> m_out_buffer;
+        bool m_finished;
+    public:
+        explicit GzipOutputStreamBuffer(std::streambuf *sink);
+        ~GzipOutputStreamBuffer() override;
+
+        void Finish() override;
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        void Deflate_(int flush);
+    };
+
+#ifdef MYED_WITH_ZSTD
+    class ZstdInputStreamBuffer : public std::streambuf {
+    private:
+        std::streambuf *m_source;
+        void *m_d_stream;
+        std::vector<char> m_in_buffer;
+        std::vector<char> m_out_buffer;
+        size_t m_in_pos;
+        size_t m_in_size;
+    public:
+        explicit ZstdInputStreamBuffer(std::streambuf *source);
+        ~ZstdInputStreamBuffer() override;
+
+    protected:
+        int_type underflow() override;
+    };
+
+    class ZstdOutputStreamBuffer : public CompressingStreamBuffer {
+    private:
+        std::streambuf *m_sink;
+        void *m_c_stream;
+        std::vector<char> m_in_buffer;
+        std::vector<char> m_out_buffer;
+        bool m_finished;
+    public:
+        explicit ZstdOutputStreamBuffer(std::streambuf *sink);
+        ~ZstdOutputStreamBuffer() override;
+
+        void Finish() override;
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        void Compress_(bool end);
+    };
+#endif
+
+    // input file stream which transparently decompresses gzip/zstd content, detected by magic bytes
+    class InputFileStream : public std::istream {
+    private:
+        AsyncInputStreamBuffer m_file_buffer;
+        std::unique_ptr<std::streambuf> m_decoder;
+        CompressionFormat m_format;
+    public:
+        explicit InputFileStream(const std::string &file_name);
+
+        [[nodiscard]] bool IsOpen() const;
+        [[nodiscard]] CompressionFormat GetFormat() const;
+    };
+
+    // output file stream which compresses its content when the file name asks for it (.gz/.zst)
+    class OutputFileStream : public std::ostream {
+    private:
+        AsyncOutputStreamBuffer m_file_buffer;
+        std::unique_ptr<CompressingStreamBuffer> m_encoder;
+        CompressionFormat m_format;
+    public:
+        explicit OutputFileStream(const std::string &file_name);
+        // write file_name in the given format whatever its name, e.g. a temporary file standing in for another
+        OutputFileStream(const std::string &file_name, CompressionFormat format);
+        ~OutputFileStream() override;
+
+        [[nodiscard]] bool IsOpen() const;
+        [[nodiscard]] CompressionFormat GetFormat() const;
+
+        // flush all pending data, write the compression trailer and close the file
+        void Close();
+    };
+
+    class CompressionUtil {
+    public:
+        // detect the format of a stream by its magic bytes, without consuming any of them
+        static CompressionFormat DetectFormat(std::streambuf *stream_buffer);
+
+        static CompressionFormat FormatFromFileName(const std::string &file_name);
+    };
+}
@@ -3,7 +3,17 @@
 namespace MyEd {
     Editor::Editor()
             : m_buffer(nullptr),
-              m_buffer_prev(nullptr) {}
+              m_buffer_prev(nullptr),
+              m_input(&std::cin),
+              m_output(&OutputSink::Stdout()),
+              m_recorder(nullptr) {}
+
+    Editor::Editor(std::istream &input_stream, OutputSink &output_sink)
+            : m_buffer(nullptr),
+              m_buffer_prev(nullptr),
+              m_input(&input_stream),
+              m_output(&output_sink),
+              m_recorder(nullptr) {}
 
     Editor::~Editor() {
         delete m_buffer;
@@ -21,27 +31,76 @@ namespace MyEd {
             m_buffer = new File();
         }
 
-        std::ifstream stream(file_name);
+        InputFileStream stream(file_name);
         if (stream.good()) {
-            stream >> *m_buffer;
-            m_buffer->SetFileName(file_name);
+            LoadFromDisk_(stream, file_name);
             return true;
         } else {
             return false;
         }
     }
 
+    void Editor::SetInputOutput(std::istream &input_stream, OutputSink &output_sink) {
+        m_input = &input_stream;
+        m_output = &output_sink;
+    }
+
+    bool Editor::Run() {
+        std::string command;
+        do {
+            m_input->clear();
+            // the user may be waiting for the output, unless the next command is already there
+            if (m_input->rdbuf()->in_avail() <= 0) {
+                m_output->Flush();
+            }
+            std::getline(*m_input, command);
+            if (m_input->eof()) {
+                return true;
+            }
+            if (command == EditorConstants::EMPTY_STRING) {
+                command = EditorConstants::DEFAULT_COMMAND;
+            }
+        } while (InputCommand(command));
+        return false;
+    }
+
     void Editor::Destroys() {
+        ReapBackgroundJobs_(true);
+        m_follower.reset();
+        m_output->Flush();
         delete m_buffer;
         m_buffer = nullptr;
         delete m_buffer_prev;
         m_buffer_prev = nullptr;
     }
 
+    void Editor::SetRecorder(SessionRecorder *recorder) {
+        m_recorder = recorder;
+    }
+
     bool Editor::InputCommand(std::string command) {
         StringUtil::Trim(command);
+        if (m_recorder == nullptr) {
+            return ExecuteCommand_(command);
+        }
+        // the command line itself was read before, only what the command reads is its input
+        m_recorder->TakeInput();
+        m_recorder->TakeWaitTime();
+        auto start = std::chrono::steady_clock::now();
+        bool proceed = ExecuteCommand_(command);
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        // the time the user took to type inserted text or an answer is not the command's
+        uint64_t wait_ns = std::min(m_recorder->TakeWaitTime(), static_cast<uint64_t>(duration.count()));
+        m_recorder->Record(command, m_recorder->TakeInput(), static_cast<uint64_t>(duration.count()) - wait_ns);
+        return proceed;
+    }
+
+    bool Editor::ExecuteCommand_(const std::string &command) {
+        MYED_TRACE_SCOPE_DETAIL(TraceConstant::CATEGORY_EDITOR, "Editor::InputCommand", command);
         std::smatch smatch_params;
+        ReapBackgroundJobs_(false);
         try {
+            UpdateFollowedFile_();
             // q
             if (StringUtil::Match(command, EditorConstants::COMMAND_QUIT_EDITOR)) {
                 return QuitEditor_();
@@ -53,7 +112,7 @@ namespace MyEd {
                 ShowFileInfo_();
                 // (.,.)p
             } else if (StringUtil::Match(command, EditorConstants::COMMAND_PRINT, smatch_params)) {
-                Print_(smatch_params, std::cout);
+                Print_(smatch_params);
                 // (.,.)n
             } else if (StringUtil::Match(command, EditorConstants::COMMAND_PRINT_WITH_LINE_NUM, smatch_params)) {
                 PrintWithLineNum_(smatch_params);
@@ -93,6 +152,18 @@ namespace MyEd {
                 // ($)r file
             } else if (StringUtil::Match(command, EditorConstants::COMMAND_READ_AND_APPEND, smatch_params)) {
                 ReadAndAppend_(smatch_params);
+                // (.,.)sort [-n] [-r] [-b] [-k N] [-t D]
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_SORT, smatch_params)) {
+                Sort_(smatch_params);
+                // (.,.)cut -f LIST [-d D]
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_CUT, smatch_params)) {
+                Cut_(smatch_params);
+                // (.,.)uniq [-g]
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_UNIQ, smatch_params)) {
+                Uniq_(smatch_params);
+                // (1,$)bsearch [-n] [-r] [-b] [-k N] [-t D] /key/
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_BINARY_SEARCH, smatch_params)) {
+                BinarySearch_(smatch_params);
                 // (.,.)s/search/replacement/
                 // (.,.)s/search/replacement/g
                 // (.,.)s/search/replacement/n
@@ -101,19 +172,35 @@ namespace MyEd {
                 // u
             } else if (StringUtil::Match(command, EditorConstants::COMMAND_UNDOES, smatch_params)) {
                 Undoes_();
+                // (.)kx
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_MARK, smatch_params)) {
+                Mark_(smatch_params);
+                // /re/
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_SEARCH_FORWARD, smatch_params)) {
+                Search_(smatch_params, false);
+                // ?re?
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_SEARCH_BACKWARD, smatch_params)) {
+                Search_(smatch_params, true);
+                // F
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_FOLLOW)) {
+                ToggleFollow_();
+                // diff file
+            } else if (StringUtil::Match(command, EditorConstants::COMMAND_DIFF, smatch_params)) {
+                Diff_(smatch_params);
                 // others
             } else {
-                std::cout << EditorConstants::STR_WRONG_COMMAND << std::endl;
+                *m_output << EditorConstants::STR_WRONG_COMMAND << '\n';
             }
         } catch (const std::out_of_range &ex) {
-            std::cout << ex.what() << std::endl;
+            *m_output << ex.what() << '\n';
         } catch (const std::runtime_error &ex) {
-            std::cout << ex.what() << std::endl;
+            *m_output << ex.what() << '\n';
         }
         return true;
     }
 
     size_t Editor::HandleParam_(const std::string &str_param) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_PARSE, "Editor::HandleParam_");
         size_t ret;
         std::smatch smatch_n;// "n" of "+n" or "-n"
         // . or ""
@@ -123,6 +210,9 @@ namespace MyEd {
             // $
         } else if (StringUtil::Match(str_param, EditorConstants::MARK_LAST_LINE)) {
             ret = m_buffer->GetLineCount();
+            // 'x
+        } else if (StringUtil::Match(str_param, EditorConstants::MARK_MARKED_LINE, smatch_n)) {
+            ret = m_buffer->GetMarkedLine(smatch_n.str(1)[0]);
             // +n
         } else if (StringUtil::Match(str_param, EditorConstants::POSITIVE_NUMBER, smatch_n)) {
             size_t num_n = 1; // default n when str_param is only a "+"
@@ -154,14 +244,14 @@ namespace MyEd {
         return ret;
     }
 
-    bool Editor::GetUserInputLine_(std::string &ret) {
+    bool Editor::GetUserInputLine_(std::string &ret) const {
         std::string tmp;
         std::smatch smatch_quit_mark;
         // read from input stream until getting a single "\.\n" or a "xxx\n.\n"
         do {
             char ch;
-            std::cin.get(ch);
-            if (std::cin.eof()) {
+            m_input->get(ch);
+            if (m_input->eof()) {
                 return false;
             }
             tmp += ch;
@@ -184,8 +274,12 @@ namespace MyEd {
         if (m_buffer->GetModifyStatus()) {
             std::string answer;
             do {
-                std::cout << EditorConstants::STR_QUIT_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING << std::flush;
-                std::getline(std::cin, answer);
+                *m_output << EditorConstants::STR_QUIT_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING;
+                m_output->Flush();
+                // no answer will ever come, stay in the editor
+                if (!std::getline(*m_input, answer)) {
+                    return true;
+                }
                 if (StringUtil::Match(answer, EditorConstants::ANSWER_YES)) {
                     return QuitEditorUnconditionally_();
                 } else if (StringUtil::Match(answer, EditorConstants::ANSWER_NO)) {
@@ -201,27 +295,30 @@ namespace MyEd {
     }
 
     void Editor::ShowFileInfo_() const {
-        std::cout << EditorConstants::STR_SHOW_FILE_INFO_BEGIN << std::endl
-                  << EditorConstants::STR_FILE_NAME << m_buffer->GetFileName() << std::endl
-                  << EditorConstants::STR_LINE_COUNT << m_buffer->GetLineCount() << std::endl
-                  << EditorConstants::STR_CURRENT_LINE << m_buffer->GetCurrentLineNum() << std::endl
-                  << EditorConstants::STR_MODIFIED_BUT_NOT_SAVED << m_buffer->GetModifyStatus() << std::endl
-                  << EditorConstants::STR_SHOW_FILE_INFO_END << std::endl;
+        *m_output << EditorConstants::STR_SHOW_FILE_INFO_BEGIN << '\n'
+                  << EditorConstants::STR_FILE_NAME << m_buffer->GetFileName() << '\n'
+                  << EditorConstants::STR_LINE_COUNT << m_buffer->GetLineCount() << '\n'
+                  << EditorConstants::STR_CURRENT_LINE << m_buffer->GetCurrentLineNum() << '\n'
+                  << EditorConstants::STR_MODIFIED_BUT_NOT_SAVED << m_buffer->GetModifyStatus() << '\n'
+                  << EditorConstants::STR_SHOW_FILE_INFO_END << '\n';
     }
 
-    void Editor::Print_(const std::smatch &smatch_params, std::ostream &output_stream) {
+    void Editor::Print_(const std::smatch &smatch_params) {
         // (line_from,line_to)p
         if (StringUtil::Match(smatch_params[3], EditorConstants::COMMA)) {
             size_t line_from = HandleParam_(smatch_params[2]);
             size_t line_to = HandleParam_(smatch_params[4]);
             m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
-            std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_from, line_to);
-            output_stream << StringUtil::Combine(lines);
+            m_buffer->ForEachLine(line_from, line_to, [this](size_t, const LineText &line) {
+                *m_output << line;
+            });
             // (line)p
         } else {
             size_t line_num = HandleParam_(smatch_params[1]);
             m_buffer->ValidateReadUpdateDeleteParam(line_num);
-            output_stream << m_buffer->GetLine(line_num);
+            m_buffer->ForEachLine(line_num, line_num, [this](size_t, const LineText &line) {
+                *m_output << line;
+            });
         }
     }
 
@@ -231,16 +328,16 @@ namespace MyEd {
             size_t line_from = HandleParam_(smatch_params[2]);
             size_t line_to = HandleParam_(smatch_params[4]);
             m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
-            std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_from, line_to);
-            for (auto &line: lines) {
-                std::cout << line_from << EditorConstants::LINE_PRINT_DIVIDER << line;
-                ++line_from;
-            }
+            m_buffer->ForEachLine(line_from, line_to, [this](size_t line_num, const LineText &line) {
+                *m_output << line_num << EditorConstants::LINE_PRINT_DIVIDER << line;
+            });
             // (line)p
         } else {
             size_t line_num = HandleParam_(smatch_params[1]);
             m_buffer->ValidateReadUpdateDeleteParam(line_num);
-            std::cout << line_num << EditorConstants::LINE_PRINT_DIVIDER << m_buffer->GetLine(line_num);
+            m_buffer->ForEachLine(line_num, line_num, [this](size_t line_num, const LineText &line) {
+                *m_output << line_num << EditorConstants::LINE_PRINT_DIVIDER << line;
+            });
         }
     }
 
@@ -269,8 +366,9 @@ namespace MyEd {
         if (line_to > m_buffer->GetLineCount()) {
             line_to = m_buffer->GetLineCount();
         }
-        std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_from, line_to);
-        std::cout << StringUtil::Combine(lines);
+        m_buffer->ForEachLine(line_from, line_to, [this](size_t, const LineText &line) {
+            *m_output << line;
+        });
     }
 
     void Editor::Append_(const std::smatch &smatch_params) {
@@ -345,14 +443,7 @@ namespace MyEd {
             m_buffer->ValidateReadUpdateDeleteParams(line_src_from, line_src_to);
             m_buffer->ValidateInsertParam(line_dst);
             SavePrev_(*m_buffer);
-            std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_src_from, line_src_to);
-            m_buffer->EraseLinesFromTo(line_src_from, line_src_to);
-            if (line_dst > line_src_from && line_dst <= line_src_to + 1) {
-                line_dst = line_src_from;
-            } else if (line_dst > line_src_to + 1) {
-                line_dst -= (line_src_to - line_src_from + 1);
-            }
-            m_buffer->InsertOneOrMultiplyLines(line_dst, StringUtil::Combine(lines));
+            m_buffer->MoveLines(line_src_from, line_src_to, line_dst);
             // (line_src)m(line_dst)
         } else {
             size_t line_src = HandleParam_(smatch_params[1]);
@@ -360,13 +451,7 @@ namespace MyEd {
             m_buffer->ValidateReadUpdateDeleteParam(line_src);
             m_buffer->ValidateInsertParam(line_dst);
             SavePrev_(*m_buffer);
-            std::string line = m_buffer->GetLine(line_src);
-            m_buffer->EraseLine(line_src);
-            if (line_dst > line_src) {
-                line_dst -= 1;
-            }
-            m_buffer->InsertOneOrMultiplyLines(line_dst, line);
-
+            m_buffer->MoveLines(line_src, line_src, line_dst);
         }
         m_buffer->SetModifyStatus(true);
     }
@@ -380,8 +465,7 @@ namespace MyEd {
             m_buffer->ValidateReadUpdateDeleteParams(line_src_from, line_src_to);
             m_buffer->ValidateInsertParam(line_dst);
             SavePrev_(*m_buffer);
-            std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_src_from, line_src_to);
-            m_buffer->InsertOneOrMultiplyLines(line_dst, StringUtil::Combine(lines));
+            m_buffer->CopyLines(line_src_from, line_src_to, line_dst);
             // (line_src)t(line_dst)
         } else {
             size_t line_src = HandleParam_(smatch_params[1]);
@@ -389,9 +473,7 @@ namespace MyEd {
             m_buffer->ValidateReadUpdateDeleteParam(line_src);
             m_buffer->ValidateInsertParam(line_dst);
             SavePrev_(*m_buffer);
-            std::string line = m_buffer->GetLine(line_src);
-            m_buffer->InsertOneOrMultiplyLines(line_dst, line);
-
+            m_buffer->CopyLines(line_src, line_src, line_dst);
         }
         m_buffer->SetModifyStatus(true);
     }
@@ -415,14 +497,25 @@ namespace MyEd {
         }
         m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
         SavePrev_(*m_buffer);
-        std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_from, line_to);
-        m_buffer->EraseLinesFromTo(line_from, line_to);
-        m_buffer->InsertOneOrMultiplyLines(line_from, StringUtil::Combine(
-                StringUtil::Split(StringUtil::Combine(lines), EditorConstants::NEWLINE_CODE)));
+        // the joined line is made of the pieces of the lines, without their newlines
+        LineTextBuilder builder;
+        for (const Line &line: m_buffer->GetSharedLinesFromTo(line_from, line_to)) {
+            size_t size = line->Size();
+            if (line->EndsWith(FileConstant::FILE_DELIMITER)) {
+                size -= std::string_view(FileConstant::FILE_DELIMITER).size();
+            }
+            builder.Append(*line, 0, size);
+        }
+        builder.Append(FileConstant::FILE_DELIMITER);
+        if (line_to > line_from) {
+            m_buffer->EraseLinesFromTo(line_from + 1, line_to);
+        }
+        m_buffer->ReplaceLine(line_from, builder.Build());
         m_buffer->SetModifyStatus(true);
     }
 
     void Editor::Write_(const std::smatch &smatch_params) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_EDITOR, "Editor::Write_");
         size_t line_from;
         size_t line_to;
         std::string path;
@@ -458,17 +551,50 @@ namespace MyEd {
             path = smatch_params[2];
         }
 
+        // (.,$)w file & writes a snapshot on another thread while editing goes on
+        bool background = false;
+        std::smatch smatch_background;
+        if (StringUtil::Match(path, EditorConstants::BACKGROUND_MARK, smatch_background)) {
+            path = smatch_background[1];
+            background = true;
+        }
+
+        // a bare w writes to the file being edited
+        if (path.empty()) {
+            if (m_buffer->GetFileName() == FileConstant::DEFAULT_FILE_NAME) {
+                throw std::runtime_error(EditorConstants::STR_NO_FILE_NAME);
+            }
+            path = m_buffer->GetFileName();
+        }
+
         m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
+        ReapBackgroundJobs_(true);
         // ?
         //SavePrev_(*m_buffer);
-        size_t current_line_num = m_buffer->GetCurrentLineNum();
-        std::vector<std::string> lines = m_buffer->GetLinesFromTo(line_from, line_to);
-        // to keep current line num same as before
-        m_buffer->SetCurrentLineNum(current_line_num);
-        std::ofstream of_stream(path);
-        of_stream << StringUtil::Combine(lines);
+        // lines are streamed straight into the (possibly compressing) file, current line num is kept unchanged
+        FileSnapshot snapshot = m_buffer->Snapshot();
+        bool whole_buffer = line_from == 1 && line_to == m_buffer->GetLineCount();
+        FileDiskState disk_state;
+        if (background) {
+            // the state of the file is only known once the job is done, the next save rewrites it completely
+            m_background_jobs.push_back({"w " + path, std::async(std::launch::async, [snapshot, path, line_from, line_to]() {
+                FileWriter::WriteAtomically(snapshot, path, line_from, line_to);
+                return std::string();
+            })});
+        } else if (whole_buffer && path == m_buffer->GetFileName() && m_buffer->GetDiskState().valid &&
+                   m_buffer->GetDiskState() == FileUtil::GetDiskState(path)) {
+            // nobody touched the file since we loaded or saved it, so its clean prefix is kept as it is
+            size_t first_dirty_line = std::min(m_buffer->GetFirstDirtyLine(), m_buffer->GetLineCount() + 1);
+            disk_state = FileWriter::WriteTail(snapshot, path, first_dirty_line);
+        } else {
+            disk_state = FileWriter::WriteAtomically(snapshot, path, line_from, line_to);
+        }
+        m_buffer->MarkSaved(whole_buffer ? disk_state : FileDiskState());
         m_buffer->SetFileName(path);
         m_buffer->SetModifyStatus(false);
+        if (m_follower != nullptr) {
+            FollowBuffer_();
+        }
     }
 
     void Editor::Edit_(const std::smatch &smatch_params) {
@@ -483,8 +609,11 @@ namespace MyEd {
 
         std::string answer;
         do {
-            std::cout << EditorConstants::STR_LOAD_NEW_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING << std::flush;
-            std::getline(std::cin, answer);
+            *m_output << EditorConstants::STR_LOAD_NEW_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING;
+            m_output->Flush();
+            if (!std::getline(*m_input, answer)) {
+                return;
+            }
             if (StringUtil::Match(answer, EditorConstants::ANSWER_YES)) {
                 EditUnconditionally_(smatch_params);
                 return;
@@ -499,11 +628,11 @@ namespace MyEd {
         if (!FileUtil::IsFileExists(in_file_path)) {
             throw std::runtime_error(EditorConstants::STR_FILE_DOESNT_EXIST_WARING);
         }
+        ReapBackgroundJobs_(true);
         SavePrev_(*m_buffer);
-        std::ifstream if_stream(in_file_path);
-        if_stream >> *m_buffer;
+        InputFileStream if_stream(in_file_path);
+        LoadFromDisk_(if_stream, in_file_path);
         m_buffer->SetCurrentLineNum(m_buffer->GetLineCount());
-        m_buffer->SetFileName(in_file_path);
         m_buffer->SetModifyStatus(false);
     }
 
@@ -520,9 +649,15 @@ namespace MyEd {
         if (!FileUtil::IsFileExists(in_file_path)) {
             throw std::runtime_error(EditorConstants::STR_FILE_DOESNT_EXIST_WARING);
         }
+        ReapBackgroundJobs_(true);
         SavePrev_(*m_buffer);
-        std::ifstream if_stream(in_file_path);
-        m_buffer->InsertOneOrMultiplyLines(line_num, if_stream);
+        InputFileStream if_stream(in_file_path);
+        std::unique_ptr<LineReader> line_reader = MapForReading_(if_stream, in_file_path);
+        if (line_reader != nullptr) {
+            m_buffer->InsertOneOrMultiplyLines(line_num, *line_reader);
+        } else {
+            m_buffer->InsertOneOrMultiplyLines(line_num, if_stream);
+        }
         m_buffer->SetModifyStatus(true);
     }
 
@@ -553,55 +688,102 @@ namespace MyEd {
         File file_prev = *m_buffer;
         bool replaced = false;
 
-        // (.,.)s/search/replacement/g replace all specified word in (.,.)
-        if (StringUtil::Match(search_mode, EditorConstants::GLOBAL)) {
-            while (line_from <= line_to) {
-                std::string tmp = m_buffer->GetLine(line_from);
-                if (StringUtil::ReplaceAll(tmp, search_word, replacement)) {
-                    m_buffer->EraseLine(line_from);
-                    m_buffer->InsertOneOrMultiplyLines(line_from, tmp);
-                    current_line_num = line_from;
-                    m_buffer->SetModifyStatus(true);
-                    replaced = true;
+        // (.,.)s/search/replacement/g replaces every occurrence, (.,.)s/search/replacement/ the first one and
+        // (.,.)s/search/replacement/n the n-th one of each line of (.,.); search is plain text unless an r follows
+        bool regex_mode = !search_mode.empty() && search_mode.back() == EditorConstants::REGEX_MODE;
+        if (regex_mode) {
+            search_mode.pop_back();
+        }
+        bool global = StringUtil::Match(search_mode, EditorConstants::GLOBAL);
+        size_t n = 1;
+        if (!global && !StringUtil::Match(search_mode, EditorConstants::EMPTY_STRING_MARK)) {
+            n = HandleParam_(search_mode);
+        }
+        // the replacement of a regex may refer to what it matched
+        std::shared_ptr<Regex> regex;
+        bool needs_groups = false;
+        if (regex_mode) {
+            regex = RegexCache::Instance().Get(search_word);
+            for (size_t i = 0; i + 1 < replacement.size(); ++i) {
+                if (replacement[i] != '\\') {
+                    continue;
                 }
-                ++line_from;
-            }
-            // (.,.)s/search/replacement/ replace the first specified word found in (.,.)
-        } else if (StringUtil::Match(search_mode, EditorConstants::EMPTY_STRING_MARK)) {
-            while (line_from <= line_to) {
-                std::string tmp = m_buffer->GetLine(line_from);
-                std::string::size_type pos;
-                if ((pos = StringUtil::NthSubstr(1, tmp, search_word)) != -1) {
-                    tmp.replace(pos, search_word.size(), replacement);
-                    m_buffer->EraseLine(line_from);
-                    m_buffer->InsertOneOrMultiplyLines(line_from, tmp);
-                    current_line_num = line_from;
-                    m_buffer->SetModifyStatus(true);
-                    replaced = true;
+                ++i;
+                if (std::isdigit(static_cast<unsigned char>(replacement[i]))) {
+                    if (replacement[i] == '0' || static_cast<size_t>(replacement[i] - '0') > regex->GetGroupCount()) {
+                        throw std::runtime_error(EditorConstants::STR_INVALID_GROUP_REFERENCE);
+                    }
+                    needs_groups = true;
                 }
-                ++line_from;
             }
-            // (.,.)s/search/replacement/n replace the n-th specified word found in (.,.)
-        } else {
-            size_t n = HandleParam_(search_mode);
-            while (line_from <= line_to) {
-                std::string tmp = m_buffer->GetLine(line_from);
-                std::string::size_type pos;
-                size_t i = 1;
-                while ((pos = StringUtil::NthSubstr(i, tmp, search_word)) != -1) {
-                    if (i == n) {
-                        tmp.replace(pos, search_word.size(), replacement);
-                        m_buffer->EraseLine(line_from);
-                        m_buffer->InsertOneOrMultiplyLines(line_from, tmp);
-                        current_line_num = line_from;
-                        m_buffer->SetModifyStatus(true);
-                        replaced = true;
-                        break;
+        }
+        LineTextBuilder builder;
+        std::vector<size_t> groups;
+        for (; line_from <= line_to; ++line_from) {
+            Line line = m_buffer->GetSharedLine(line_from);
+            // [begin, end) of the occurrences to replace, and what replaces each of them
+            std::vector<std::pair<size_t, size_t>> found;
+            std::vector<std::string> replacements;
+            if (regex != nullptr) {
+                std::string flattened;
+                std::string_view text = line->GetView(flattened);
+                if (line->EndsWith(FileConstant::FILE_DELIMITER)) {
+                    text.remove_suffix(std::string_view(FileConstant::FILE_DELIMITER).size());
+                }
+                size_t count = 0;
+                size_t match_begin;
+                size_t match_end;
+                for (size_t from = 0; from <= text.size() && regex->Search(text, from, match_begin, match_end);) {
+                    if (global || ++count == n) {
+                        if (needs_groups) {
+                            regex->GetGroups(text, match_begin, groups);
+                        } else {
+                            groups = {match_begin, match_end};
+                        }
+                        found.emplace_back(match_begin, match_end);
+                        replacements.push_back(ExpandReplacement_(replacement, text, groups));
+                        if (!global) {
+                            break;
+                        }
                     }
-                    ++i;
+                    // an empty match is not found again at the same place
+                    from = match_end == match_begin ? match_end + 1 : match_end;
                 }
-                ++line_from;
+            } else {
+                std::vector<size_t> starts;
+                if (search_word.empty()) {
+                    // an empty search word is only found at the start of the line, and never by g
+                    if (!global) {
+                        starts = {0};
+                    }
+                } else if (global) {
+                    starts = line->FindAll(search_word, std::numeric_limits<size_t>::max());
+                } else {
+                    starts = line->FindAll(search_word, n);
+                    starts = starts.size() == n ? std::vector<size_t>{starts.back()} : std::vector<size_t>();
+                }
+                for (size_t start: starts) {
+                    found.emplace_back(start, start + search_word.size());
+                    replacements.push_back(replacement);
+                }
+            }
+            if (found.empty()) {
+                continue;
+            }
+            // the new line shares everything but the pieces around the replacements with the old one
+            size_t pos = 0;
+            for (size_t i = 0; i < found.size(); ++i) {
+                builder.Append(*line, pos, found[i].first).Append(replacements[i]);
+                pos = found[i].second;
             }
+            builder.Append(*line, pos, line->Size());
+            if (!line->EndsWith(FileConstant::FILE_DELIMITER)) {
+                builder.Append(FileConstant::FILE_DELIMITER);
+            }
+            m_buffer->ReplaceLine(line_from, builder.Build());
+            current_line_num = line_from;
+            m_buffer->SetModifyStatus(true);
+            replaced = true;
         }
 
         m_buffer->SetCurrentLineNum(current_line_num);
@@ -611,6 +793,33 @@ namespace MyEd {
         }
     }
 
+    std::string Editor::ExpandReplacement_(const std::string &replacement, std::string_view text,
+                                           const std::vector<size_t> &groups) {
+        std::string expanded;
+        auto append_group = [&expanded, &text, &groups](size_t group) {
+            // a group which did not take part in the match is empty
+            if (groups[2 * group] != std::string::npos) {
+                expanded.append(text.substr(groups[2 * group], groups[2 * group + 1] - groups[2 * group]));
+            }
+        };
+        for (size_t i = 0; i < replacement.size(); ++i) {
+            char ch = replacement[i];
+            if (ch == '&') {
+                append_group(0);
+            } else if (ch == '\\' && i + 1 < replacement.size()) {
+                ch = replacement[++i];
+                if (std::isdigit(static_cast<unsigned char>(ch))) {
+                    append_group(static_cast<size_t>(ch - '0'));
+                } else {
+                    expanded.push_back(ch);
+                }
+            } else {
+                expanded.push_back(ch);
+            }
+        }
+        return expanded;
+    }
+
     void Editor::SavePrev_(const File &file) {
         if (m_buffer_prev == nullptr) {
             m_buffer_prev = new File(file);
@@ -624,6 +833,426 @@ namespace MyEd {
             File *tmp = m_buffer;
             m_buffer = m_buffer_prev;
             m_buffer_prev = tmp;
+            // lines appended to the followed file meanwhile are read again
+            if (m_follower != nullptr) {
+                FollowBuffer_();
+            }
+        }
+    }
+
+    void Editor::Mark_(const std::smatch &smatch_params) {
+        size_t line_num = HandleParam_(smatch_params[1]);
+        m_buffer->SetMark(smatch_params.str(2)[0], line_num);
+    }
+
+    void Editor::Sort_(const std::smatch &smatch_params) {
+        size_t line_from;
+        size_t line_to;
+        std::string options;
+        // (line_from,line_to)sort
+        if (StringUtil::Match(smatch_params[4], EditorConstants::COMMA)) {
+            line_from = HandleParam_(smatch_params[3]);
+            line_to = HandleParam_(smatch_params[5]);
+            options = smatch_params[6];
+            // (line)sort
+        } else {
+            line_from = HandleParam_(smatch_params[1]);
+            line_to = line_from;
+            options = smatch_params[2];
+        }
+        SortOptions sort_options = LineSorter::ParseOptions(options);
+        m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
+
+        LineViewStorage storage;
+        std::vector<std::string_view> views = m_buffer->GetLineViews(line_from, line_to, storage);
+        std::vector<size_t> order = LineSorter::SortedOrder(views, sort_options);
+        SavePrev_(*m_buffer);
+        m_buffer->ReorderLines(line_from, order);
+        m_buffer->SetModifyStatus(true);
+    }
+
+    void Editor::Cut_(const std::smatch &smatch_params) {
+        size_t line_from;
+        size_t line_to;
+        std::string options;
+        // (line_from,line_to)cut
+        if (StringUtil::Match(smatch_params[4], EditorConstants::COMMA)) {
+            line_from = HandleParam_(smatch_params[3]);
+            line_to = HandleParam_(smatch_params[5]);
+            options = smatch_params[6];
+            // (line)cut
+        } else {
+            line_from = HandleParam_(smatch_params[1]);
+            line_to = line_from;
+            options = smatch_params[2];
+        }
+        CutOptions cut_options = FieldCutter::ParseOptions(options);
+        m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
+
+        std::vector<Line> lines = m_buffer->GetSharedLinesFromTo(line_from, line_to);
+        std::vector<Line> cut_lines = FieldCutter::Cut(lines, cut_options);
+        if (std::equal(lines.begin(), lines.end(), cut_lines.begin())) {
+            return;
+        }
+        SavePrev_(*m_buffer);
+        m_buffer->ReplaceLines(line_from, std::move(cut_lines));
+        m_buffer->SetModifyStatus(true);
+    }
+
+    void Editor::Uniq_(const std::smatch &smatch_params) {
+        size_t line_from;
+        size_t line_to;
+        std::string options;
+        // (line_from,line_to)uniq
+        if (StringUtil::Match(smatch_params[4], EditorConstants::COMMA)) {
+            line_from = HandleParam_(smatch_params[3]);
+            line_to = HandleParam_(smatch_params[5]);
+            options = smatch_params[6];
+            // (line)uniq
+        } else {
+            line_from = HandleParam_(smatch_params[1]);
+            line_to = line_from;
+            options = smatch_params[2];
+        }
+        bool global = LineDeduper::ParseGlobalOption(options);
+        m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
+
+        LineViewStorage storage;
+        std::vector<std::string_view> views = m_buffer->GetLineViews(line_from, line_to, storage);
+        std::vector<bool> keep = LineDeduper::KeepFirst(views, global);
+        if (std::find(keep.begin(), keep.end(), false) == keep.end()) {
+            return;
+        }
+        SavePrev_(*m_buffer);
+        m_buffer->RetainLines(line_from, keep);
+        m_buffer->SetModifyStatus(true);
+    }
+
+    void Editor::BinarySearch_(const std::smatch &smatch_params) {
+        size_t line_from;
+        size_t line_to;
+        std::string options;
+        std::string key;
+        // (line_from,line_to)bsearch /key/
+        if (StringUtil::Match(smatch_params[5], EditorConstants::COMMA)) {
+            if (StringUtil::Match(smatch_params[4], EditorConstants::EMPTY_STRING_MARK)) {
+                line_from = 1;
+            } else {
+                line_from = HandleParam_(smatch_params[4]);
+            }
+            if (StringUtil::Match(smatch_params[6], EditorConstants::EMPTY_STRING_MARK)) {
+                line_to = m_buffer->GetLineCount();
+            } else {
+                line_to = HandleParam_(smatch_params[6]);
+            }
+            options = smatch_params[7];
+            key = smatch_params[8];
+            // (line_from)bsearch /key/ searches from line_from to the last line
+        } else {
+            if (StringUtil::Match(smatch_params[1], EditorConstants::EMPTY_STRING_MARK)) {
+                line_from = 1;
+            } else {
+                line_from = HandleParam_(smatch_params[1]);
+            }
+            line_to = m_buffer->GetLineCount();
+            options = smatch_params[2];
+            key = smatch_params[3];
+        }
+        m_buffer->ValidateReadUpdateDeleteParams(line_from, line_to);
+        SortOptions sort_options = LineSorter::ParseOptions(options);
+
+        // lines of [line_from, low) sort before key, those of [high, line_to] do not.
+        // Probing a line makes it current, a search which finds nothing leaves the current line as it was
+        size_t current_line_num = m_buffer->GetCurrentLineNum();
+        size_t low = line_from;
+        size_t high = line_to + 1;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            Line line = m_buffer->GetSharedLine(middle);
+            std::string flattened;
+            std::string_view text = line->GetView(flattened);
+            if (LineSorter::KeyBefore(text, key, sort_options)) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low > line_to) {
+            m_buffer->SetCurrentLineNum(current_line_num);
+            throw std::runtime_error(EditorConstants::STR_NO_MATCH);
+        }
+        m_buffer->SetCurrentLineNum(low);
+        m_buffer->ForEachLine(low, low, [this](size_t, const LineText &line) {
+            *m_output << line;
+        });
+    }
+
+    void Editor::Search_(const std::smatch &smatch_params, bool backward) {
+        std::string pattern = smatch_params[1];
+        if (pattern.empty()) {
+            if (m_last_search_pattern.empty()) {
+                throw std::runtime_error(EditorConstants::STR_NO_PREVIOUS_PATTERN);
+            }
+            pattern = m_last_search_pattern;
+        }
+        m_last_search_pattern = pattern;
+        if (m_buffer->GetLineCount() == 0) {
+            throw std::runtime_error(EditorConstants::STR_NO_MATCH);
+        }
+
+        size_t current_line_num = m_buffer->GetCurrentLineNum();
+        bool is_literal = pattern.find_first_of(EditorConstants::REGEX_SPECIAL_CHARACTERS) == std::string::npos;
+        if (smatch_params[2].matched) {
+            // a regex of its own, the cached ones are not to be shared between threads
+            std::shared_ptr<Regex> regex = is_literal ? nullptr : std::make_shared<Regex>(pattern);
+            FileSnapshot snapshot = m_buffer->Snapshot();
+            std::string description = (backward ? "?" : "/") + pattern + (backward ? "?" : "/");
+            m_background_jobs.push_back({description, std::async(std::launch::async, [snapshot, pattern, regex,
+                                                                                        current_line_num, backward]() {
+                CharRange chars = snapshot.GetCharRange(1, snapshot.GetLineCount());
+                size_t found = FindMatchingLine_(chars, snapshot.GetLineCount(), pattern, regex.get(),
+                                                 current_line_num, backward);
+                if (found == snapshot.GetLineCount()) {
+                    return std::string(EditorConstants::STR_NO_MATCH) + '\n';
+                }
+                return std::to_string(found + 1) + '\t' + snapshot.GetLine(found + 1);
+            })});
+            return;
+        }
+
+        // the buffer is searched where it is stored, a match may span lines
+        CharRange chars = m_buffer->GetCharRange(1, m_buffer->GetLineCount());
+        std::shared_ptr<Regex> regex;
+        if (!is_literal) {
+            regex = RegexCache::Instance().Get(pattern);
+        }
+        size_t found = FindMatchingLine_(chars, m_buffer->GetLineCount(), pattern, regex.get(), current_line_num,
+                                         backward);
+        if (found == m_buffer->GetLineCount()) {
+            throw std::runtime_error(EditorConstants::STR_NO_MATCH);
+        }
+        m_buffer->ForEachLine(found + 1, found + 1, [this](size_t, const LineText &line) {
+            *m_output << line;
+        });
+    }
+
+    size_t Editor::FindMatchingLine_(const CharRange &chars, size_t line_count, const std::string &pattern,
+                                     Regex *regex, size_t current_line_num, bool backward) {
+        using Iterator = CharRange::Iterator;
+        // line index of the first match starting in a line of [from, to), the line count when there is none.
+        // Like in ed the match may go on past to, e.g. into the line the search started from.
+        auto find = [&](Iterator from, Iterator to) {
+            size_t found = line_count;
+            if (regex == nullptr) {
+                found = chars.Find(from, pattern).GetLineIndex();
+            } else {
+                Iterator match_begin;
+                if (chars.Search(from, *regex, match_begin)) {
+                    found = std::min(match_begin.GetLineIndex(), line_count - 1);
+                }
+            }
+            return found < to.GetLineIndex() ? found : line_count;
+        };
+        // line index of the last match starting in [from, to)
+        auto find_last = [&](Iterator from, Iterator to) {
+            size_t last = line_count;
+            for (size_t found; (found = find(from, to)) < line_count; ) {
+                last = found;
+                if (found + 1 >= to.GetLineIndex()) {
+                    break;
+                }
+                from = chars.LineBegin(found + 1);
+            }
+            return last;
+        };
+
+        // 0-based index of the current line is current_line_num - 1
+        size_t found;
+        if (!backward) {
+            // after the current line, then from the top down to it
+            Iterator split = chars.LineBegin(current_line_num);
+            found = find(split, chars.end());
+            if (found == line_count) {
+                found = find(chars.begin(), split);
+            }
+        } else {
+            // before the current line, then from the bottom up to it
+            Iterator split = chars.LineBegin(current_line_num == 0 ? 0 : current_line_num - 1);
+            found = find_last(chars.begin(), split);
+            if (found == line_count) {
+                found = find_last(split, chars.end());
+            }
+        }
+        return found;
+    }
+
+    void Editor::ToggleFollow_() {
+        if (m_follower != nullptr) {
+            *m_output << EditorConstants::STR_FOLLOWING_STOPPED << m_follower->GetFileName() << '\n';
+            m_follower.reset();
+            return;
+        }
+        if (m_buffer->GetFileName() == FileConstant::DEFAULT_FILE_NAME) {
+            throw std::runtime_error(EditorConstants::STR_NO_FILE_NAME);
+        }
+        FollowBuffer_();
+        if (!m_buffer->GetDiskState().valid && !m_buffer->GetModifyStatus()) {
+            // e.g. the file grew while it was loaded or ends without newline: load it again to know which of its
+            // bytes the buffer holds
+            std::string file_name = m_buffer->GetFileName();
+            InputFileStream if_stream(file_name);
+            if (if_stream.good()) {
+                size_t current_line_num = m_buffer->GetCurrentLineNum();
+                LoadFromDisk_(if_stream, file_name);
+                m_buffer->SetCurrentLineNum(std::min(current_line_num, m_buffer->GetLineCount()));
+            }
+        }
+        *m_output << EditorConstants::STR_FOLLOWING << m_follower->GetFileName() << '\n';
+    }
+
+    void Editor::Diff_(const std::smatch &smatch_params) {
+        std::string path = smatch_params[1];
+        if (path.empty()) {
+            if (m_buffer->GetFileName() == FileConstant::DEFAULT_FILE_NAME) {
+                throw std::runtime_error(EditorConstants::STR_NO_FILE_NAME);
+            }
+            path = m_buffer->GetFileName();
+        }
+        MappedText file_text(path);
+        std::string_view text = file_text.GetText();
+        size_t line_count = m_buffer->GetLineCount();
+
+        // lines before the first dirty one are the file's own when nobody touched it since we loaded or saved
+        // it: they are neither read nor compared, except the few shown as context
+        size_t clean_lines = 0;
+        if (path == m_buffer->GetFileName() && m_buffer->GetDiskState().valid &&
+            m_buffer->GetDiskState() == FileUtil::GetDiskState(path)) {
+            clean_lines = std::min(m_buffer->GetFirstDirtyLine(), line_count + 1) - 1;
+        }
+        size_t skipped_lines = clean_lines - std::min(clean_lines, LineDiffConstant::CONTEXT_LINES);
+        if (skipped_lines != 0) {
+            text.remove_prefix(m_buffer->GetByteOffset(skipped_lines + 1));
+        }
+        std::vector<std::string_view> old_lines;
+        while (!text.empty()) {
+            size_t end = text.find('\n');
+            size_t length = end == std::string_view::npos ? text.size() : end + 1;
+            old_lines.push_back(text.substr(0, length));
+            text.remove_prefix(length);
+        }
+
+        LineViewStorage storage;
+        std::vector<std::string_view> new_lines;
+        if (skipped_lines < line_count) {
+            size_t current_line_num = m_buffer->GetCurrentLineNum();
+            new_lines = m_buffer->GetLineViews(skipped_lines + 1, line_count, storage);
+            m_buffer->SetCurrentLineNum(current_line_num);
+        }
+
+        std::vector<DiffChange> changes = LineDiffer::Diff(old_lines, new_lines, clean_lines - skipped_lines);
+        if (!changes.empty()) {
+            *m_output << LineDiffer::FormatUnified(path, m_buffer->GetFileName(), old_lines, new_lines, changes,
+                                                   skipped_lines);
+        }
+    }
+
+    void Editor::UpdateFollowedFile_() {
+        if (m_follower == nullptr) {
+            return;
+        }
+        switch (m_follower->Check()) {
+            case FollowChange::APPENDED:
+                // the existing lines are left alone, so are marks, undo and the modified flag
+                m_follower->AppendTo(*m_buffer);
+                break;
+            case FollowChange::REPLACED: {
+                std::string file_name = m_follower->GetFileName();
+                InputFileStream if_stream(file_name);
+                if (!if_stream.good()) {
+                    break;
+                }
+                ReapBackgroundJobs_(true);
+                SavePrev_(*m_buffer);
+                LoadFromDisk_(if_stream, file_name);
+                m_buffer->SetCurrentLineNum(m_buffer->GetLineCount());
+                m_buffer->SetModifyStatus(false);
+                *m_output << EditorConstants::STR_FOLLOWED_FILE_RELOADED << file_name << '\n';
+                break;
+            }
+            case FollowChange::NONE:
+                break;
+        }
+    }
+
+    void Editor::FollowBuffer_() {
+        const FileDiskState &disk_state = m_buffer->GetDiskState();
+        if (disk_state.valid) {
+            FollowFrom_(disk_state, static_cast<uint64_t>(disk_state.size));
+        } else {
+            // the buffer is not what the file was at some point, reload at the next change
+            FollowFrom_(FileUtil::GetDiskState(m_buffer->GetFileName()), FileFollowerConstant::UNKNOWN_SIZE);
+        }
+    }
+
+    void Editor::FollowFrom_(const FileDiskState &disk_state, uint64_t loaded_size) {
+        if (m_follower == nullptr || m_follower->GetFileName() != m_buffer->GetFileName()) {
+            m_follower = std::make_unique<FileFollower>(m_buffer->GetFileName());
+        }
+        m_follower->Reset(disk_state, loaded_size);
+    }
+
+    void Editor::ReapBackgroundJobs_(bool wait) {
+        auto itr = m_background_jobs.begin();
+        while (itr != m_background_jobs.end()) {
+            if (!wait && itr->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++itr;
+                continue;
+            }
+            try {
+                std::string output = itr->result.get();
+                if (!output.empty()) {
+                    *m_output << itr->description << ": " << output;
+                }
+            } catch (const std::exception &ex) {
+                // the buffer is not on disk after all
+                *m_output << EditorConstants::STR_BACKGROUND_JOB_FAILED << itr->description << ": " << ex.what() << '\n';
+                if (m_buffer != nullptr) {
+                    m_buffer->SetModifyStatus(true);
+                }
+            }
+            itr = m_background_jobs.erase(itr);
+        }
+    }
+
+    void Editor::LoadFromDisk_(InputFileStream &if_stream, const std::string &file_name) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "Editor::LoadFromDisk_");
+        FileDiskState disk_state = FileUtil::GetDiskState(file_name);
+        std::unique_ptr<LineReader> line_reader = MapForReading_(if_stream, file_name);
+        if (line_reader != nullptr) {
+            m_buffer->LoadFrom(*line_reader);
+        } else {
+            if_stream >> *m_buffer;
+        }
+        m_buffer->SetFileName(file_name);
+        bool plain = if_stream.GetFormat() == CompressionFormat::NONE;
+        uint64_t loaded_size = m_buffer->GetByteOffset(m_buffer->GetLineCount() + 1);
+        if (m_follower != nullptr) {
+            // a last line without newline is continued by the bytes appended to the file
+            FollowFrom_(disk_state, plain ? loaded_size : FileFollowerConstant::UNKNOWN_SIZE);
+        }
+        // a changing file, a decompressed one, or a last line without newline does not match the buffer
+        if (!plain || disk_state != FileUtil::GetDiskState(file_name) ||
+            loaded_size != static_cast<uint64_t>(disk_state.size)) {
+            disk_state = FileDiskState();
+        }
+        m_buffer->MarkSaved(disk_state);
+    }
+
+    std::unique_ptr<LineReader> Editor::MapForReading_(const InputFileStream &if_stream, const std::string &file_name) {
+        if (if_stream.GetFormat() != CompressionFormat::NONE || ChunkCache::Instance().IsEnabled()) {
+            return nullptr;
         }
+        auto line_reader = std::make_unique<LineReader>(file_name);
+        return line_reader->IsMapped() ? std::move(line_reader) : nullptr;
     }
 }
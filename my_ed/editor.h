@@ -1,13 +1,30 @@
 #pragma once
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <sstream>
 #include <regex>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "chunk_cache.h"
 #include "common.hpp"
+#include "compression.h"
+#include "field_cut.h"
 #include "file.h"
+#include "file_follower.h"
+#include "file_writer.h"
+#include "line_dedupe.h"
+#include "line_diff.h"
+#include "line_sort.h"
+#include "mapped_text.h"
+#include "output_sink.h"
+#include "regex.h"
+#include "session_record.h"
 
 namespace MyEd {
 
@@ -20,39 +37,60 @@ namespace MyEd {
         // =
         constexpr static inline const char *COMMAND_SHOW_FILE_INFO = R"(^\=$)";
         // (.,.)p
-        constexpr static inline const char *COMMAND_PRINT = R"(^([\.\$]?|[+|-]?\d*)p?|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)p?$)";
+        constexpr static inline const char *COMMAND_PRINT = R"(^([\.\$]?|[+|-]?\d*|'[a-z])p?|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])p?$)";
         // (.,.)n
-        constexpr static inline const char *COMMAND_PRINT_WITH_LINE_NUM = R"(^([\.\$]?|[+|-]?\d*)n|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)n$)";
+        constexpr static inline const char *COMMAND_PRINT_WITH_LINE_NUM = R"(^([\.\$]?|[+|-]?\d*|'[a-z])n|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])n$)";
         // (.+1)z n
-        constexpr static inline const char *COMMAND_SCROLL = R"(^([\.\$]?|[+|-]?\d*)z\ ?(\d*)$)";
+        constexpr static inline const char *COMMAND_SCROLL = R"(^([\.\$]?|[+|-]?\d*|'[a-z])z\ ?(\d*)$)";
         // (.)a
-        constexpr static inline const char *COMMAND_APPEND = R"(^([\.\$]?|[+|-]?\d*)a$)";
+        constexpr static inline const char *COMMAND_APPEND = R"(^([\.\$]?|[+|-]?\d*|'[a-z])a$)";
         // (.)i
-        constexpr static inline const char *COMMAND_INSERT = R"(^([\.\$]?|[+|-]?\d*)i$)";
+        constexpr static inline const char *COMMAND_INSERT = R"(^([\.\$]?|[+|-]?\d*|'[a-z])i$)";
         // (.,.)d
-        constexpr static inline const char *COMMAND_DELETE = R"(^([\.\$]?|[+|-]?\d*)d|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)d$)";
+        constexpr static inline const char *COMMAND_DELETE = R"(^([\.\$]?|[+|-]?\d*|'[a-z])d|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])d$)";
         // (.,.)c
-        constexpr static inline const char *COMMAND_CHANGE = R"(^([\.\$]?|[+|-]?\d*)c|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)c$)";
+        constexpr static inline const char *COMMAND_CHANGE = R"(^([\.\$]?|[+|-]?\d*|'[a-z])c|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])c$)";
         // (.,.)m(.)
-        constexpr static inline const char *COMMAND_MOVE = R"(^([\.\$]?|[+|-]?\d*)m([\.\$]?|[+|-]?\d*)|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)m([\.\$]?|[+|-]?\d*)$)";
+        constexpr static inline const char *COMMAND_MOVE = R"(^([\.\$]?|[+|-]?\d*|'[a-z])m([\.\$]?|[+|-]?\d*|'[a-z])|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])m([\.\$]?|[+|-]?\d*|'[a-z])$)";
         // (.,.)t(.)
-        constexpr static inline const char *COMMAND_COPY = R"(^([\.\$]?|[+|-]?\d*)t([\.\$]?|[+|-]?\d*)|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)t([\.\$]?|[+|-]?\d*)$)";
+        constexpr static inline const char *COMMAND_COPY = R"(^([\.\$]?|[+|-]?\d*|'[a-z])t([\.\$]?|[+|-]?\d*|'[a-z])|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])t([\.\$]?|[+|-]?\d*|'[a-z])$)";
         // (.,.+1)j
-        constexpr static inline const char *COMMAND_JOIN = R"(^([\.\$]?|[+|-]?\d*)j|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)j$)";
-        // (.,$)w file
-        constexpr static inline const char *COMMAND_WRITE = R"(^([\.\$]?|[+|-]?\d*)w\ ([\s\S]*)|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)w\ ([\s\S]*)$)";
+        constexpr static inline const char *COMMAND_JOIN = R"(^([\.\$]?|[+|-]?\d*|'[a-z])j|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])j$)";
+        // (.,$)w [file], the current file when it is left out
+        constexpr static inline const char *COMMAND_WRITE = R"(^([\.\$]?|[+|-]?\d*|'[a-z])w(?:\ ([\s\S]*))?|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])w(?:\ ([\s\S]*))?$)";
         // e file
         constexpr static inline const char *COMMAND_EDIT = R"(^e\ ([\s\S]*)$)";
         // E file
         constexpr static inline const char *COMMAND_EDIT_UNCONDITIONALLY = R"(^E\ ([\s\S]*)$)";
         // ($)r file
-        constexpr static inline const char *COMMAND_READ_AND_APPEND = R"(^([\.\$]?|[+|-]?\d*)r\ ([\s\S]*)$)";
+        constexpr static inline const char *COMMAND_READ_AND_APPEND = R"(^([\.\$]?|[+|-]?\d*|'[a-z])r\ ([\s\S]*)$)";
         // (.,.)s/search/replacement/
         // (.,.)s/search/replacement/g
         // (.,.)s/search/replacement/n
-        constexpr static inline const char *COMMAND_SEARCH_AND_REPLACE = R"(^([\.\$]?|[+|-]?\d*)s/([\s\S]*)/([\s\S]*)/(g|[1-9]\d*|\s*)|([\.\$]?|[+|-]?\d*)(,)([\.\$]?|[+|-]?\d*)s/([\s\S]*)/([\s\S]*)/(g|[1-9]\d*|\s*)$)";
+        // with an r after them (e.g. s/search/replacement/gr) search is a regex, see SearchAndReplace_
+        constexpr static inline const char *COMMAND_SEARCH_AND_REPLACE = R"(^([\.\$]?|[+|-]?\d*|'[a-z])s/([\s\S]*)/([\s\S]*)/((?:g|[1-9]\d*)?r|g|[1-9]\d*|\s*)|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])s/([\s\S]*)/([\s\S]*)/((?:g|[1-9]\d*)?r|g|[1-9]\d*|\s*)$)";
+        // /re/ and ?re?, the closing delimiter may be left out, an empty re repeats the last one.
+        // /re/ & and ?re? & search in background
+        constexpr static inline const char *COMMAND_SEARCH_FORWARD = R"(^/((?:[^/\\]|\\[\s\S])*)(?:/(\s+&)?)?$)";
+        constexpr static inline const char *COMMAND_SEARCH_BACKWARD = R"(^\?((?:[^?\\]|\\[\s\S])*)(?:\?(\s+&)?)?$)";
+        // a /re/ pattern without these characters is searched for as plain text
+        constexpr static inline const char *REGEX_SPECIAL_CHARACTERS = R"(\^$.|?*+()[]{})";
+        // (.,.)sort [-n] [-r] [-b] [-k N] [-t D]
+        constexpr static inline const char *COMMAND_SORT = R"(^([\.\$]?|[+|-]?\d*|'[a-z])sort(\s[\s\S]*|)|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])sort(\s[\s\S]*|)$)";
+        // (1,$)bsearch [-n] [-r] [-b] [-k N] [-t D] /key/
+        constexpr static inline const char *COMMAND_BINARY_SEARCH = R"(^([\.\$]?|[+|-]?\d*|'[a-z])bsearch(\s[^/]*|)/([\s\S]*)/|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])bsearch(\s[^/]*|)/([\s\S]*)/$)";
+        // (.,.)cut -f LIST [-d D]
+        constexpr static inline const char *COMMAND_CUT = R"(^([\.\$]?|[+|-]?\d*|'[a-z])cut(\s[\s\S]*|)|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])cut(\s[\s\S]*|)$)";
+        // (.,.)uniq [-g]
+        constexpr static inline const char *COMMAND_UNIQ = R"(^([\.\$]?|[+|-]?\d*|'[a-z])uniq(\s[\s\S]*|)|([\.\$]?|[+|-]?\d*|'[a-z])(,)([\.\$]?|[+|-]?\d*|'[a-z])uniq(\s[\s\S]*|)$)";
         // u
         constexpr static inline const char *COMMAND_UNDOES = R"(^u$)";
+        // (.)kx
+        constexpr static inline const char *COMMAND_MARK = R"(^([\.\$]?|[+|-]?\d*|'[a-z])k([a-z])$)";
+        // F
+        constexpr static inline const char *COMMAND_FOLLOW = "^F$";
+        // diff file
+        constexpr static inline const char *COMMAND_DIFF = R"(^diff(?:\ ([\s\S]*))?$)";
 
         // answer yes
         constexpr static inline const char *ANSWER_YES = "^y$";
@@ -66,6 +104,8 @@ namespace MyEd {
         constexpr static inline const char *MARK_CURRENT_LINE = R"(^\.$)";
         // last line mark
         constexpr static inline const char *MARK_LAST_LINE = R"(^\$$)";
+        // line marked by kx
+        constexpr static inline const char *MARK_MARKED_LINE = R"(^'([a-z])$)";
         // positive number
         constexpr static inline const char *POSITIVE_NUMBER = R"(^\+(\d*)$)";
         // negative number
@@ -84,6 +124,10 @@ namespace MyEd {
         constexpr static inline const char *PERIOD = R"(\.)";
         // global
         constexpr static inline const char *GLOBAL = R"(^g$)";
+        // s/search/replacement/r
+        constexpr static const char REGEX_MODE = 'r';
+        // trailing " &" of a command which runs in background
+        constexpr static inline const char *BACKGROUND_MARK = R"(^([\s\S]*?)\s+&$)";
 
         // Message
         constexpr static inline const char *STR_WRONG_COMMAND = "Wrong command.";
@@ -91,6 +135,14 @@ namespace MyEd {
         constexpr static inline const char *STR_QUIT_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING = "This file is modified, are you sure to quit without saving it?(y/n):";
         constexpr static inline const char *STR_LOAD_NEW_WHEN_FILE_EDITED_BUT_NOT_SAVED_WARING = "This file is modified, are you sure to load a new file without saving it?(y/n):";
         constexpr static inline const char *STR_FILE_DOESNT_EXIST_WARING = "File doesn't exist.";
+        constexpr static inline const char *STR_NO_FILE_NAME = "No current file name.";
+        constexpr static inline const char *STR_NO_MATCH = "No match.";
+        constexpr static inline const char *STR_NO_PREVIOUS_PATTERN = "No previous pattern.";
+        constexpr static inline const char *STR_INVALID_GROUP_REFERENCE = "Invalid group reference.";
+        constexpr static inline const char *STR_BACKGROUND_JOB_FAILED = "Background job failed: ";
+        constexpr static inline const char *STR_FOLLOWING = "Following ";
+        constexpr static inline const char *STR_FOLLOWING_STOPPED = "Stopped following ";
+        constexpr static inline const char *STR_FOLLOWED_FILE_RELOADED = "File was truncated or replaced, reloaded ";
 
         constexpr static inline const char *STR_SHOW_FILE_INFO_BEGIN = "============== FILE INFO ==============";
         constexpr static inline const char *STR_FILE_NAME = "file name   :";
@@ -99,17 +151,36 @@ namespace MyEd {
         constexpr static inline const char *STR_MODIFIED_BUT_NOT_SAVED = "modified    :";
         constexpr static inline const char *STR_SHOW_FILE_INFO_END = "================= END =================";
 
+        // command used for an empty input line
+        constexpr static inline const char *DEFAULT_COMMAND = "+p";
+
         // default n of (.+1)z n
         constexpr static inline const size_t DEFAULT_SCROLL_LINES = 22;
     };
 
+    // job running on another thread against a FileSnapshot, e.g. "w file &"
+    struct BackgroundJob {
+        std::string description;
+        // what to print after the description once it is done, nothing when empty
+        std::future<std::string> result;
+    };
+
     class Editor {
 
     private:
         File *m_buffer;
         File *m_buffer_prev;
+        std::vector<BackgroundJob> m_background_jobs;
+        std::istream *m_input;
+        OutputSink *m_output;
+        std::string m_last_search_pattern;
+        // null unless F follows the file of the buffer
+        std::unique_ptr<FileFollower> m_follower;
+        // null unless the session is recorded
+        SessionRecorder *m_recorder;
     public:
         Editor();
+        Editor(std::istream &, OutputSink &);
         ~Editor();
 
         void Init();
@@ -117,18 +188,29 @@ namespace MyEd {
 
         void Destroys();
 
+        // commands, inserted text and answers are read from input, everything printed goes to output
+        void SetInputOutput(std::istream &, OutputSink &);
+
+        // every command from now on is passed to recorder with the input it read and the time it took, null stops
+        // recording; the recorder is to be attached to the input of the editor
+        void SetRecorder(SessionRecorder *recorder);
+
         bool InputCommand(std::string);
+        // execute commands read from input until it ends (returns true) or the editor quits (returns false)
+        bool Run();
 
     private:
 
+        bool ExecuteCommand_(const std::string &command);
+
         [[nodiscard]] size_t HandleParam_(const std::string &str_param) const;
-        static bool GetUserInputLine_(std::string &ret);
+        bool GetUserInputLine_(std::string &ret) const;
 
         [[nodiscard]] bool QuitEditor_() const;
         [[nodiscard]] bool QuitEditorUnconditionally_() const;
 
         void ShowFileInfo_() const;
-        void Print_(const std::smatch &, std::ostream &);
+        void Print_(const std::smatch &);
         void PrintWithLineNum_(const std::smatch &);
         void Scroll_(const std::smatch &);
         void Append_(const std::smatch &);
@@ -143,7 +225,47 @@ namespace MyEd {
         void EditUnconditionally_(const std::smatch &);
         void ReadAndAppend_(const std::smatch &);
 	void SearchAndReplace_(const std::smatch &);
+        // the replacement of the match of a regex in text: & is the match, \1 to \9 its groups (see
+        // Regex::GetGroups), \& and \\ the characters themselves
+        static std::string ExpandReplacement_(const std::string &replacement, std::string_view text,
+                                              const std::vector<size_t> &groups);
         void SavePrev_(const File &);
         void Undoes_();
+        void Mark_(const std::smatch &);
+        void Sort_(const std::smatch &);
+        // (.,.)cut: keep the listed fields of the lines, in the order of the list
+        void Cut_(const std::smatch &);
+        // (.,.)uniq: erase the lines equal to the one before them, or with -g to any earlier line of the range
+        void Uniq_(const std::smatch &);
+        // (1,$)bsearch: make the first line of a range sorted like sort does whose key is not before key
+        // current and print it, reading O(log n) lines of the range
+        void BinarySearch_(const std::smatch &);
+        // /re/ or ?re?: make the next (previous) line matching re current, wrapping around, and print it.
+        // With & the search runs on a snapshot while editing goes on; the number and the text of the line are
+        // printed when it is done and the current line stays where it is, as the buffer may have changed since.
+        void Search_(const std::smatch &, bool backward);
+        // F: start or stop following the file of the buffer like tail -f does
+        void ToggleFollow_();
+        // diff file: print how the buffer differs from a file, by default the one it was loaded from, like diff -u
+        void Diff_(const std::smatch &);
+
+        // bring in what was appended to the followed file, or reload it if it was truncated or replaced
+        void UpdateFollowedFile_();
+        // follow the file of the buffer from what the buffer holds of it
+        void FollowBuffer_();
+        // follow the file of the buffer, of which it holds loaded_size bytes (see FileFollower::Reset)
+        void FollowFrom_(const FileDiskState &disk_state, uint64_t loaded_size);
+
+        // store index of the line of chars where the next (previous) match of pattern starts, the line count when
+        // there is none; regex is null for a plain text pattern
+        static size_t FindMatchingLine_(const CharRange &chars, size_t line_count, const std::string &pattern,
+                                        Regex *regex, size_t current_line_num, bool backward);
+        void ReapBackgroundJobs_(bool wait);
+        // read the whole buffer from an opened file, remembering whether it mirrors the file byte for byte
+        void LoadFromDisk_(InputFileStream &if_stream, const std::string &file_name);
+        // a reader splitting the file on all cores when it is large and plain, null when it is to be streamed,
+        // which is also the case under a memory budget: the streamed lines can be spilled as they come
+        static std::unique_ptr<LineReader> MapForReading_(const InputFileStream &if_stream,
+                                                          const std::string &file_name);
     };
 }
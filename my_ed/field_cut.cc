@@ -0,0 +1,196 @@
+#include "field_cut.h"
+
+#include <algorithm>
+#include <charconv>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace MyEd {
+    namespace {
+        bool IsBlank(char ch) {
+            return ch == ' ' || ch == '\t';
+        }
+
+        // N, N-M, N- or -M
+        FieldRange ParseRange(std::string_view text) {
+            auto parse_number = [](std::string_view number_text) {
+                size_t number = 0;
+                auto result = std::from_chars(number_text.data(), number_text.data() + number_text.size(), number);
+                if (result.ec != std::errc() || result.ptr != number_text.data() + number_text.size() || number == 0) {
+                    throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+                }
+                return number;
+            };
+            size_t dash = text.find('-');
+            if (dash == std::string_view::npos) {
+                size_t field = parse_number(text);
+                return {field, field};
+            }
+            FieldRange range{1, FieldCutConstant::LAST_FIELD};
+            if (dash != 0) {
+                range.first = parse_number(text.substr(0, dash));
+            }
+            if (dash + 1 != text.size()) {
+                range.last = parse_number(text.substr(dash + 1));
+            }
+            if (dash == 0 && dash + 1 == text.size()) {
+                throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+            if (range.last < range.first) {
+                throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+            return range;
+        }
+
+        Line CutLine(const Line &line, const CutOptions &options, size_t limit, std::vector<size_t> &offsets) {
+            std::string flattened;
+            std::string_view text = line->GetView(flattened);
+            bool terminated = !text.empty() && text.back() == '\n';
+            if (terminated) {
+                text.remove_suffix(1);
+            }
+            FieldCutter::FindDelimiters(text, options.delimiter, limit, offsets);
+            if (offsets.empty()) {
+                return line;
+            }
+            // field i (0-based) is [begin(i), end(i)), fields past the last one are left out
+            size_t field_count = offsets.size() < limit ? offsets.size() + 1 : FieldCutConstant::LAST_FIELD;
+            auto begin = [&offsets](size_t field) {
+                return field == 0 ? 0 : offsets[field - 1] + 1;
+            };
+            auto end = [&offsets, &text](size_t field) {
+                return field < offsets.size() ? offsets[field] : text.size();
+            };
+            std::string cut;
+            cut.reserve(text.size() + 1);
+            bool first = true;
+            for (const FieldRange &range: options.fields) {
+                size_t first_field = range.first - 1;
+                if (first_field >= field_count) {
+                    continue;
+                }
+                size_t last_field = std::min(range.last, field_count) - 1;
+                if (!first) {
+                    cut.push_back(options.delimiter);
+                }
+                first = false;
+                // a run of fields is the text between them, delimiters included
+                size_t from = begin(first_field);
+                cut.append(text.substr(from, end(last_field) - from));
+            }
+            if (terminated) {
+                cut.push_back('\n');
+            }
+            return LineStore::MakeLine(std::move(cut));
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    CutOptions FieldCutter::ParseOptions(const std::string &options) {
+        CutOptions cut_options;
+        size_t pos = 0;
+        auto skip_blanks = [&options, &pos]() {
+            while (pos < options.size() && IsBlank(options[pos])) {
+                ++pos;
+            }
+        };
+        for (skip_blanks(); pos < options.size(); skip_blanks()) {
+            if (options[pos] != '-' || pos + 1 >= options.size()) {
+                throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+            char option = options[pos + 1];
+            pos += 2;
+            if (option == FieldCutConstant::OPTION_DELIMITER) {
+                // -dD, -d D, -d'D' or -d 'D'
+                if (pos + 1 < options.size() && IsBlank(options[pos])) {
+                    ++pos;
+                }
+                if (pos >= options.size()) {
+                    throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+                }
+                if (pos + 2 < options.size() && (options[pos] == '\'' || options[pos] == '"') &&
+                    options[pos + 2] == options[pos]) {
+                    cut_options.delimiter = options[pos + 1];
+                    pos += 3;
+                } else {
+                    cut_options.delimiter = options[pos++];
+                }
+            } else if (option == FieldCutConstant::OPTION_FIELDS) {
+                // -f LIST or -fLIST
+                skip_blanks();
+                size_t list_end = pos;
+                while (list_end < options.size() && !IsBlank(options[list_end])) {
+                    ++list_end;
+                }
+                std::string_view list(options.data() + pos, list_end - pos);
+                pos = list_end;
+                cut_options.fields.clear();
+                for (size_t from = 0; from <= list.size();) {
+                    size_t comma = std::min(list.find(',', from), list.size());
+                    cut_options.fields.push_back(ParseRange(list.substr(from, comma - from)));
+                    from = comma + 1;
+                }
+            } else {
+                throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+        }
+        if (cut_options.fields.empty()) {
+            throw std::runtime_error(FieldCutConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+        }
+        return cut_options;
+    }
+
+    void FieldCutter::FindDelimiters(std::string_view text, char delimiter, size_t limit,
+                                     std::vector<size_t> &offsets) {
+        offsets.clear();
+        size_t pos = 0;
+#if defined(__SSE2__)
+        const __m128i pattern = _mm_set1_epi8(delimiter);
+        for (; pos + 16 <= text.size() && offsets.size() < limit; pos += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + pos));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+            for (; mask != 0 && offsets.size() < limit; mask &= mask - 1) {
+                offsets.push_back(pos + static_cast<size_t>(__builtin_ctz(mask)));
+            }
+        }
+#endif
+        for (; pos < text.size() && offsets.size() < limit; ++pos) {
+            if (text[pos] == delimiter) {
+                offsets.push_back(pos);
+            }
+        }
+    }
+
+    std::vector<Line> FieldCutter::Cut(const std::vector<Line> &lines, const CutOptions &options) {
+        // delimiters after the last field asked for do not matter, unless a range is open
+        size_t limit = 0;
+        for (const FieldRange &range: options.fields) {
+            limit = std::max(limit, range.last);
+        }
+
+        size_t thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        size_t part_count = std::min(thread_count,
+                                     std::max<size_t>(1, lines.size() / FieldCutConstant::MIN_LINES_PER_THREAD));
+        std::vector<Line> cut_lines(lines.size());
+        std::vector<std::future<void>> jobs;
+        for (size_t i = 0; i < part_count; ++i) {
+            size_t from = lines.size() * i / part_count;
+            size_t to = lines.size() * (i + 1) / part_count;
+            jobs.push_back(std::async(std::launch::async, [&lines, &options, &cut_lines, limit, from, to]() {
+                std::vector<size_t> offsets;
+                for (size_t j = from; j < to; ++j) {
+                    cut_lines[j] = CutLine(lines[j], options, limit, offsets);
+                }
+            }));
+        }
+        for (auto &job: jobs) {
+            job.get();
+        }
+        return cut_lines;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "line_store.h"
+
+namespace MyEd {
+
+    class FieldCutConstant {
+    public:
+        // below this many lines per thread cutting is not worth a thread
+        constexpr static const size_t MIN_LINES_PER_THREAD = 1 << 16;
+        constexpr static const char DEFAULT_DELIMITER = '\t';
+        // the last field of an open range like 3-
+        constexpr static const size_t LAST_FIELD = static_cast<size_t>(-1);
+
+        constexpr static const char OPTION_DELIMITER = 'd';
+        constexpr static const char OPTION_FIELDS = 'f';
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_BAD_OPTION = "Bad cut option, expected -f LIST [-d D].";
+    };
+
+    struct FieldRange {
+        // 1-based, both included
+        size_t first;
+        size_t last;
+    };
+
+    struct CutOptions {
+        char delimiter = FieldCutConstant::DEFAULT_DELIMITER;
+        // in the order they are output, which need not be the order of the line
+        std::vector<FieldRange> fields;
+    };
+
+    // Column projection of delimited lines, like cut(1) -f but with the fields in the order they are listed.
+    // The delimiters of a line are found 16 bytes at a time with SSE2 where it is available, and only up to the
+    // last field asked for; parts of the lines are cut on their own threads.
+    class FieldCutter {
+    public:
+        // parse "-f LIST [-d D]". LIST is made of N, N-M, N- and -M separated by commas. D is -d, or -d , like
+        // cut(1) takes it, or quoted to be a blank: -d' ' or -d " "; the delimiter is a tab without -d
+        static CutOptions ParseOptions(const std::string &options);
+
+        // offsets of the first limit delimiters of text
+        static void FindDelimiters(std::string_view text, char delimiter, size_t limit, std::vector<size_t> &offsets);
+
+        // the lines made of the fields of lines, joined by the delimiter. A line without the delimiter stays
+        // as it is, the very same payload
+        static std::vector<Line> Cut(const std::vector<Line> &lines, const CutOptions &options);
+    };
+}
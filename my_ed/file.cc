@@ -1,23 +1,76 @@
 #include "file.h"
 
 namespace MyEd {
-    File::File() : m_buffer(FileConstant::DEFAULT_LINE_COUNT + 1, FileConstant::FILE_DELIMITER),
-                   m_current_line_num(FileConstant::DEFAULT_CURRENT_LINE_NUM),
+    FileSnapshot::FileSnapshot(LineStorage lines, std::string file_name)
+            : m_lines(std::move(lines)),
+              m_file_name(std::move(file_name)) {}
+
+    size_t FileSnapshot::GetLineCount() const {
+        return m_lines.Size();
+    }
+
+    uint64_t FileSnapshot::GetVersion() const {
+        return m_lines.GetVersion();
+    }
+
+    const std::string &FileSnapshot::GetFileName() const {
+        return m_file_name;
+    }
+
+    std::string FileSnapshot::GetLine(size_t line_num) const {
+        ValidateReadParam(line_num);
+        return m_lines.At(line_num - 1);
+    }
+
+    uint64_t FileSnapshot::GetByteOffset(size_t line_num) const {
+        if (line_num <= FileConstant::DEFAULT_CURRENT_LINE_NUM || line_num > GetLineCount() + 1) {
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_LINE_NUM_OUT_OF_RANGE);
+        }
+        return m_lines.ByteOffset(line_num - 1);
+    }
+
+    const FileSnapshot &FileSnapshot::SaveTo(std::ostream &output_stream, size_t line_from, size_t line_to) const {
+        ValidateReadParams(line_from, line_to);
+        m_lines.ForEach(line_from - 1, line_to, [&output_stream](const LineText &line) {
+            output_stream << line;
+        });
+        return *this;
+    }
+
+    CharRange FileSnapshot::GetCharRange(size_t line_from, size_t line_to) const {
+        ValidateReadParams(line_from, line_to);
+        return CharRange(m_lines, line_from - 1, line_to - line_from + 1);
+    }
+
+    void FileSnapshot::ValidateReadParam(size_t line_num) const {
+        if (line_num <= FileConstant::DEFAULT_CURRENT_LINE_NUM || line_num > GetLineCount()) {
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_LINE_NUM_OUT_OF_RANGE);
+        }
+    }
+
+    void FileSnapshot::ValidateReadParams(size_t line_from, size_t line_to) const {
+        ValidateReadParam(line_from);
+        ValidateReadParam(line_to);
+        if (line_from > line_to) {
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_BAD_LINE_NUM_ORDER);
+        }
+    }
+
+    File::File() : m_current_line_num(FileConstant::DEFAULT_CURRENT_LINE_NUM),
                    m_file_name(FileConstant::DEFAULT_FILE_NAME),
-                   m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS) {}
+                   m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS),
+                   m_first_dirty_line(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1) {}
 
-    File::File(const std::string &lines) : m_buffer(FileConstant::DEFAULT_LINE_COUNT + 1,
-                                                    FileConstant::FILE_DELIMITER),
-                                           m_file_name(FileConstant::DEFAULT_FILE_NAME),
-                                           m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS) {
+    File::File(const std::string &lines) : m_file_name(FileConstant::DEFAULT_FILE_NAME),
+                                           m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS),
+                                           m_first_dirty_line(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1) {
         InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, lines);
         m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
     }
 
-    File::File(std::istream &input_stream) : m_buffer(FileConstant::DEFAULT_LINE_COUNT + 1,
-                                                      FileConstant::FILE_DELIMITER),
-                                             m_file_name(FileConstant::DEFAULT_FILE_NAME),
-                                             m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS) {
+    File::File(std::istream &input_stream) : m_file_name(FileConstant::DEFAULT_FILE_NAME),
+                                             m_modified_but_not_saved(FileConstant::DEFAULT_MODIFY_STATUS),
+                                             m_first_dirty_line(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1) {
         InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, input_stream);
         m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
     }
@@ -27,6 +80,9 @@ namespace MyEd {
         this->m_file_name = another_file.m_file_name;
         this->m_modified_but_not_saved = another_file.m_modified_but_not_saved;
         this->m_current_line_num = another_file.m_current_line_num;
+        this->m_first_dirty_line = another_file.m_first_dirty_line;
+        this->m_disk_state = another_file.m_disk_state;
+        this->m_marks = another_file.m_marks;
     }
 
     File::File(File &&another_file) noexcept {
@@ -34,12 +90,15 @@ namespace MyEd {
         this->m_file_name = std::move(another_file.m_file_name);
         this->m_current_line_num = another_file.m_current_line_num;
         this->m_modified_but_not_saved = another_file.m_modified_but_not_saved;
+        this->m_first_dirty_line = another_file.m_first_dirty_line;
+        this->m_disk_state = another_file.m_disk_state;
+        this->m_marks = another_file.m_marks;
     }
 
     ////////////////////////////////// Public //////////////////////////////////
     //meta info
     size_t File::GetLineCount() const {
-        return m_buffer.size() - 1;
+        return m_buffer.Size();
     }
 
     size_t File::GetCurrentLineNum() const {
@@ -70,8 +129,52 @@ namespace MyEd {
         return GetLineCount() == FileConstant::DEFAULT_LINE_COUNT;
     }
 
+    size_t File::GetFirstDirtyLine() const {
+        return m_first_dirty_line;
+    }
+
+    const FileDiskState &File::GetDiskState() const {
+        return m_disk_state;
+    }
+
+    void File::MarkSaved(const FileDiskState &disk_state) {
+        m_first_dirty_line = FileConstant::NO_DIRTY_LINE;
+        m_disk_state = disk_state;
+    }
+
+    uint64_t File::GetByteOffset(size_t line_num) const {
+        if (line_num <= FileConstant::DEFAULT_CURRENT_LINE_NUM || line_num > GetLineCount() + 1) {
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_LINE_NUM_OUT_OF_RANGE);
+        }
+        return m_buffer.ByteOffset(line_num - 1);
+    }
+
+    void File::SetMark(char name, size_t line_num) {
+        ValidateReadUpdateDeleteParam(line_num);
+        m_marks[MarkIndex_(name)] = {m_buffer.IdAt(line_num - 1), line_num - 1};
+    }
+
+    size_t File::GetMarkedLine(char name) {
+        LineHandle &handle = m_marks[MarkIndex_(name)];
+        if (!m_buffer.Locate(handle)) {
+            handle = LineHandle();
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_MARK_NOT_SET);
+        }
+        return handle.index + 1;
+    }
+
+    uint64_t File::GetVersion() const {
+        return m_buffer.GetVersion();
+    }
+
+    FileSnapshot File::Snapshot() const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::Snapshot");
+        return FileSnapshot(m_buffer, m_file_name);
+    }
+
     //C
     File &File::LoadFrom(const std::string &input_string) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::LoadFrom");
         Clear();
         InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, input_string);
         m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
@@ -79,18 +182,26 @@ namespace MyEd {
     }
 
     File &File::LoadFrom(std::istream &input_stream) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::LoadFrom");
         Clear();
         InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, input_stream);
         m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
         return *this;
     }
 
-    File &File::LoadFrom(const File &another_file) {
+    File &File::LoadFrom(const LineReader &line_reader) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::LoadFrom");
         Clear();
-        InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, another_file);
-        m_current_line_num = another_file.GetCurrentLineNum();
-        m_modified_but_not_saved = another_file.GetModifyStatus();
-        m_file_name = another_file.GetFileName();
+        InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, line_reader);
+        m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
+        return *this;
+    }
+
+    File &File::LoadFrom(const File &another_file) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::LoadFrom");
+        // the same lines, so marks of the other file are valid here
+        m_buffer = another_file.m_buffer;
+        CopyMetaFrom_(another_file);
         return *this;
     }
 
@@ -108,43 +219,99 @@ namespace MyEd {
     }
 
     size_t File::InsertOneOrMultiplyLines(size_t line_num, const std::string &input_lines) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::InsertOneOrMultiplyLines");
         ValidateInsertParam(line_num);
-        m_current_line_num = line_num - 1;
         std::vector<std::string> lines = StringUtil::Split(input_lines, FileConstant::FILE_DELIMITER);
-        for (auto ritr = lines.rbegin(); ritr != lines.rend(); ++ritr) {
-            InsertLine_(line_num, std::move(*ritr) + FileConstant::FILE_DELIMITER);
-            ++m_current_line_num;
+        std::vector<Line> new_lines;
+        new_lines.reserve(lines.size());
+        for (auto &line: lines) {
+            new_lines.push_back(LineStore::MakeLine(std::move(line) + FileConstant::FILE_DELIMITER));
         }
+        InsertLines_(line_num, std::move(new_lines));
+        m_current_line_num = line_num - 1 + lines.size();
         return lines.size();
     }
 
     size_t File::InsertOneOrMultiplyLines(size_t line_num, std::istream &input_stream) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::InsertOneOrMultiplyLines");
         ValidateInsertParam(line_num);
-        std::string tmp(std::istreambuf_iterator<char>(input_stream), {});
-        return InsertOneOrMultiplyLines(line_num, tmp);
+        // split the stream into lines while reading it, never holding the whole content in one string.
+        // Lines go into the buffer in batches, so that under a memory budget the ones read first can already
+        // be spilled while the rest is read.
+        std::vector<Line> new_lines;
+        std::string line;
+        size_t line_count = 0;
+        while (std::getline(input_stream, line)) {
+            line.append(FileConstant::FILE_DELIMITER);
+            new_lines.push_back(LineStore::MakeLine(std::move(line)));
+            line.clear();
+            if (new_lines.size() == FileConstant::LOAD_BATCH_LINE_COUNT) {
+                InsertLines_(line_num + line_count, std::move(new_lines));
+                line_count += FileConstant::LOAD_BATCH_LINE_COUNT;
+                new_lines.clear();
+            }
+        }
+        if (!new_lines.empty() || line_count == 0) {
+            line_count += new_lines.size();
+            InsertLines_(line_num + line_count - new_lines.size(), std::move(new_lines));
+        }
+        m_current_line_num = line_num - 1 + line_count;
+        return line_count;
     }
 
     size_t File::InsertOneOrMultiplyLines(size_t line_num, const File &another_file) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::InsertOneOrMultiplyLines");
         ValidateInsertParam(line_num);
-        m_current_line_num = line_num - 1;
-        for (size_t i = another_file.GetLineCount(); i > FileConstant::DEFAULT_CURRENT_LINE_NUM; --i) {
-            InsertLine_(line_num, another_file.GetLine_(i));
-            ++m_current_line_num;
-        }
-        return another_file.GetLineCount();
+        // line payloads are immutable, so they are shared with the other file instead of copied
+        size_t line_count = another_file.GetLineCount();
+        std::vector<Line> new_lines = another_file.m_buffer.LinesIn(0, line_count);
+        TerminateLines_(new_lines);
+        InsertLines_(line_num, std::move(new_lines));
+        m_current_line_num = line_num - 1 + line_count;
+        return line_count;
+    }
+
+    size_t File::InsertOneOrMultiplyLines(size_t line_num, const LineReader &line_reader) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::InsertOneOrMultiplyLines");
+        ValidateInsertParam(line_num);
+        size_t line_count = 0;
+        line_reader.ReadLines([this, line_num, &line_count](std::vector<Line> &&new_lines) {
+            size_t batch_line_count = new_lines.size();
+            if (batch_line_count != 0) {
+                InsertLines_(line_num + line_count, std::move(new_lines));
+                line_count += batch_line_count;
+            }
+        });
+        m_current_line_num = line_num - 1 + line_count;
+        return line_count;
+    }
+
+    size_t File::CopyLines(size_t line_from, size_t line_to, size_t line_num) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::CopyLines");
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        ValidateInsertParam(line_num);
+        size_t line_count = line_to - line_from + 1;
+        std::vector<Line> new_lines = m_buffer.LinesIn(line_from - 1, line_count);
+        TerminateLines_(new_lines);
+        InsertLines_(line_num, std::move(new_lines));
+        m_current_line_num = line_num - 1 + line_count;
+        return line_count;
     }
 
     File &File::Append(const std::string &input_string) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::Append");
         InsertOneOrMultiplyLines(GetLineCount() + 1, input_string);
         return *this;
     }
 
     File &File::Append(std::istream &input_stream) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::Append");
         InsertOneOrMultiplyLines(GetLineCount() + 1, input_stream);
         return *this;
     }
 
     File &File::Append(const File &another_file) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::Append");
         InsertOneOrMultiplyLines(GetLineCount() + 1, another_file);
         return *this;
     }
@@ -175,22 +342,35 @@ namespace MyEd {
 
     //R
     const File &File::SaveTo(std::string &output_string) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::SaveTo");
         output_string.clear();
-        output_string.append(GetAll_());
+        output_string.reserve(m_buffer.ByteOffset(GetLineCount()));
+        m_buffer.ForEach(0, GetLineCount(), [&output_string](const LineText &line) {
+            line.AppendTo(output_string);
+        });
         return *this;
     }
 
     const File &File::SaveTo(std::ostream &output_stream) const {
-        output_stream << GetAll_();
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::SaveTo");
+        m_buffer.ForEach(0, GetLineCount(), [&output_stream](const LineText &line) {
+            output_stream << line;
+        });
+        return *this;
+    }
+
+    const File &File::SaveTo(std::ostream &output_stream, size_t line_from, size_t line_to) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::SaveTo");
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        m_buffer.ForEach(line_from - 1, line_to, [&output_stream](const LineText &line) {
+            output_stream << line;
+        });
         return *this;
     }
 
     const File &File::SaveTo(File &another_file) const {
-        another_file.Clear();
-        another_file.InsertOneOrMultiplyLines(FileConstant::DEFAULT_CURRENT_LINE_NUM + 1, GetAll_());
-        another_file.SetCurrentLineNum(m_current_line_num);
-        another_file.SetFileName(m_file_name);
-        another_file.SetModifyStatus(m_modified_but_not_saved);
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::SaveTo");
+        another_file.LoadFrom(*this);
         return *this;
     }
 
@@ -217,12 +397,48 @@ namespace MyEd {
     }
 
     std::vector<std::string> File::GetLinesFromTo(size_t line_from, size_t line_to) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::GetLinesFromTo");
         ValidateReadUpdateDeleteParams(line_from, line_to);
         m_current_line_num = line_to;
         return GetLinesFromTo_(line_from, line_to);
     }
 
+    Line File::GetSharedLine(size_t line_num) {
+        ValidateReadUpdateDeleteParam(line_num);
+        m_current_line_num = line_num;
+        return m_buffer.LineAt(line_num - 1);
+    }
+
+    std::vector<Line> File::GetSharedLinesFromTo(size_t line_from, size_t line_to) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::GetSharedLinesFromTo");
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        m_current_line_num = line_to;
+        return m_buffer.LinesIn(line_from - 1, line_to - line_from + 1);
+    }
+
+    std::vector<std::string_view> File::GetLineViews(size_t line_from, size_t line_to, LineViewStorage &storage) {
+        storage.lines = GetSharedLinesFromTo(line_from, line_to);
+        storage.flattened.clear();
+        std::vector<std::string_view> views;
+        views.reserve(storage.lines.size());
+        for (const Line &line: storage.lines) {
+            if (line->IsRope()) {
+                views.push_back(line->GetView(storage.flattened.emplace_back()));
+            } else {
+                views.push_back(line->GetFlat());
+            }
+        }
+        return views;
+    }
+
+    CharRange File::GetCharRange(size_t line_from, size_t line_to) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::GetCharRange");
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        return CharRange(m_buffer, line_from - 1, line_to - line_from + 1);
+    }
+
     std::string File::GetAll() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::GetAll");
         m_current_line_num = GetLineCount();
         return GetAll_();
     }
@@ -231,10 +447,128 @@ namespace MyEd {
         return GetAll();
     }
 
+    //U
+    void File::MoveLines(size_t line_from, size_t line_to, size_t line_num) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::MoveLines");
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        ValidateInsertParam(line_num);
+        size_t count = line_to - line_from + 1;
+        // a destination inside the range leaves the lines where they are
+        if (line_num > line_from && line_num <= line_to + 1) {
+            line_num = line_from;
+        } else if (line_num > line_to + 1) {
+            line_num -= count;
+        }
+        // lines moved past the end are preceded by empty lines, as an insertion there would be
+        AutoResize_(line_num + count);
+        MarkDirty_(std::min(line_from, line_num));
+        m_buffer.Move(line_from - 1, count, line_num - 1);
+
+        size_t index_from = line_from - 1;
+        size_t index_to = line_num - 1;
+        for (LineHandle &handle: m_marks) {
+            if (handle.id == NO_LINE_ID) {
+                continue;
+            }
+            if (handle.index >= index_from && handle.index < index_from + count) {
+                handle.index = handle.index - index_from + index_to;
+                continue;
+            }
+            if (handle.index >= index_from + count) {
+                handle.index -= count;
+            }
+            if (handle.index >= index_to) {
+                handle.index += count;
+            }
+        }
+        m_current_line_num = line_num - 1 + count;
+    }
+
+    void File::ReorderLines(size_t line_from, const std::vector<size_t> &order) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::ReorderLines");
+        if (order.empty()) {
+            return;
+        }
+        size_t line_to = line_from + order.size() - 1;
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        MarkDirty_(line_from);
+        m_buffer.Reorder(line_from - 1, order);
+
+        size_t index_from = line_from - 1;
+        std::vector<size_t> new_offsets;
+        for (LineHandle &handle: m_marks) {
+            if (handle.id == NO_LINE_ID || handle.index < index_from || handle.index >= index_from + order.size()) {
+                continue;
+            }
+            if (new_offsets.empty()) {
+                new_offsets.resize(order.size());
+                for (size_t i = 0; i < order.size(); ++i) {
+                    new_offsets[order[i]] = i;
+                }
+            }
+            handle.index = index_from + new_offsets[handle.index - index_from];
+        }
+        m_current_line_num = line_to;
+    }
+
+    void File::RetainLines(size_t line_from, const std::vector<bool> &keep) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::RetainLines");
+        if (keep.empty()) {
+            return;
+        }
+        size_t line_to = line_from + keep.size() - 1;
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        // the kept lines go to the front of the range, the others after them are erased at once
+        std::vector<size_t> order;
+        order.reserve(keep.size());
+        for (size_t i = 0; i < keep.size(); ++i) {
+            if (keep[i]) {
+                order.push_back(i);
+            }
+        }
+        size_t kept_count = order.size();
+        if (kept_count == keep.size()) {
+            return;
+        }
+        for (size_t i = 0; i < keep.size(); ++i) {
+            if (!keep[i]) {
+                order.push_back(i);
+            }
+        }
+        ReorderLines(line_from, order);
+        EraseLines_(line_from + kept_count, line_to);
+        m_current_line_num = kept_count == 0 ? std::min(line_from, GetLineCount()) : line_from + kept_count - 1;
+    }
+
+    void File::ReplaceLine(size_t line_num, Line line) {
+        ValidateReadUpdateDeleteParam(line_num);
+        MarkDirty_(line_num);
+        std::vector<Line> new_lines;
+        new_lines.push_back(std::move(line));
+        // one modification of the store, with the same outcome as erasing the line and inserting the new one
+        m_buffer.Splice(line_num - 1, 1, std::move(new_lines));
+        ShiftMarks_(line_num - 1, 1, 1);
+        m_current_line_num = line_num;
+    }
+
+    void File::ReplaceLines(size_t line_from, std::vector<Line> &&lines) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::ReplaceLines");
+        if (lines.empty()) {
+            return;
+        }
+        size_t count = lines.size();
+        ValidateReadUpdateDeleteParams(line_from, line_from + count - 1);
+        MarkDirty_(line_from);
+        m_buffer.Splice(line_from - 1, count, std::move(lines));
+        ShiftMarks_(line_from - 1, count, count);
+        m_current_line_num = line_from + count - 1;
+    }
+
     //D
     void File::EraseLine(size_t line_num) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::EraseLine");
         ValidateReadUpdateDeleteParam(line_num);
-        EraseLine_(line_num);
+        EraseLines_(line_num, line_num);
         if (GetLineCount() < line_num) {
             m_current_line_num = GetLineCount();
         } else {
@@ -243,24 +577,30 @@ namespace MyEd {
     }
 
     void File::EraseLinesFromTo(size_t line_from, size_t line_to) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::EraseLinesFromTo");
         ValidateReadUpdateDeleteParams(line_from, line_to);
-        while (line_to >= line_from) {
-            EraseLine(line_to);
-            --line_to;
+        EraseLines_(line_from, line_to);
+        if (GetLineCount() < line_from) {
+            m_current_line_num = GetLineCount();
+        } else {
+            m_current_line_num = line_from;
         }
     }
 
     void File::Clear() {
-        m_buffer.clear();
-        AutoResize_(FileConstant::DEFAULT_LINE_COUNT + 1);
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::Clear");
+        m_buffer.Clear();
         m_current_line_num = FileConstant::DEFAULT_CURRENT_LINE_NUM;
         m_file_name = FileConstant::DEFAULT_FILE_NAME;
         m_modified_but_not_saved = FileConstant::DEFAULT_MODIFY_STATUS;
+        m_first_dirty_line = FileConstant::DEFAULT_CURRENT_LINE_NUM + 1;
+        m_disk_state = FileDiskState();
+        m_marks.fill(LineHandle());
     }
 
     // parameters validating
     void File::ValidateInsertParam(size_t line_num) const {
-        if (line_num <= FileConstant::DEFAULT_CURRENT_LINE_NUM || line_num >= m_buffer.max_size()) {
+        if (line_num <= FileConstant::DEFAULT_CURRENT_LINE_NUM || line_num >= LineStoreConstant::MAX_LINE_COUNT) {
             throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_LINE_NUM_OUT_OF_RANGE);
         }
     }
@@ -290,51 +630,97 @@ namespace MyEd {
 
     void File::AutoResize_(size_t expected_new_line_num) {
         ValidateInsertParam(expected_new_line_num);
-        if (expected_new_line_num <= m_buffer.size()) {
+        // inserting after the last line pads the gap with empty lines
+        if (expected_new_line_num <= GetLineCount() + 1) {
             return;
         }
-        m_buffer.resize(expected_new_line_num, FileConstant::FILE_DELIMITER);
-    }
-
-    void File::InsertLine_(size_t line_num, const std::string &new_line) {
-        ValidateInsertParam(line_num);
-        AutoResize_(line_num);
-        m_buffer.insert(m_buffer.begin() + line_num, new_line);
+        MarkDirty_(GetLineCount() + 1);
+        std::vector<Line> padding(expected_new_line_num - GetLineCount() - 1,
+                                  LineStore::MakeLine(FileConstant::FILE_DELIMITER));
+        m_buffer.Insert(GetLineCount(), std::move(padding));
     }
 
-    void File::InsertLine_(size_t line_num, std::string &&new_line) {
+    void File::InsertLines_(size_t line_num, std::vector<Line> &&new_lines) {
         ValidateInsertParam(line_num);
         AutoResize_(line_num);
-        m_buffer.insert(m_buffer.begin() + line_num, new_line);
+        MarkDirty_(line_num);
+        size_t line_count = new_lines.size();
+        m_buffer.Insert(line_num - 1, std::move(new_lines));
+        ShiftMarks_(line_num - 1, 0, line_count);
+    }
+
+    void File::TerminateLines_(std::vector<Line> &lines) {
+        for (Line &line: lines) {
+            if (!line->EndsWith(FileConstant::FILE_DELIMITER)) {
+                LineTextBuilder builder;
+                builder.Append(*line, 0, line->Size()).Append(FileConstant::FILE_DELIMITER);
+                line = builder.Build();
+            }
+        }
     }
 
-    const std::string &File::GetLine_(size_t line_num) const {
+    std::string File::GetLine_(size_t line_num) const {
         ValidateReadUpdateDeleteParam(line_num);
-        return m_buffer[line_num];
+        return m_buffer.At(line_num - 1);
     }
 
     std::vector<std::string> File::GetLinesFromTo_(size_t line_from, size_t line_to) const {
         ValidateReadUpdateDeleteParams(line_from, line_to);
         std::vector<std::string> tmp;
-        while (line_from <= line_to) {
-            tmp.push_back(GetLine_(line_from));
-            ++line_from;
-        }
+        tmp.reserve(line_to - line_from + 1);
+        m_buffer.ForEach(line_from - 1, line_to, [&tmp](const LineText &line) {
+            tmp.push_back(line.ToString());
+        });
         return tmp;
     }
 
     std::string File::GetAll_() const {
         std::string tmp;
-        std::vector<std::string> all_lines = GetLinesFromTo_(1, GetLineCount());
-        for (auto &line: all_lines) {
-            tmp.append(line);
-        }
+        m_buffer.ForEach(0, GetLineCount(), [&tmp](const LineText &line) {
+            line.AppendTo(tmp);
+        });
         return tmp;
     }
 
-    void File::EraseLine_(size_t line_num) {
-        ValidateReadUpdateDeleteParam(line_num);
-        m_buffer.erase(m_buffer.begin() + line_num);
+    void File::EraseLines_(size_t line_from, size_t line_to) {
+        ValidateReadUpdateDeleteParams(line_from, line_to);
+        MarkDirty_(line_from);
+        m_buffer.Erase(line_from - 1, line_to - line_from + 1);
+        ShiftMarks_(line_from - 1, line_to - line_from + 1, 0);
+    }
+
+    void File::MarkDirty_(size_t line_num) {
+        m_first_dirty_line = std::min(m_first_dirty_line, line_num);
+    }
+
+    void File::ShiftMarks_(size_t index, size_t erased, size_t inserted) {
+        for (LineHandle &handle: m_marks) {
+            if (handle.id == NO_LINE_ID || handle.index < index) {
+                continue;
+            }
+            if (handle.index < index + erased) {
+                handle = LineHandle();
+            } else {
+                handle.index = handle.index - erased + inserted;
+            }
+        }
+    }
+
+    size_t File::MarkIndex_(char name) {
+        if (name < FileConstant::FIRST_MARK_NAME ||
+            name >= FileConstant::FIRST_MARK_NAME + static_cast<int>(FileConstant::MARK_COUNT)) {
+            throw std::out_of_range(FileConstant::EXCEPTION_MESSAGE_BAD_MARK_NAME);
+        }
+        return static_cast<size_t>(name - FileConstant::FIRST_MARK_NAME);
+    }
+
+    void File::CopyMetaFrom_(const File &another_file) {
+        m_current_line_num = another_file.m_current_line_num;
+        m_modified_but_not_saved = another_file.m_modified_but_not_saved;
+        m_file_name = another_file.m_file_name;
+        m_first_dirty_line = another_file.m_first_dirty_line;
+        m_disk_state = another_file.m_disk_state;
+        m_marks = another_file.m_marks;
     }
 
     ////////////////////////////////// Friend Function ans Operator //////////////////////////////////
@@ -2,12 +2,18 @@
 
 #include <cassert>
 
+#include <algorithm>
+#include <array>
 #include <deque>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <vector>
 #include "common.hpp"
+#include "char_range.h"
+#include "line_reader.h"
+#include "line_storage.h"
 
 namespace MyEd {
 
@@ -18,9 +24,58 @@ namespace MyEd {
         constexpr static const bool DEFAULT_MODIFY_STATUS = false;
         constexpr static inline const char *DEFAULT_FILE_NAME = "[new file]";
         constexpr static inline const char *FILE_DELIMITER = "\n";
+        // first dirty line of a buffer which matches the file on disk
+        constexpr static const size_t NO_DIRTY_LINE = std::numeric_limits<size_t>::max();
+        // lines read from a stream are inserted this many at a time
+        constexpr static const size_t LOAD_BATCH_LINE_COUNT = 1 << 16;
+        // marks are named by a lowercase letter
+        constexpr static const char FIRST_MARK_NAME = 'a';
+        constexpr static const size_t MARK_COUNT = 26;
 
         constexpr static inline const char *EXCEPTION_MESSAGE_LINE_NUM_OUT_OF_RANGE = "Line number must greater than 1 and less or equal than last line.";
         constexpr static inline const char *EXCEPTION_MESSAGE_BAD_LINE_NUM_ORDER = "The first line number must less or equal than the second one.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_BAD_MARK_NAME = "Mark name must be a lowercase letter.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_MARK_NOT_SET = "Mark is not set.";
+    };
+
+    // keeps the text behind the views of File::GetLineViews alive
+    struct LineViewStorage {
+        std::vector<Line> lines;
+        // ropes made flat
+        std::deque<std::string> flattened;
+    };
+
+    // immutable view of a File at one point in time.
+    // It shares the line store with the File, so taking one is O(1), and it can be read from any thread
+    // without locking while the File keeps being edited.
+    class FileSnapshot {
+    private:
+        LineStorage m_lines;
+        std::string m_file_name;
+    public:
+        FileSnapshot(LineStorage lines, std::string file_name);
+
+        [[nodiscard]] size_t GetLineCount() const;
+        [[nodiscard]] uint64_t GetVersion() const;
+        [[nodiscard]] const std::string &GetFileName() const;
+
+        [[nodiscard]] std::string GetLine(size_t) const;
+        // offset of the line in the saved file, line_num may be one past the last line
+        [[nodiscard]] uint64_t GetByteOffset(size_t line_num) const;
+        const FileSnapshot &SaveTo(std::ostream &, size_t, size_t) const;
+        [[nodiscard]] CharRange GetCharRange(size_t line_from, size_t line_to) const;
+
+        // call func(line_num, line) for every line of [line_from, line_to]
+        template<typename Func>
+        void ForEachLine(size_t line_from, size_t line_to, Func &&func) const {
+            ValidateReadParams(line_from, line_to);
+            m_lines.ForEach(line_from - 1, line_to, [&line_from, &func](const LineText &line) {
+                func(line_from++, line);
+            });
+        }
+
+        void ValidateReadParam(size_t line_num) const;
+        void ValidateReadParams(size_t line_from, size_t line_to) const;
     };
 
     class File {
@@ -31,10 +86,15 @@ namespace MyEd {
         friend File operator+(const File &, const File &);
 
     private:
-        std::deque<std::string> m_buffer;
+        LineStorage m_buffer;
         size_t m_current_line_num;
         std::string m_file_name;
         bool m_modified_but_not_saved;
+        // lines before m_first_dirty_line are byte for byte what m_disk_state describes on disk
+        size_t m_first_dirty_line;
+        FileDiskState m_disk_state;
+        // follow their lines through every edit, a mark is dropped with its line
+        std::array<LineHandle, FileConstant::MARK_COUNT> m_marks;
     public:
         File();
         explicit File(const std::string &);
@@ -58,10 +118,26 @@ namespace MyEd {
 
         [[nodiscard]] bool IsEmptyFile() const;
 
+        // every line from the first dirty one on was inserted, erased or replaced since the last load or save
+        [[nodiscard]] size_t GetFirstDirtyLine() const;
+        [[nodiscard]] const FileDiskState &GetDiskState() const;
+        // the whole buffer now is the content of the file described by disk_state (or of no known file)
+        void MarkSaved(const FileDiskState &disk_state);
+        // offset of the line in the saved file, line_num may be one past the last line
+        [[nodiscard]] uint64_t GetByteOffset(size_t line_num) const;
+
+        // k and ' of ed, a mark stays on its line when lines are inserted, erased or moved around it
+        void SetMark(char name, size_t line_num);
+        size_t GetMarkedLine(char name);
+
+        [[nodiscard]] uint64_t GetVersion() const;
+        [[nodiscard]] FileSnapshot Snapshot() const;
+
         //C
         File &LoadFrom(const std::string &);
         File &LoadFrom(std::istream &);
         File &LoadFrom(const File &);
+        File &LoadFrom(const LineReader &);
         File &operator=(const std::string &);
         File &operator=(std::istream &);
         File &operator=(const File &);
@@ -69,6 +145,10 @@ namespace MyEd {
         size_t InsertOneOrMultiplyLines(size_t, const std::string &);
         size_t InsertOneOrMultiplyLines(size_t, std::istream &);
         size_t InsertOneOrMultiplyLines(size_t, const File &);
+        // the lines of a file mapped by a LineReader, split on all cores
+        size_t InsertOneOrMultiplyLines(size_t, const LineReader &);
+        // insert a copy of [line_from, line_to] before line_num, sharing the payloads; the copies are new lines
+        size_t CopyLines(size_t line_from, size_t line_to, size_t line_num);
 
         File &Append(const std::string &);
         File &Append(std::istream &);
@@ -83,6 +163,7 @@ namespace MyEd {
         //R
         const File &SaveTo(std::string &) const;
         const File &SaveTo(std::ostream &) const;
+        const File &SaveTo(std::ostream &, size_t, size_t) const;
         const File &SaveTo(File &) const;
         const File &operator>>(std::string &) const;
         const File &operator>>(std::ostream &) const;
@@ -91,10 +172,44 @@ namespace MyEd {
         std::string GetLine(size_t);
         std::string operator[](size_t);
         std::vector<std::string> GetLinesFromTo(size_t, size_t);
+        // like GetLine, sharing the payload instead of copying it
+        Line GetSharedLine(size_t);
+        // like GetLinesFromTo, sharing the payloads instead of copying them; they stay valid whatever happens
+        // to the file, even if their chunk is spilled
+        std::vector<Line> GetSharedLinesFromTo(size_t, size_t);
+        // the lines of [line_from, line_to] as one view each, e.g. to compare them; they stay valid as long as
+        // storage does
+        std::vector<std::string_view> GetLineViews(size_t line_from, size_t line_to, LineViewStorage &storage);
+        // the characters of [line_from, line_to] as one sequence, e.g. for searches spanning lines
+        [[nodiscard]] CharRange GetCharRange(size_t line_from, size_t line_to) const;
         std::string GetAll();
         std::string operator*();
 
+        // call func(line_num, line) for every line of [line_from, line_to] without copying them,
+        // the current line becomes line_to like GetLinesFromTo does
+        template<typename Func>
+        void ForEachLine(size_t line_from, size_t line_to, Func &&func) {
+            MYED_TRACE_SCOPE(TraceConstant::CATEGORY_FILE, "File::ForEachLine");
+            ValidateReadUpdateDeleteParams(line_from, line_to);
+            m_current_line_num = line_to;
+            m_buffer.ForEach(line_from - 1, line_to, [&line_from, &func](const LineText &line) {
+                func(line_from++, line);
+            });
+        }
+
         //U
+        // move [line_from, line_to] so that it starts at line_num of the file as it was before the move,
+        // like inserting there after erasing them does, but keeping the identity of the lines
+        void MoveLines(size_t line_from, size_t line_to, size_t line_num);
+        // put the line at line_from + order[i] to line_from + i for every i, keeping the identity of the lines
+        void ReorderLines(size_t line_from, const std::vector<size_t> &order);
+        // keep the lines of [line_from, line_from + keep.size()) for which keep is true, in their order and
+        // with their identity, and erase the others as one range
+        void RetainLines(size_t line_from, const std::vector<bool> &keep);
+        // put line in place of the line at line_num, like erasing it and inserting line there does
+        void ReplaceLine(size_t line_num, Line line);
+        // put lines in place of as many lines from line_from on, with one modification of the store
+        void ReplaceLines(size_t line_from, std::vector<Line> &&lines);
         //TODO
 //        File Split(size_t);
 
@@ -112,14 +227,20 @@ namespace MyEd {
     private:
 
         void AutoResize_(size_t expected_new_line_num);
-        void InsertLine_(size_t line_num, const std::string &new_line);
-        void InsertLine_(size_t line_num, std::string &&new_line);
+        void InsertLines_(size_t line_num, std::vector<Line> &&new_lines);
+        // a shared line which is not terminated (the last one of a file may not be) gets its own terminated copy
+        static void TerminateLines_(std::vector<Line> &lines);
+        void MarkDirty_(size_t line_num);
+        // keep the marks on their lines after erased lines at index were replaced by inserted lines
+        void ShiftMarks_(size_t index, size_t erased, size_t inserted);
+        static size_t MarkIndex_(char name);
+        void CopyMetaFrom_(const File &another_file);
 
-        [[nodiscard]] const std::string &GetLine_(size_t line_num) const;
+        [[nodiscard]] std::string GetLine_(size_t line_num) const;
         [[nodiscard]] std::vector<std::string> GetLinesFromTo_(size_t line_from, size_t line_to) const;
         [[nodiscard]] std::string GetAll_() const;
 
-        void EraseLine_(size_t line_num);
+        void EraseLines_(size_t line_from, size_t line_to);
     };
 
     std::string &operator<<(std::string &, const File &);
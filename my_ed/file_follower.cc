@@ -0,0 +1,157 @@
+#include "file_follower.h"
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <istream>
+
+#include "async_io.h"
+#include "trace.h"
+
+namespace MyEd {
+    FileFollower::FileFollower(const std::string &file_name)
+            : m_file_name(file_name),
+              m_inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+              m_watch_descriptor(-1),
+              m_polling(true),
+              m_offset(FileFollowerConstant::UNKNOWN_SIZE),
+              m_partial_line(false) {}
+
+    FileFollower::~FileFollower() {
+        if (m_inotify_fd >= 0) {
+            close(m_inotify_fd);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    const std::string &FileFollower::GetFileName() const {
+        return m_file_name;
+    }
+
+    void FileFollower::Reset(const FileDiskState &disk_state, uint64_t loaded_size) {
+        Watch_();
+        // the file may have changed since disk_state was taken
+        m_polling = true;
+        m_disk_state = disk_state;
+        m_offset = loaded_size;
+        m_partial_line = false;
+        if (m_offset != FileFollowerConstant::UNKNOWN_SIZE && m_offset != 0 && !IsNewlineAt_(m_offset - 1)) {
+            // the last newline of the buffer is not in the file (yet)
+            --m_offset;
+            m_partial_line = true;
+        }
+    }
+
+    FollowChange FileFollower::Check() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "FileFollower::Check");
+        if (!m_polling && !DrainEvents_()) {
+            return FollowChange::NONE;
+        }
+        FileDiskState disk_state = FileUtil::GetDiskState(m_file_name);
+        if (!disk_state.valid) {
+            // moved away and not recreated yet
+            m_polling = true;
+            return FollowChange::NONE;
+        }
+        bool same_file = disk_state.device == m_disk_state.device && disk_state.inode == m_disk_state.inode;
+        // from now on inotify tells when the watched file changes
+        m_polling = m_watch_descriptor < 0 || !same_file;
+        if (m_offset == FileFollowerConstant::UNKNOWN_SIZE) {
+            return disk_state != m_disk_state ? FollowChange::REPLACED : FollowChange::NONE;
+        }
+        if (!same_file || static_cast<uint64_t>(disk_state.size) < m_offset) {
+            return FollowChange::REPLACED;
+        }
+        return static_cast<uint64_t>(disk_state.size) > m_offset ? FollowChange::APPENDED : FollowChange::NONE;
+    }
+
+    size_t FileFollower::AppendTo(File &file) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "FileFollower::AppendTo");
+        AsyncInputStreamBuffer stream_buffer;
+        if (!stream_buffer.Open(m_file_name, m_offset)) {
+            return 0;
+        }
+        std::istream input_stream(&stream_buffer);
+        input_stream.exceptions(std::ios::badbit);
+
+        size_t current_line_num = file.GetCurrentLineNum();
+        size_t line_count = file.GetLineCount();
+        // the buffer stays a copy of the file if it was one
+        bool mirrored = file.GetDiskState().valid && file.GetDiskState() == m_disk_state &&
+                        file.GetFirstDirtyLine() > line_count && !m_partial_line;
+        size_t new_line_count = 0;
+        std::string rest_of_line;
+        if (m_partial_line && line_count != 0 && std::getline(input_stream, rest_of_line)) {
+            Line last_line = file.GetSharedLine(line_count);
+            size_t kept_size = last_line->Size();
+            if (last_line->EndsWith(FileConstant::FILE_DELIMITER)) {
+                --kept_size;
+            }
+            LineTextBuilder builder;
+            builder.Append(*last_line, 0, kept_size).Append(rest_of_line).Append(FileConstant::FILE_DELIMITER);
+            file.ReplaceLine(line_count, builder.Build());
+        }
+        new_line_count += file.InsertOneOrMultiplyLines(file.GetLineCount() + 1, input_stream);
+        file.SetCurrentLineNum(current_line_num);
+
+        m_offset = static_cast<uint64_t>(stream_buffer.pubseekoff(0, std::ios::cur, std::ios::in));
+        m_partial_line = m_offset != 0 && !IsNewlineAt_(m_offset - 1);
+        FileDiskState disk_state = FileUtil::GetDiskState(m_file_name);
+        if (disk_state.device == m_disk_state.device && disk_state.inode == m_disk_state.inode) {
+            m_disk_state = disk_state;
+        }
+        if (mirrored && !m_partial_line && m_disk_state == disk_state &&
+            static_cast<uint64_t>(disk_state.size) == m_offset) {
+            file.MarkSaved(disk_state);
+        }
+        return new_line_count;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void FileFollower::Watch_() {
+        if (m_inotify_fd < 0) {
+            return;
+        }
+        if (m_watch_descriptor >= 0) {
+            // fails harmlessly when the kernel already dropped the watch with its file
+            inotify_rm_watch(m_inotify_fd, m_watch_descriptor);
+        }
+        // events of the old watch must not count for the new one
+        DrainEvents_();
+        m_watch_descriptor = inotify_add_watch(m_inotify_fd, m_file_name.c_str(),
+                                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF |
+                                               IN_DELETE_SELF);
+    }
+
+    bool FileFollower::DrainEvents_() {
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        while (true) {
+            ssize_t size = read(m_inotify_fd, buffer, sizeof(buffer));
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                return changed;
+            }
+            for (ssize_t pos = 0; pos < size;) {
+                const auto *event = reinterpret_cast<const inotify_event *>(buffer + pos);
+                changed = true;
+                pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+
+    bool FileFollower::IsNewlineAt_(uint64_t offset) const {
+        int fd = open(m_file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        char ch = 0;
+        bool newline = pread(fd, &ch, 1, static_cast<off_t>(offset)) == 1 && ch == FileConstant::FILE_DELIMITER[0];
+        close(fd);
+        return newline;
+    }
+}
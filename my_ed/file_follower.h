@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "common.hpp"
+#include "file.h"
+
+namespace MyEd {
+
+    class FileFollowerConstant {
+    public:
+        // loaded size of a buffer which cannot simply be extended, e.g. one decompressed from the file
+        constexpr static const uint64_t UNKNOWN_SIZE = std::numeric_limits<uint64_t>::max();
+    };
+
+    // what happened to a followed file since it was last looked at
+    enum class FollowChange {
+        NONE,
+        // bytes were appended, AppendTo reads them
+        APPENDED,
+        // the file was truncated, or another file took its name (e.g. rotated logs), it is to be reloaded
+        REPLACED
+    };
+
+    // Follows a file which is being written to, like tail -f.
+    // The follower knows how many bytes of the file the buffer holds; when the file grows, only the bytes
+    // appended after them are read and parsed into lines at the end of the buffer. A line cut short at the
+    // end of the file is continued by the appended bytes.
+    // Changes are noticed with inotify, so that looking for them costs one non-blocking read; when inotify
+    // is not available, or while no file of that name is watched (e.g. after a rotation, until the reload), the
+    // identity, size and mtime of the file are polled instead.
+    class FileFollower {
+    private:
+        std::string m_file_name;
+        // -1 when polling
+        int m_inotify_fd;
+        int m_watch_descriptor;
+        // look at the file at the next Check even without inotify events: there is no inotify, the file was
+        // just (re)set, or the watched file is no longer the one of that name
+        bool m_polling;
+        // of the file holding the bytes the buffer has
+        FileDiskState m_disk_state;
+        // bytes of the file in the buffer, UNKNOWN_SIZE if any change calls for a reload
+        uint64_t m_offset;
+        // the bytes in the buffer end in the middle of a line
+        bool m_partial_line;
+    public:
+        explicit FileFollower(const std::string &file_name);
+        ~FileFollower();
+
+        FileFollower(const FileFollower &) = delete;
+        FileFollower &operator=(const FileFollower &) = delete;
+
+        [[nodiscard]] const std::string &GetFileName() const;
+
+        // the buffer holds the file described by disk_state as it was loaded: loaded_size bytes, including the
+        // newline completing a last line which the file has without one
+        void Reset(const FileDiskState &disk_state, uint64_t loaded_size);
+        FollowChange Check();
+        // parse the appended bytes into lines at the end of file, the current line stays where it is.
+        // Returns the number of new lines.
+        size_t AppendTo(File &file);
+
+    private:
+        void Watch_();
+        // consume the pending inotify events, true if there were any
+        bool DrainEvents_();
+        [[nodiscard]] bool IsNewlineAt_(uint64_t offset) const;
+    };
+}
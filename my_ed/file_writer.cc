@@ -0,0 +1,115 @@
+#include "file_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "compression.h"
+#include "trace.h"
+
+namespace MyEd {
+    ////////////////////////////////// Public //////////////////////////////////
+    FileDiskState FileWriter::WriteAtomically(const FileSnapshot &snapshot, const std::string &path,
+                                              size_t line_from, size_t line_to) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "FileWriter::WriteAtomically");
+        snapshot.ValidateReadParams(line_from, line_to);
+        CompressionFormat format = CompressionUtil::FormatFromFileName(path);
+        struct stat target{};
+        bool target_exists = lstat(path.c_str(), &target) == 0;
+
+        // renaming over a symlink would replace the link itself, and over a hard link would split it
+        std::string temp_path = path + FileWriterConstant::TEMP_FILE_SUFFIX;
+        int fd = -1;
+        if (!target_exists || (S_ISREG(target.st_mode) && target.st_nlink == 1)) {
+            fd = mkstemp(temp_path.data());
+        }
+        // also when the directory is not writable but the file itself is
+        if (fd < 0) {
+            WriteInPlace_(snapshot, path, line_from, line_to);
+            return format == CompressionFormat::NONE ? FileUtil::GetDiskState(path) : FileDiskState();
+        }
+        fchmod(fd, target_exists ? target.st_mode & 07777 : NewFileMode_());
+        close(fd);
+
+        try {
+            OutputFileStream of_stream(temp_path, format);
+            snapshot.SaveTo(of_stream, line_from, line_to);
+            of_stream.Close();
+        } catch (...) {
+            unlink(temp_path.c_str());
+            throw;
+        }
+        if (rename(temp_path.c_str(), path.c_str()) != 0) {
+            unlink(temp_path.c_str());
+            throw std::runtime_error(FileWriterConstant::EXCEPTION_MESSAGE_WRITE_FAILED);
+        }
+        return format == CompressionFormat::NONE ? FileUtil::GetDiskState(path) : FileDiskState();
+    }
+
+    FileDiskState FileWriter::WriteTail(const FileSnapshot &snapshot, const std::string &path, size_t first_line) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "FileWriter::WriteTail");
+        uint64_t offset = snapshot.GetByteOffset(first_line);
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(FileWriterConstant::EXCEPTION_MESSAGE_WRITE_FAILED);
+        }
+
+        bool failed;
+        try {
+            // the kernel writes one block while the next one is filled
+            AsyncFileWriter writer(fd, offset);
+            char *buffer = writer.GetBuffer();
+            size_t filled = 0;
+            if (first_line <= snapshot.GetLineCount()) {
+                snapshot.ForEachLine(first_line, snapshot.GetLineCount(),
+                                     [&writer, &buffer, &filled](size_t, const LineText &line) {
+                    line.ForEachPiece([&writer, &buffer, &filled](std::string_view piece) {
+                        while (!piece.empty()) {
+                            size_t size = std::min(piece.size(), AsyncIoConstant::REQUEST_SIZE - filled);
+                            std::memcpy(buffer + filled, piece.data(), size);
+                            filled += size;
+                            piece.remove_prefix(size);
+                            if (filled == AsyncIoConstant::REQUEST_SIZE) {
+                                writer.Commit(filled);
+                                buffer = writer.GetBuffer();
+                                filled = 0;
+                            }
+                        }
+                    });
+                });
+            }
+            writer.Commit(filled);
+            failed = !writer.Finish();
+            failed = failed || ftruncate(fd, static_cast<off_t>(writer.GetOffset())) != 0;
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        failed = close(fd) != 0 || failed;
+        if (failed) {
+            throw std::runtime_error(FileWriterConstant::EXCEPTION_MESSAGE_WRITE_FAILED);
+        }
+        return FileUtil::GetDiskState(path);
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void FileWriter::WriteInPlace_(const FileSnapshot &snapshot, const std::string &path,
+                                   size_t line_from, size_t line_to) {
+        OutputFileStream of_stream(path);
+        snapshot.SaveTo(of_stream, line_from, line_to);
+        of_stream.Close();
+    }
+
+    mode_t FileWriter::NewFileMode_() {
+        // what std::ofstream would have created, umask can only be read by setting it
+        static const mode_t mode = []() {
+            mode_t mask = umask(0);
+            umask(mask);
+            return static_cast<mode_t>(FileWriterConstant::DEFAULT_FILE_MODE & ~mask);
+        }();
+        return mode;
+    }
+}
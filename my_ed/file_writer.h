@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "common.hpp"
+#include "file.h"
+
+namespace MyEd {
+
+    class FileWriterConstant {
+    public:
+        // appended to the target name, mkstemp replaces the X's
+        constexpr static inline const char *TEMP_FILE_SUFFIX = ".myed-XXXXXX";
+        constexpr static const mode_t DEFAULT_FILE_MODE = 0666;
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_WRITE_FAILED = "Cannot write file.";
+    };
+
+    // Saves snapshots to disk.
+    // A save either rewrites only the tail of a file whose beginning is known to be unchanged, or writes a
+    // complete new file next to the target and renames it over the target, so that a failed save never
+    // leaves a half written file behind.
+    class FileWriter {
+    public:
+        // write lines [line_from, line_to] to path, compressed when its name asks for it.
+        // Returns the state of the written file, which is invalid unless it is a plain text file.
+        static FileDiskState WriteAtomically(const FileSnapshot &snapshot, const std::string &path,
+                                             size_t line_from, size_t line_to);
+
+        // overwrite path from the first byte of first_line on with the rest of the snapshot and cut off what
+        // is left of the old content. Lines before first_line must be on disk exactly as in the snapshot.
+        static FileDiskState WriteTail(const FileSnapshot &snapshot, const std::string &path, size_t first_line);
+
+    private:
+        static void WriteInPlace_(const FileSnapshot &snapshot, const std::string &path,
+                                  size_t line_from, size_t line_to);
+        static mode_t NewFileMode_();
+    };
+}
@@ -0,0 +1,241 @@
+#include "flat_line_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+
+namespace MyEd {
+    namespace {
+        constexpr const char *EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE = "Line index out of range.";
+
+        std::atomic<uint64_t> g_next_version{1};
+
+        std::atomic<LineId> g_next_line_id{NO_LINE_ID + 1};
+
+        uint64_t NextVersion() {
+            return g_next_version.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // first of count consecutive fresh ids
+        LineId NextLineIds(size_t count) {
+            return g_next_line_id.fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+
+    FlatLineStore::Root::Root(const Root &another) : entries(another.entries), version(another.version) {
+        std::lock_guard<std::mutex> lock(another.prefix_mutex);
+        byte_prefix = another.byte_prefix;
+        prefix_size = another.prefix_size;
+    }
+
+    ////////////////////////////////// FlatLineStore //////////////////////////////////
+    FlatLineStore::FlatLineStore() : m_root(std::make_shared<Root>()) {}
+
+    ////////////////////////////////// Public //////////////////////////////////
+    size_t FlatLineStore::Size() const {
+        return m_root->entries.size();
+    }
+
+    bool FlatLineStore::Empty() const {
+        return m_root->entries.empty();
+    }
+
+    uint64_t FlatLineStore::GetVersion() const {
+        return m_root->version;
+    }
+
+    uint64_t FlatLineStore::ByteOffset(size_t index) const {
+        if (index > Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        const Root &root = *m_root;
+        std::lock_guard<std::mutex> lock(root.prefix_mutex);
+        if (index > root.prefix_size) {
+            root.byte_prefix.resize(root.entries.size() + 1);
+            for (size_t i = root.prefix_size; i < index; ++i) {
+                root.byte_prefix[i + 1] = root.byte_prefix[i] + root.entries[i].text->Size();
+            }
+            root.prefix_size = index;
+        }
+        return root.byte_prefix[index];
+    }
+
+    std::string FlatLineStore::At(size_t index) const {
+        return LineAt(index)->ToString();
+    }
+
+    Line FlatLineStore::LineAt(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        return m_root->entries[index].text;
+    }
+
+    LineId FlatLineStore::IdAt(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        return m_root->entries[index].id;
+    }
+
+    std::vector<Line> FlatLineStore::LinesIn(size_t index, size_t count) const {
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        std::vector<Line> lines;
+        lines.reserve(count);
+        for (size_t i = index; i < index + count; ++i) {
+            lines.push_back(m_root->entries[i].text);
+        }
+        return lines;
+    }
+
+    bool FlatLineStore::Locate(LineHandle &handle) const {
+        if (handle.id == NO_LINE_ID || Empty()) {
+            return false;
+        }
+        if (handle.index < Size() && IdAt(handle.index) == handle.id) {
+            return true;
+        }
+        const LineChunk::Entries &entries = m_root->entries;
+        auto itr = std::find_if(entries.begin(), entries.end(), [&handle](const LineEntry &entry) {
+            return entry.id == handle.id;
+        });
+        if (itr == entries.end()) {
+            return false;
+        }
+        handle.index = static_cast<size_t>(itr - entries.begin());
+        return true;
+    }
+
+    void FlatLineStore::Insert(size_t index, std::vector<Line> &&lines) {
+        Splice(index, 0, std::move(lines));
+    }
+
+    void FlatLineStore::Erase(size_t index, size_t count) {
+        Splice(index, count, {});
+    }
+
+    void FlatLineStore::Splice(size_t index, size_t count, std::vector<Line> &&lines) {
+        if (count == 0 && lines.empty()) {
+            if (index > Size()) {
+                throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+            }
+            return;
+        }
+        Root &root = EditRoot_(index, count);
+        auto first = root.entries.begin() + static_cast<std::ptrdiff_t>(index);
+        // overwrite what is replaced, then erase or insert only the difference
+        size_t overlap = std::min(count, lines.size());
+        LineId id = NextLineIds(lines.size());
+        for (size_t i = 0; i < overlap; ++i) {
+            first[static_cast<std::ptrdiff_t>(i)] = {id++, std::move(lines[i])};
+        }
+        first += static_cast<std::ptrdiff_t>(overlap);
+        if (count > overlap) {
+            root.entries.erase(first, first + static_cast<std::ptrdiff_t>(count - overlap));
+        } else if (lines.size() > overlap) {
+            LineChunk::Entries entries;
+            entries.reserve(lines.size() - overlap);
+            for (size_t i = overlap; i < lines.size(); ++i) {
+                entries.push_back({id++, std::move(lines[i])});
+            }
+            root.entries.insert(first, std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+        }
+        InvalidatePrefixes_(root, index);
+    }
+
+    void FlatLineStore::Move(size_t index, size_t count, size_t dest) {
+        if (index > Size() || count > Size() - index || dest > Size() - count) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        if (count == 0 || dest == index) {
+            return;
+        }
+        Root &root = EditRoot_(index, count);
+        auto begin = root.entries.begin();
+        auto from = static_cast<std::ptrdiff_t>(index);
+        auto to = static_cast<std::ptrdiff_t>(dest);
+        auto size = static_cast<std::ptrdiff_t>(count);
+        if (to < from) {
+            std::rotate(begin + to, begin + from, begin + from + size);
+        } else {
+            std::rotate(begin + from, begin + from + size, begin + to + size);
+        }
+        InvalidatePrefixes_(root, std::min(index, dest));
+    }
+
+    void FlatLineStore::Reorder(size_t index, const std::vector<size_t> &order) {
+        size_t count = order.size();
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        std::vector<bool> taken(count, false);
+        for (size_t offset: order) {
+            if (offset >= count || taken[offset]) {
+                throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+            }
+            taken[offset] = true;
+        }
+        if (count == 0) {
+            return;
+        }
+        Root &root = EditRoot_(index, count);
+        LineChunk::Entries entries(count);
+        for (size_t i = 0; i < count; ++i) {
+            entries[i] = std::move(root.entries[index + order[i]]);
+        }
+        std::move(entries.begin(), entries.end(), root.entries.begin() + static_cast<std::ptrdiff_t>(index));
+        InvalidatePrefixes_(root, index);
+    }
+
+    void FlatLineStore::Clear() {
+        auto root = std::make_shared<Root>();
+        root->version = NextVersion();
+        m_root = std::move(root);
+    }
+
+    size_t FlatLineStore::FindChunk(size_t) const {
+        return 0;
+    }
+
+    size_t FlatLineStore::GetChunkBegin(size_t) const {
+        return 0;
+    }
+
+    size_t FlatLineStore::GetChunkLineCount(size_t) const {
+        return Size();
+    }
+
+    std::shared_ptr<const LineChunk::Entries> FlatLineStore::PinChunk(size_t) const {
+        // shares the ownership of the root, so the root is copied before the store is edited again
+        return std::shared_ptr<const LineChunk::Entries>(m_root, &m_root->entries);
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    FlatLineStore::Root &FlatLineStore::MutableRoot_() {
+        if (m_root.use_count() == 1) {
+            // pairs with the release done by a reader thread dropping the last other reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return const_cast<Root &>(*m_root);
+        }
+        auto root = std::make_shared<Root>(*m_root);
+        m_root = root;
+        return *root;
+    }
+
+    FlatLineStore::Root &FlatLineStore::EditRoot_(size_t index, size_t count) {
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        Root &root = MutableRoot_();
+        root.version = NextVersion();
+        return root;
+    }
+
+    void FlatLineStore::InvalidatePrefixes_(Root &root, size_t first_index) {
+        // the root is not shared, so nobody reads the prefixes meanwhile
+        root.prefix_size = std::min(root.prefix_size, first_index);
+    }
+}
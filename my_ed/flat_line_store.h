@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "line_store.h"
+
+namespace MyEd {
+
+    // Sequence of lines kept in one contiguous vector, a storage layout interchangeable with LineStore (see
+    // line_storage.h).
+    // Copies share the vector until one of them is edited, which then copies all of it; an edit of a store
+    // nobody shares is done in place and moves the lines after it. The whole vector is the only chunk, and it
+    // is never spilled, whatever the memory budget.
+    class FlatLineStore {
+    private:
+        struct Root {
+            LineChunk::Entries entries;
+            uint64_t version = 0;
+            // byte_prefix[i] is the total length of the lines before entries[i]. Only the first
+            // prefix_size + 1 are up to date, the rest is summed up when asked for, so that a run of edits
+            // does not sum up the lines after each of them again and again.
+            mutable std::mutex prefix_mutex;
+            mutable std::vector<uint64_t> byte_prefix{0};
+            mutable size_t prefix_size = 0;
+
+            Root() = default;
+            Root(const Root &another);
+        };
+
+        std::shared_ptr<const Root> m_root;
+    public:
+        FlatLineStore();
+        // copies are O(1) snapshots; no move operations, so a moved-from store still holds a valid root
+        FlatLineStore(const FlatLineStore &) = default;
+        FlatLineStore &operator=(const FlatLineStore &) = default;
+
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] bool Empty() const;
+        [[nodiscard]] uint64_t GetVersion() const;
+
+        [[nodiscard]] uint64_t ByteOffset(size_t index) const;
+
+        // 0-based
+        [[nodiscard]] std::string At(size_t index) const;
+        [[nodiscard]] Line LineAt(size_t index) const;
+        [[nodiscard]] LineId IdAt(size_t index) const;
+        [[nodiscard]] std::vector<Line> LinesIn(size_t index, size_t count) const;
+
+        // O(n) once the index went stale
+        bool Locate(LineHandle &handle) const;
+
+        void Insert(size_t index, std::vector<Line> &&lines);
+        void Erase(size_t index, size_t count);
+        void Splice(size_t index, size_t count, std::vector<Line> &&lines);
+        void Move(size_t index, size_t count, size_t dest);
+        void Reorder(size_t index, const std::vector<size_t> &order);
+        void Clear();
+
+        // call func(const LineText &) for every line of [from, to)
+        template<typename Func>
+        void ForEach(size_t from, size_t to, Func &&func) const {
+            const LineChunk::Entries &entries = m_root->entries;
+            for (; from < to; ++from) {
+                func(*entries[from].text);
+            }
+        }
+
+        [[nodiscard]] size_t FindChunk(size_t index) const;
+        [[nodiscard]] size_t GetChunkBegin(size_t chunk_index) const;
+        [[nodiscard]] size_t GetChunkLineCount(size_t chunk_index) const;
+        // the entries stay valid as long as the returned pointer is alive, whatever happens to the store
+        [[nodiscard]] std::shared_ptr<const LineChunk::Entries> PinChunk(size_t chunk_index) const;
+
+    private:
+        Root &MutableRoot_();
+        // validate [index, index + count) and get the root to change it
+        Root &EditRoot_(size_t index, size_t count);
+        // the lines from first_index on changed
+        static void InvalidatePrefixes_(Root &root, size_t first_index);
+    };
+}
@@ -0,0 +1,90 @@
+#include "line_dedupe.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace MyEd {
+    namespace {
+        std::string_view WithoutNewline(std::string_view line) {
+            if (!line.empty() && line.back() == '\n') {
+                line.remove_suffix(1);
+            }
+            return line;
+        }
+
+        // run func(from, to) over parts of [0, count) on their own threads
+        template<typename Func>
+        void ForEachPart(size_t count, size_t part_count, Func &&func) {
+            std::vector<std::future<void>> jobs;
+            for (size_t i = 0; i < part_count; ++i) {
+                jobs.push_back(std::async(std::launch::async, [&func, count, part_count, i]() {
+                    func(count * i / part_count, count * (i + 1) / part_count);
+                }));
+            }
+            for (auto &job: jobs) {
+                job.get();
+            }
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool LineDeduper::ParseGlobalOption(const std::string &options) {
+        std::istringstream tokens(options);
+        std::string token;
+        bool global = false;
+        while (tokens >> token) {
+            if (token != LineDedupeConstant::OPTION_GLOBAL) {
+                throw std::runtime_error(LineDedupeConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+            global = true;
+        }
+        return global;
+    }
+
+    std::vector<bool> LineDeduper::KeepFirst(const std::vector<std::string_view> &lines, bool global) {
+        size_t thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        size_t part_count = std::min(thread_count,
+                                     std::max<size_t>(1, lines.size() / LineDedupeConstant::MIN_LINES_PER_THREAD));
+        // one byte per line rather than std::vector<bool>, whose bits threads could not set side by side
+        std::vector<uint8_t> keep(lines.size(), 1);
+        if (!global) {
+            ForEachPart(lines.size(), part_count, [&lines, &keep](size_t from, size_t to) {
+                for (size_t i = std::max<size_t>(from, 1); i < to; ++i) {
+                    keep[i] = WithoutNewline(lines[i]) != WithoutNewline(lines[i - 1]);
+                }
+            });
+            return {keep.begin(), keep.end()};
+        }
+
+        std::vector<size_t> hashes(lines.size());
+        ForEachPart(lines.size(), part_count, [&lines, &hashes](size_t from, size_t to) {
+            std::hash<std::string_view> hash;
+            for (size_t i = from; i < to; ++i) {
+                hashes[i] = hash(WithoutNewline(lines[i]));
+            }
+        });
+        // a line can only repeat one of its own shard, and every shard sees its lines in order
+        auto hash_of = [&hashes](size_t index) {
+            return hashes[index];
+        };
+        auto equal = [&lines, &hashes](size_t index1, size_t index2) {
+            return hashes[index1] == hashes[index2] && WithoutNewline(lines[index1]) == WithoutNewline(lines[index2]);
+        };
+        ForEachPart(part_count, part_count, [&](size_t shard, size_t) {
+            std::unordered_set<size_t, decltype(hash_of), decltype(equal)> seen(lines.size() / part_count, hash_of,
+                                                                                 equal);
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (hashes[i] % part_count == shard && !seen.insert(i).second) {
+                    keep[i] = 0;
+                }
+            }
+        });
+        return {keep.begin(), keep.end()};
+    }
+}
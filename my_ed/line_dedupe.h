@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MyEd {
+
+    class LineDedupeConstant {
+    public:
+        // below this many lines per thread hashing is not worth a thread
+        constexpr static const size_t MIN_LINES_PER_THREAD = 1 << 16;
+
+        constexpr static inline const char *OPTION_GLOBAL = "-g";
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_BAD_OPTION = "Bad uniq option, expected [-g].";
+    };
+
+    // Finds the lines which repeat an earlier one, like uniq(1) does for adjacent lines, or over the whole range
+    // keeping the first occurrence of each line where it is.
+    // Lines are hashed on all cores; the hashes are then split into shards by value, each with its own hash set
+    // filled on its own thread in line order, so that no set is shared and the first occurrence always wins.
+    class LineDeduper {
+    public:
+        // parse "[-g]", -g for duplicates anywhere in the range rather than adjacent ones
+        static bool ParseGlobalOption(const std::string &options);
+
+        // keep[i] is false for the lines equal to an earlier one, the trailing newline aside
+        static std::vector<bool> KeepFirst(const std::vector<std::string_view> &lines, bool global);
+    };
+}
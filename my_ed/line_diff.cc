@@ -0,0 +1,472 @@
+#include "line_diff.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace MyEd {
+    namespace {
+        // a stretch of lines equal on both sides
+        struct Run {
+            size_t old_begin;
+            size_t new_begin;
+            size_t length;
+        };
+
+        enum class SplitOutcome {
+            SPLIT,
+            // the stretch has nothing in common
+            DISJOINT,
+            // the split would cost more than the matcher may spend on it
+            COSTLY
+        };
+
+        // the GNU diff limit on the cost of a split, about the square root of the number of lines
+        size_t CostLimit(size_t line_count) {
+            size_t cost_limit = 1;
+            for (size_t diagonals = line_count + 3; diagonals != 0; diagonals >>= 2) {
+                cost_limit <<= 1;
+            }
+            return std::max(cost_limit, LineDiffConstant::MIN_COST_LIMIT);
+        }
+
+        // Equal runs of two sequences of lines, in order, which are compared by key.
+        // Keys are either numbers standing for the lines, or hashes of them, then lines with the same hash are
+        // compared too. A hashed matcher hands stretches costlier than MAX_HASHED_COST to an exact one, which
+        // numbers the lines of just that stretch.
+        // Stretches still to be aligned are kept on a stack instead of recursing, so that badly balanced
+        // splits cannot overflow the call stack.
+        class Matcher {
+        private:
+            struct Task {
+                size_t old_begin;
+                size_t old_end;
+                size_t new_begin;
+                size_t new_end;
+                // an equal run to record rather than a stretch to align
+                bool run;
+            };
+
+            const std::vector<uint64_t> &m_old;
+            const std::vector<uint64_t> &m_new;
+            // the lines hashed to the keys, null when the keys are numbers
+            const std::string_view *m_old_lines;
+            const std::string_view *m_new_lines;
+            size_t m_cost_limit;
+            std::vector<Run> &m_runs;
+            // furthest reaching paths of the Myers split, forward and backward
+            std::vector<long> m_forward;
+            std::vector<long> m_backward;
+        public:
+            Matcher(const std::vector<uint64_t> &old_keys, const std::vector<uint64_t> &new_keys,
+                    const std::string_view *old_lines, const std::string_view *new_lines, std::vector<Run> &runs)
+                    : m_old(old_keys), m_new(new_keys), m_old_lines(old_lines), m_new_lines(new_lines),
+                      m_cost_limit(old_lines == nullptr ? CostLimit(old_keys.size() + new_keys.size())
+                                                        : LineDiffConstant::MAX_HASHED_COST),
+                      m_runs(runs) {
+            }
+
+            void Match() {
+                std::vector<Task> tasks{{0, m_old.size(), 0, m_new.size(), false}};
+                while (!tasks.empty()) {
+                    Task task = tasks.back();
+                    tasks.pop_back();
+                    if (task.run) {
+                        AddRun_(task.old_begin, task.new_begin, task.old_end - task.old_begin);
+                        continue;
+                    }
+                    size_t prefix = 0;
+                    while (task.old_begin + prefix < task.old_end && task.new_begin + prefix < task.new_end &&
+                           Same_(task.old_begin + prefix, task.new_begin + prefix)) {
+                        ++prefix;
+                    }
+                    AddRun_(task.old_begin, task.new_begin, prefix);
+                    task.old_begin += prefix;
+                    task.new_begin += prefix;
+                    size_t suffix = 0;
+                    while (task.old_end - suffix > task.old_begin && task.new_end - suffix > task.new_begin &&
+                           Same_(task.old_end - suffix - 1, task.new_end - suffix - 1)) {
+                        ++suffix;
+                    }
+                    task.old_end -= suffix;
+                    task.new_end -= suffix;
+                    if (suffix != 0) {
+                        tasks.push_back({task.old_end, task.old_end + suffix, task.new_end, task.new_end + suffix, true});
+                    }
+                    size_t old_size = task.old_end - task.old_begin;
+                    size_t new_size = task.new_end - task.new_begin;
+                    if (old_size == 0 || new_size == 0) {
+                        continue;
+                    }
+                    if (std::min(old_size, new_size) <= LineDiffConstant::MAX_BIT_PARALLEL_LINES &&
+                        old_size * new_size <= LineDiffConstant::MAX_BIT_PARALLEL_CELLS) {
+                        AlignBitParallel_(task.old_begin, task.old_end, task.new_begin, task.new_end);
+                        continue;
+                    }
+                    size_t old_split = 0;
+                    size_t new_split = 0;
+                    SplitOutcome outcome = Split_(task.old_begin, task.old_end, task.new_begin, task.new_end,
+                                                  old_split, new_split);
+                    if (outcome == SplitOutcome::COSTLY) {
+                        AlignExactly_(task.old_begin, task.old_end, task.new_begin, task.new_end);
+                    } else if (outcome == SplitOutcome::SPLIT) {
+                        tasks.push_back({old_split, task.old_end, new_split, task.new_end, false});
+                        tasks.push_back({task.old_begin, old_split, task.new_begin, new_split, false});
+                    }
+                }
+            }
+
+        private:
+            bool Same_(size_t old_index, size_t new_index) const {
+                return m_old[old_index] == m_new[new_index] &&
+                       (m_old_lines == nullptr || m_old_lines[old_index] == m_new_lines[new_index]);
+            }
+
+            void AddRun_(size_t old_begin, size_t new_begin, size_t length) {
+                if (length == 0) {
+                    return;
+                }
+                if (!m_runs.empty()) {
+                    Run &last = m_runs.back();
+                    if (last.old_begin + last.length == old_begin && last.new_begin + last.length == new_begin) {
+                        last.length += length;
+                        return;
+                    }
+                }
+                m_runs.push_back({old_begin, new_begin, length});
+            }
+
+            // a point of an optimal edit path from (old_begin, new_begin) to (old_end, new_end) about halfway
+            // along it, found by running Myers from both ends until the paths meet. Past the cost limit an exact
+            // matcher settles for the furthest point the forward paths reached, a hashed one gives up
+            SplitOutcome Split_(size_t old_begin, size_t old_end, size_t new_begin, size_t new_end,
+                                size_t &old_split, size_t &new_split) {
+                const auto n = static_cast<long>(old_end - old_begin);
+                const auto m = static_cast<long>(new_end - new_begin);
+                const long max_d = std::min((n + m + 1) / 2, static_cast<long>(m_cost_limit) + 2);
+                const long offset = max_d + 1;
+                const long length = 2 * max_d + 3;
+                m_forward.assign(static_cast<size_t>(length), -1);
+                m_backward.assign(static_cast<size_t>(length), -1);
+                m_forward[offset + 1] = 0;
+                m_backward[offset + 1] = 0;
+                const long delta = n - m;
+                const bool odd = (delta & 1) != 0;
+                // diagonals which left the grid are not followed any further
+                long forward_start = 0;
+                long forward_end = 0;
+                long backward_start = 0;
+                long backward_end = 0;
+                auto split_at = [&](long x, long y) {
+                    // a split at a corner would not make the stretch any smaller
+                    if ((x == 0 && y == 0) || (x == n && y == m)) {
+                        return SplitOutcome::DISJOINT;
+                    }
+                    old_split = old_begin + static_cast<size_t>(x);
+                    new_split = new_begin + static_cast<size_t>(y);
+                    return SplitOutcome::SPLIT;
+                };
+                for (long d = 0; d < max_d; ++d) {
+                    if (static_cast<size_t>(d) > m_cost_limit) {
+                        if (m_old_lines != nullptr) {
+                            return SplitOutcome::COSTLY;
+                        }
+                        long best_x = -1;
+                        long best_y = -1;
+                        for (long k = -d + 1 + forward_start; k <= d - 1 - forward_end; k += 2) {
+                            long x = m_forward[offset + k];
+                            long y = x - k;
+                            if (x >= 0 && x <= n && y >= 0 && y <= m && x + y > best_x + best_y) {
+                                best_x = x;
+                                best_y = y;
+                            }
+                        }
+                        return best_x >= 0 ? split_at(best_x, best_y) : SplitOutcome::DISJOINT;
+                    }
+                    for (long k = -d + forward_start; k <= d - forward_end; k += 2) {
+                        long index = offset + k;
+                        long x = (k == -d || (k != d && m_forward[index - 1] < m_forward[index + 1]))
+                                 ? m_forward[index + 1] : m_forward[index - 1] + 1;
+                        long y = x - k;
+                        while (x < n && y < m && Same_(old_begin + x, new_begin + y)) {
+                            ++x;
+                            ++y;
+                        }
+                        m_forward[index] = x;
+                        if (x > n) {
+                            forward_end += 2;
+                        } else if (y > m) {
+                            forward_start += 2;
+                        } else if (odd) {
+                            long backward_index = offset + delta - k;
+                            if (backward_index >= 0 && backward_index < length && m_backward[backward_index] != -1 &&
+                                x >= n - m_backward[backward_index]) {
+                                return split_at(x, y);
+                            }
+                        }
+                    }
+                    for (long k = -d + backward_start; k <= d - backward_end; k += 2) {
+                        long index = offset + k;
+                        long x = (k == -d || (k != d && m_backward[index - 1] < m_backward[index + 1]))
+                                 ? m_backward[index + 1] : m_backward[index - 1] + 1;
+                        long y = x - k;
+                        while (x < n && y < m && Same_(old_end - x - 1, new_end - y - 1)) {
+                            ++x;
+                            ++y;
+                        }
+                        m_backward[index] = x;
+                        if (x > n) {
+                            backward_end += 2;
+                        } else if (y > m) {
+                            backward_start += 2;
+                        } else if (!odd) {
+                            long forward_index = offset + delta - k;
+                            if (forward_index >= 0 && forward_index < length && m_forward[forward_index] != -1) {
+                                long forward_x = m_forward[forward_index];
+                                long forward_y = forward_x - (forward_index - offset);
+                                if (forward_x >= n - x) {
+                                    return split_at(forward_x, forward_y);
+                                }
+                            }
+                        }
+                    }
+                }
+                return SplitOutcome::DISJOINT;
+            }
+
+            // align a stretch with the lines of it numbered by content: those found on one side only are set
+            // aside as changed, since they cannot match, and the rest is matched exactly
+            void AlignExactly_(size_t old_begin, size_t old_end, size_t new_begin, size_t new_end) {
+                std::unordered_map<std::string_view, uint32_t> numbers;
+                std::vector<uint8_t> sides;
+                auto number_of = [&numbers, &sides](std::string_view line) {
+                    auto inserted = numbers.emplace(line, static_cast<uint32_t>(numbers.size()));
+                    if (inserted.second) {
+                        sides.push_back(0);
+                    }
+                    return inserted.first->second;
+                };
+                std::vector<uint32_t> old_numbers;
+                std::vector<uint32_t> new_numbers;
+                old_numbers.reserve(old_end - old_begin);
+                new_numbers.reserve(new_end - new_begin);
+                for (size_t i = old_begin; i < old_end; ++i) {
+                    old_numbers.push_back(number_of(m_old_lines[i]));
+                    sides[old_numbers.back()] |= 1;
+                }
+                for (size_t i = new_begin; i < new_end; ++i) {
+                    new_numbers.push_back(number_of(m_new_lines[i]));
+                    sides[new_numbers.back()] |= 2;
+                }
+                std::vector<uint64_t> old_keys;
+                std::vector<uint64_t> new_keys;
+                std::vector<size_t> old_indexes;
+                std::vector<size_t> new_indexes;
+                for (size_t i = 0; i < old_numbers.size(); ++i) {
+                    if (sides[old_numbers[i]] == 3) {
+                        old_keys.push_back(old_numbers[i]);
+                        old_indexes.push_back(old_begin + i);
+                    }
+                }
+                for (size_t i = 0; i < new_numbers.size(); ++i) {
+                    if (sides[new_numbers[i]] == 3) {
+                        new_keys.push_back(new_numbers[i]);
+                        new_indexes.push_back(new_begin + i);
+                    }
+                }
+                std::vector<Run> runs;
+                Matcher(old_keys, new_keys, nullptr, nullptr, runs).Match();
+                for (const Run &run: runs) {
+                    for (size_t i = 0; i < run.length; ++i) {
+                        AddRun_(old_indexes[run.old_begin + i], new_indexes[run.new_begin + i], 1);
+                    }
+                }
+            }
+
+            // LCS of the stretch by Hyyrö's bit-vector recurrence over the lines of the shorter side, keeping
+            // every row so that the alignment can be traced back
+            void AlignBitParallel_(size_t old_begin, size_t old_end, size_t new_begin, size_t new_end) {
+                bool old_in_bits = old_end - old_begin <= new_end - new_begin;
+                size_t bits_begin = old_in_bits ? old_begin : new_begin;
+                size_t rows_begin = old_in_bits ? new_begin : old_begin;
+                const std::vector<uint64_t> &bits_side = old_in_bits ? m_old : m_new;
+                const std::vector<uint64_t> &rows_side = old_in_bits ? m_new : m_old;
+                size_t bit_count = old_in_bits ? old_end - old_begin : new_end - new_begin;
+                size_t row_count = old_in_bits ? new_end - new_begin : old_end - old_begin;
+                size_t words = (bit_count + 63) / 64;
+
+                std::unordered_map<uint64_t, std::vector<uint64_t>> masks;
+                for (size_t i = 0; i < bit_count; ++i) {
+                    std::vector<uint64_t> &mask = masks[bits_side[bits_begin + i]];
+                    mask.resize(words, 0);
+                    mask[i / 64] |= uint64_t(1) << (i % 64);
+                }
+                const std::vector<uint64_t> no_match(words, 0);
+                // a zero bit i of row j is where the LCS of the first j rows grows with line i
+                std::vector<uint64_t> rows((row_count + 1) * words, ~uint64_t(0));
+                for (size_t j = 1; j <= row_count; ++j) {
+                    auto found = masks.find(rows_side[rows_begin + j - 1]);
+                    const std::vector<uint64_t> &mask = found == masks.end() ? no_match : found->second;
+                    const uint64_t *previous = rows.data() + (j - 1) * words;
+                    uint64_t *row = rows.data() + j * words;
+                    uint64_t carry = 0;
+                    uint64_t borrow = 0;
+                    for (size_t w = 0; w < words; ++w) {
+                        uint64_t v = previous[w];
+                        uint64_t u = v & mask[w];
+                        uint64_t sum = v + u;
+                        uint64_t sum_carry = sum < v;
+                        sum += carry;
+                        carry = sum_carry | (sum < carry);
+                        uint64_t difference = v - u;
+                        uint64_t difference_borrow = v < u;
+                        uint64_t borrowed = difference - borrow;
+                        borrow = difference_borrow | (difference < borrow);
+                        row[w] = sum | borrowed;
+                    }
+                }
+                // length of the LCS of the first j rows and the first i lines
+                auto lcs = [&rows, words](size_t j, size_t i) {
+                    const uint64_t *row = rows.data() + j * words;
+                    size_t count = 0;
+                    for (size_t w = 0; w * 64 < i; ++w) {
+                        uint64_t zeros = ~row[w];
+                        if (i - w * 64 < 64) {
+                            zeros &= (uint64_t(1) << (i - w * 64)) - 1;
+                        }
+                        count += static_cast<size_t>(__builtin_popcountll(zeros));
+                    }
+                    return count;
+                };
+                // equal hashes of different lines would only cost the alignment its optimality, pairs are checked
+                std::vector<std::pair<size_t, size_t>> pairs;
+                for (size_t i = bit_count, j = row_count; i > 0 && j > 0;) {
+                    size_t old_index = old_in_bits ? old_begin + i - 1 : old_begin + j - 1;
+                    size_t new_index = old_in_bits ? new_begin + j - 1 : new_begin + i - 1;
+                    if (Same_(old_index, new_index)) {
+                        pairs.emplace_back(old_index, new_index);
+                        --i;
+                        --j;
+                    } else if (lcs(j - 1, i) == lcs(j, i)) {
+                        --j;
+                    } else {
+                        --i;
+                    }
+                }
+                for (auto itr = pairs.rbegin(); itr != pairs.rend(); ++itr) {
+                    AddRun_(itr->first, itr->second, 1);
+                }
+            }
+        };
+
+        void AppendLine(std::string &output, char mark, std::string_view line) {
+            output.push_back(mark);
+            output.append(line);
+            if (line.empty() || line.back() != '\n') {
+                output.push_back('\n');
+                output.append(LineDiffConstant::NO_NEWLINE_MARK);
+            }
+        }
+
+        // start,count of a hunk like diff -u writes it, the start is the line before an empty range
+        std::string HunkRange(size_t begin, size_t end, size_t skipped_lines) {
+            size_t count = end - begin;
+            std::string range = std::to_string(skipped_lines + begin + (count == 0 ? 0 : 1));
+            if (count != 1) {
+                range += "," + std::to_string(count);
+            }
+            return range;
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    std::vector<DiffChange> LineDiffer::Diff(const std::vector<std::string_view> &old_lines,
+                                             const std::vector<std::string_view> &new_lines, size_t known_equal) {
+        size_t prefix = std::min({known_equal, old_lines.size(), new_lines.size()});
+        while (prefix < old_lines.size() && prefix < new_lines.size() && old_lines[prefix] == new_lines[prefix]) {
+            ++prefix;
+        }
+        size_t old_end = old_lines.size();
+        size_t new_end = new_lines.size();
+        while (old_end > prefix && new_end > prefix && old_lines[old_end - 1] == new_lines[new_end - 1]) {
+            --old_end;
+            --new_end;
+        }
+
+        // the lines in between are compared by hash first
+        std::vector<uint64_t> old_keys;
+        std::vector<uint64_t> new_keys;
+        old_keys.reserve(old_end - prefix);
+        new_keys.reserve(new_end - prefix);
+        std::hash<std::string_view> hash;
+        for (size_t i = prefix; i < old_end; ++i) {
+            old_keys.push_back(hash(old_lines[i]));
+        }
+        for (size_t i = prefix; i < new_end; ++i) {
+            new_keys.push_back(hash(new_lines[i]));
+        }
+        std::vector<Run> runs;
+        Matcher(old_keys, new_keys, old_lines.data() + prefix, new_lines.data() + prefix, runs).Match();
+
+        // the changes are what lies between matched lines
+        std::vector<DiffChange> changes;
+        size_t old_pos = prefix;
+        size_t new_pos = prefix;
+        auto match = [&changes, &old_pos, &new_pos](size_t old_index, size_t new_index) {
+            if (old_index > old_pos || new_index > new_pos) {
+                changes.push_back({old_pos, old_index, new_pos, new_index});
+            }
+            old_pos = old_index + 1;
+            new_pos = new_index + 1;
+        };
+        for (const Run &run: runs) {
+            match(prefix + run.old_begin, prefix + run.new_begin);
+            old_pos += run.length - 1;
+            new_pos += run.length - 1;
+        }
+        if (old_end > old_pos || new_end > new_pos) {
+            changes.push_back({old_pos, old_end, new_pos, new_end});
+        }
+        return changes;
+    }
+
+    std::string LineDiffer::FormatUnified(const std::string &old_label, const std::string &new_label,
+                                          const std::vector<std::string_view> &old_lines,
+                                          const std::vector<std::string_view> &new_lines,
+                                          const std::vector<DiffChange> &changes, size_t skipped_lines) {
+        const size_t context = LineDiffConstant::CONTEXT_LINES;
+        std::string output;
+        output.append(LineDiffConstant::OLD_LABEL_MARK).append(old_label).push_back('\n');
+        output.append(LineDiffConstant::NEW_LABEL_MARK).append(new_label).push_back('\n');
+        for (size_t first = 0; first < changes.size();) {
+            // changes with at most twice the context between them share a hunk
+            size_t last = first;
+            while (last + 1 < changes.size() && changes[last + 1].old_begin - changes[last].old_end <= 2 * context) {
+                ++last;
+            }
+            size_t old_from = changes[first].old_begin - std::min(context, changes[first].old_begin);
+            size_t new_from = changes[first].new_begin - (changes[first].old_begin - old_from);
+            size_t old_to = std::min(old_lines.size(), changes[last].old_end + context);
+            size_t new_to = changes[last].new_end + (old_to - changes[last].old_end);
+            output.append("@@ -").append(HunkRange(old_from, old_to, skipped_lines));
+            output.append(" +").append(HunkRange(new_from, new_to, skipped_lines)).append(" @@\n");
+            size_t pos = old_from;
+            for (size_t i = first; i <= last; ++i) {
+                for (; pos < changes[i].old_begin; ++pos) {
+                    AppendLine(output, ' ', old_lines[pos]);
+                }
+                for (size_t j = changes[i].old_begin; j < changes[i].old_end; ++j) {
+                    AppendLine(output, '-', old_lines[j]);
+                }
+                for (size_t j = changes[i].new_begin; j < changes[i].new_end; ++j) {
+                    AppendLine(output, '+', new_lines[j]);
+                }
+                pos = changes[i].old_end;
+            }
+            for (; pos < old_to; ++pos) {
+                AppendLine(output, ' ', old_lines[pos]);
+            }
+            first = last + 1;
+        }
+        return output;
+    }
+}
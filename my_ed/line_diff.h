@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MyEd {
+
+    class LineDiffConstant {
+    public:
+        // unchanged lines shown around a change
+        constexpr static const size_t CONTEXT_LINES = 3;
+        // stretches whose shorter side has at most this many lines, with at most MAX_BIT_PARALLEL_CELLS pairs of
+        // lines, are aligned by the bit-parallel LCS rather than split further
+        constexpr static const size_t MAX_BIT_PARALLEL_LINES = 256;
+        constexpr static const size_t MAX_BIT_PARALLEL_CELLS = 1 << 22;
+        // edit cost after which a Myers split settles for the furthest point reached rather than the middle of
+        // an optimal path, grows with the square root of the size like in GNU diff
+        constexpr static const size_t MIN_COST_LIMIT = 4096;
+        // edit cost up to which a stretch is split comparing lines by hash; costlier stretches have their lines
+        // numbered by content first
+        constexpr static const size_t MAX_HASHED_COST = 64;
+
+        constexpr static inline const char *OLD_LABEL_MARK = "--- ";
+        constexpr static inline const char *NEW_LABEL_MARK = "+++ ";
+        constexpr static inline const char *NO_NEWLINE_MARK = "\\ No newline at end of file\n";
+    };
+
+    // [old_begin, old_end) of the old lines is replaced by [new_begin, new_end) of the new ones, 0-based
+    struct DiffChange {
+        size_t old_begin;
+        size_t old_end;
+        size_t new_begin;
+        size_t new_end;
+    };
+
+    // Line diff for the diff command.
+    // Equal lines at both ends are skipped first, then the lines in between are split by the linear-space
+    // Myers algorithm, down to stretches small enough for a bit-parallel LCS, which aligns 64 lines per
+    // machine word and row. Lines are compared by hash, which is all it takes when the changes are few; a
+    // stretch with many changes has its lines numbered by content, and those found on one side only are set
+    // aside as changed, since they cannot match, before it is split further.
+    class LineDiffer {
+    public:
+        // changes turning old_lines into new_lines, in order. The first known_equal lines are taken to be the
+        // same on both sides without comparing them
+        static std::vector<DiffChange> Diff(const std::vector<std::string_view> &old_lines,
+                                            const std::vector<std::string_view> &new_lines, size_t known_equal);
+
+        // the changes in unified format with CONTEXT_LINES lines around them; the lines given start after
+        // skipped_lines others, which count for the line numbers
+        static std::string FormatUnified(const std::string &old_label, const std::string &new_label,
+                                         const std::vector<std::string_view> &old_lines,
+                                         const std::vector<std::string_view> &new_lines,
+                                         const std::vector<DiffChange> &changes, size_t skipped_lines);
+    };
+}
@@ -0,0 +1,52 @@
+#include "line_interner.h"
+
+namespace MyEd {
+    LineInterner::LineInterner() : m_enabled(false) {}
+
+    ////////////////////////////////// Public //////////////////////////////////
+    LineInterner &LineInterner::Instance() {
+        // never destroyed, payloads may outlive static destruction
+        static auto *instance = new LineInterner();
+        return *instance;
+    }
+
+    void LineInterner::SetEnabled(bool enabled) {
+        m_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool LineInterner::IsEnabled() const {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<const LineText> LineInterner::Intern(std::string &&text) {
+        if (text.size() >= LineTextConstant::ROPE_MIN_SIZE) {
+            return std::make_shared<const LineText>(std::move(text));
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_lines.find(text);
+        if (itr != m_lines.end()) {
+            if (std::shared_ptr<const LineText> line = itr->second.lock()) {
+                return line;
+            }
+            // the payload is on its way out, its key is about to dangle
+            m_lines.erase(itr);
+        }
+        const auto *payload = new LineText(std::move(text));
+        std::shared_ptr<const LineText> line(payload, [](const LineText *dying) {
+            Instance().Forget_(dying);
+            delete dying;
+        });
+        m_lines.emplace(payload->GetFlat(), line);
+        return line;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void LineInterner::Forget_(const LineText *text) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_lines.find(text->GetFlat());
+        // the entry may already belong to a newer payload of the same text
+        if (itr != m_lines.end() && itr->first.data() == text->GetFlat().data()) {
+            m_lines.erase(itr);
+        }
+    }
+}
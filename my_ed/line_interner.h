@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "line_text.h"
+
+namespace MyEd {
+
+    // Process-wide table of line payloads for hash-consing.
+    // When it is enabled, LineStore::MakeLine hands out one shared payload for all byte-identical lines, e.g.
+    // the repeated lines of a log, instead of a copy each. Payloads are immutable, so an edit of one of the
+    // lines makes a new payload and leaves the others alone. The table only holds weak references: a payload
+    // removes itself from it when its last line goes away.
+    // Ropes (lines of ROPE_MIN_SIZE and more) are never interned.
+    class LineInterner {
+    private:
+        std::atomic<bool> m_enabled;
+        std::mutex m_mutex;
+        // keys view the text of the payload they map to
+        std::unordered_map<std::string_view, std::weak_ptr<const LineText>> m_lines;
+    public:
+        static LineInterner &Instance();
+
+        LineInterner(const LineInterner &) = delete;
+        LineInterner &operator=(const LineInterner &) = delete;
+
+        // to be set before any file is loaded, off by default
+        void SetEnabled(bool enabled);
+        [[nodiscard]] bool IsEnabled() const;
+
+        // the payload of the line text, shared with every other interned line of the same text
+        std::shared_ptr<const LineText> Intern(std::string &&text);
+
+    private:
+        LineInterner();
+
+        // the payload is being destroyed
+        void Forget_(const LineText *text);
+    };
+}
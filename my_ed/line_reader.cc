@@ -0,0 +1,99 @@
+#include "line_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+
+#include "trace.h"
+
+namespace MyEd {
+    LineReader::LineReader(const std::string &file_name) : m_data(nullptr), m_size(0) {
+        int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat buffer{};
+        if (fstat(fd, &buffer) == 0 && S_ISREG(buffer.st_mode) &&
+            static_cast<uint64_t>(buffer.st_size) >= LineReaderConstant::MIN_PARALLEL_SIZE) {
+            void *data = mmap(nullptr, static_cast<size_t>(buffer.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, static_cast<size_t>(buffer.st_size), MADV_SEQUENTIAL);
+                m_data = static_cast<const char *>(data);
+                m_size = static_cast<uint64_t>(buffer.st_size);
+            }
+        }
+        // the mapping stays valid without the descriptor
+        close(fd);
+    }
+
+    LineReader::~LineReader() {
+        if (m_data != nullptr) {
+            munmap(const_cast<char *>(m_data), static_cast<size_t>(m_size));
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool LineReader::IsMapped() const {
+        return m_data != nullptr;
+    }
+
+    void LineReader::ReadLines(const std::function<void(std::vector<Line> &&)> &consume) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "LineReader::ReadLines");
+        if (m_data == nullptr) {
+            return;
+        }
+        size_t thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        auto start_round = [this, thread_count](uint64_t begin) {
+            std::vector<std::future<std::vector<Line>>> jobs;
+            for (size_t i = 0; i < thread_count && begin < m_size; ++i) {
+                uint64_t end = std::min<uint64_t>(m_size, begin + LineReaderConstant::RANGE_SIZE);
+                jobs.push_back(std::async(std::launch::async, &LineReader::ReadRange_, this, begin, end));
+                begin = end;
+            }
+            return jobs;
+        };
+
+        uint64_t round_size = thread_count * static_cast<uint64_t>(LineReaderConstant::RANGE_SIZE);
+        std::vector<std::future<std::vector<Line>>> round = start_round(0);
+        for (uint64_t next = round_size; !round.empty(); next += round_size) {
+            std::vector<std::future<std::vector<Line>>> next_round = start_round(next);
+            for (auto &job: round) {
+                consume(job.get());
+            }
+            round = std::move(next_round);
+        }
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    std::vector<Line> LineReader::ReadRange_(uint64_t begin, uint64_t end) const {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "LineReader::ReadRange_");
+        std::vector<Line> lines;
+        uint64_t pos = begin;
+        // a line starts at begin only if the previous one ended right before it
+        if (begin != 0) {
+            const void *newline = std::memchr(m_data + begin - 1, '\n', static_cast<size_t>(end - begin + 1));
+            if (newline == nullptr) {
+                return lines;
+            }
+            pos = static_cast<const char *>(newline) - m_data + 1;
+        }
+        while (pos < end) {
+            // the last line of the range may go on into the following ones
+            const void *newline = std::memchr(m_data + pos, '\n', static_cast<size_t>(m_size - pos));
+            uint64_t line_end = newline == nullptr ? m_size : static_cast<const char *>(newline) - m_data;
+            std::string text;
+            text.reserve(static_cast<size_t>(line_end - pos + 1));
+            text.append(m_data + pos, static_cast<size_t>(line_end - pos));
+            text.push_back('\n');
+            lines.push_back(LineStore::MakeLine(std::move(text)));
+            pos = line_end + 1;
+        }
+        return lines;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "line_store.h"
+
+namespace MyEd {
+
+    class LineReaderConstant {
+    public:
+        // smaller files are not worth the threads, they are read as a stream
+        constexpr static const uint64_t MIN_PARALLEL_SIZE = 4 << 20;
+        // bytes of the file one thread splits into lines at a time
+        constexpr static const size_t RANGE_SIZE = 8 << 20;
+    };
+
+    // Splits a large plain file into lines on all cores.
+    // The file is mapped and cut into byte ranges which are scanned for newlines on their own threads, each of
+    // them making the lines which start in its range. The ranges are handed out in rounds of one per thread;
+    // the lines of a round are passed on in file order while the threads already work on the next one, so the
+    // line index is built as a running sum of the line counts of the ranges, and at most two rounds of lines
+    // are held besides the buffer (which lets a memory budget spill the lines read first).
+    class LineReader {
+    private:
+        const char *m_data;
+        uint64_t m_size;
+    public:
+        // maps file_name if it is a regular file of at least MIN_PARALLEL_SIZE bytes
+        explicit LineReader(const std::string &file_name);
+        ~LineReader();
+
+        LineReader(const LineReader &) = delete;
+        LineReader &operator=(const LineReader &) = delete;
+
+        // false when the file is to be read as a stream instead
+        [[nodiscard]] bool IsMapped() const;
+
+        // call consume(std::vector<Line> &&) for consecutive batches of the lines of the file, every line ends
+        // with a newline like the lines read from a stream do
+        void ReadLines(const std::function<void(std::vector<Line> &&)> &consume) const;
+
+    private:
+        // the lines which start in [begin, end)
+        [[nodiscard]] std::vector<Line> ReadRange_(uint64_t begin, uint64_t end) const;
+    };
+}
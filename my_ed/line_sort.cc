@@ -0,0 +1,203 @@
+#include "line_sort.h"
+
+#include <algorithm>
+#include <charconv>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace MyEd {
+    namespace {
+        struct TextItem {
+            std::string_view key;
+            size_t index;
+        };
+
+        struct NumberItem {
+            double key;
+            size_t index;
+        };
+
+        bool IsBlank(char ch) {
+            return ch == ' ' || ch == '\t';
+        }
+
+        // leading number of text like sort -n reads it, 0 when there is none
+        double ParseNumber(std::string_view text) {
+            size_t pos = 0;
+            while (pos < text.size() && IsBlank(text[pos])) {
+                ++pos;
+            }
+            if (pos < text.size() && text[pos] == '+') {
+                ++pos;
+            }
+            double number = 0;
+            std::from_chars(text.data() + pos, text.data() + text.size(), number, std::chars_format::fixed);
+            return number;
+        }
+
+        // stable sort of items: parts are sorted on their own threads, then merged pairwise, also in parallel
+        template<typename Item, typename Compare>
+        void ParallelStableSort(std::vector<Item> &items, Compare compare) {
+            size_t thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+            size_t part_count = std::min(thread_count,
+                                         std::max<size_t>(1, items.size() / LineSortConstant::MIN_LINES_PER_THREAD));
+            std::vector<size_t> bounds;
+            for (size_t i = 0; i <= part_count; ++i) {
+                bounds.push_back(items.size() * i / part_count);
+            }
+            auto begin = items.begin();
+
+            std::vector<std::future<void>> jobs;
+            for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+                jobs.push_back(std::async(std::launch::async, [begin, &bounds, &compare, i]() {
+                    std::stable_sort(begin + static_cast<std::ptrdiff_t>(bounds[i]),
+                                     begin + static_cast<std::ptrdiff_t>(bounds[i + 1]), compare);
+                }));
+            }
+            for (auto &job: jobs) {
+                job.get();
+            }
+
+            while (bounds.size() > 2) {
+                std::vector<size_t> merged_bounds;
+                jobs.clear();
+                for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+                    merged_bounds.push_back(bounds[i]);
+                    if (i + 2 >= bounds.size()) {
+                        // odd part out, merged on the next level
+                        continue;
+                    }
+                    jobs.push_back(std::async(std::launch::async, [begin, &bounds, &compare, i]() {
+                        std::inplace_merge(begin + static_cast<std::ptrdiff_t>(bounds[i]),
+                                           begin + static_cast<std::ptrdiff_t>(bounds[i + 1]),
+                                           begin + static_cast<std::ptrdiff_t>(bounds[i + 2]), compare);
+                    }));
+                }
+                merged_bounds.push_back(bounds.back());
+                for (auto &job: jobs) {
+                    job.get();
+                }
+                bounds = std::move(merged_bounds);
+            }
+        }
+
+        template<typename Item>
+        std::vector<size_t> OrderOf(const std::vector<Item> &items) {
+            std::vector<size_t> order;
+            order.reserve(items.size());
+            for (const Item &item: items) {
+                order.push_back(item.index);
+            }
+            return order;
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    SortOptions LineSorter::ParseOptions(const std::string &options) {
+        SortOptions sort_options;
+        std::istringstream tokens(options);
+        std::string token;
+        while (tokens >> token) {
+            std::string argument;
+            if (token.rfind(LineSortConstant::OPTION_KEY, 0) == 0 || token.rfind(LineSortConstant::OPTION_DELIMITER, 0) == 0) {
+                // -k N or -kN
+                argument = token.substr(2);
+                if (argument.empty() && !(tokens >> argument)) {
+                    throw std::runtime_error(LineSortConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+                }
+            }
+            if (token.rfind(LineSortConstant::OPTION_KEY, 0) == 0) {
+                size_t key_field = 0;
+                auto result = std::from_chars(argument.data(), argument.data() + argument.size(), key_field);
+                if (result.ec != std::errc() || result.ptr != argument.data() + argument.size() || key_field == 0) {
+                    throw std::runtime_error(LineSortConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+                }
+                sort_options.key_field = key_field;
+            } else if (token.rfind(LineSortConstant::OPTION_DELIMITER, 0) == 0) {
+                if (argument.size() != 1) {
+                    throw std::runtime_error(LineSortConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+                }
+                sort_options.delimiter = argument[0];
+            } else if (token.size() > 1 && token[0] == '-' &&
+                       token.find_first_not_of(std::string(LineSortConstant::OPTION_NUMERIC) +
+                                               LineSortConstant::OPTION_REVERSE + LineSortConstant::OPTION_SKIP_BLANKS,
+                                               1) == std::string::npos) {
+                sort_options.numeric |= token.find(LineSortConstant::OPTION_NUMERIC) != std::string::npos;
+                sort_options.reverse |= token.find(LineSortConstant::OPTION_REVERSE) != std::string::npos;
+                sort_options.skip_blanks |= token.find(LineSortConstant::OPTION_SKIP_BLANKS) != std::string::npos;
+            } else {
+                throw std::runtime_error(LineSortConstant::EXCEPTION_MESSAGE_BAD_OPTION);
+            }
+        }
+        return sort_options;
+    }
+
+    std::vector<size_t> LineSorter::SortedOrder(const std::vector<std::string_view> &lines, const SortOptions &options) {
+        if (options.numeric) {
+            std::vector<NumberItem> items;
+            items.reserve(lines.size());
+            for (size_t i = 0; i < lines.size(); ++i) {
+                items.push_back({ParseNumber(ExtractKey(lines[i], options)), i});
+            }
+            ParallelStableSort(items, [reverse = options.reverse](const NumberItem &item1, const NumberItem &item2) {
+                return reverse ? item2.key < item1.key : item1.key < item2.key;
+            });
+            return OrderOf(items);
+        }
+        std::vector<TextItem> items;
+        items.reserve(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            items.push_back({ExtractKey(lines[i], options), i});
+        }
+        ParallelStableSort(items, [reverse = options.reverse](const TextItem &item1, const TextItem &item2) {
+            return reverse ? item2.key < item1.key : item1.key < item2.key;
+        });
+        return OrderOf(items);
+    }
+
+    std::string_view LineSorter::ExtractKey(std::string_view line, const SortOptions &options) {
+        if (!line.empty() && line.back() == '\n') {
+            line.remove_suffix(1);
+        }
+        size_t pos = 0;
+        for (size_t field = 1; field < options.key_field; ++field) {
+            if (options.delimiter != LineSortConstant::NO_DELIMITER) {
+                pos = line.find(options.delimiter, pos);
+                if (pos == std::string_view::npos) {
+                    return {};
+                }
+                ++pos;
+            } else {
+                while (pos < line.size() && IsBlank(line[pos])) {
+                    ++pos;
+                }
+                while (pos < line.size() && !IsBlank(line[pos])) {
+                    ++pos;
+                }
+                if (pos == line.size()) {
+                    return {};
+                }
+            }
+        }
+        if (options.skip_blanks) {
+            // without it, a field found by blanks starts with the blanks in front of it, as in sort(1)
+            while (pos < line.size() && IsBlank(line[pos])) {
+                ++pos;
+            }
+        }
+        return line.substr(pos);
+    }
+
+    bool LineSorter::KeyBefore(std::string_view line, std::string_view key, const SortOptions &options) {
+        if (options.numeric) {
+            double line_key = ParseNumber(ExtractKey(line, options));
+            double number = ParseNumber(key);
+            return options.reverse ? number < line_key : line_key < number;
+        }
+        // a line whose key starts with key is not before it, whichever the order
+        std::string_view line_key = ExtractKey(line, options).substr(0, key.size());
+        return options.reverse ? key < line_key : line_key < key;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MyEd {
+
+    class LineSortConstant {
+    public:
+        // below this many lines per thread sorting is not worth a thread
+        constexpr static const size_t MIN_LINES_PER_THREAD = 1 << 16;
+        // fields are separated by runs of blanks unless a delimiter is given
+        constexpr static const char NO_DELIMITER = '\0';
+        constexpr static const size_t WHOLE_LINE_FIELD = 1;
+
+        constexpr static inline const char *OPTION_NUMERIC = "n";
+        constexpr static inline const char *OPTION_REVERSE = "r";
+        constexpr static inline const char *OPTION_SKIP_BLANKS = "b";
+        constexpr static inline const char *OPTION_KEY = "-k";
+        constexpr static inline const char *OPTION_DELIMITER = "-t";
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_BAD_OPTION = "Bad sort option, expected [-n] [-r] [-b] [-k N] [-t D].";
+    };
+
+    struct SortOptions {
+        bool numeric = false;
+        bool reverse = false;
+        // blanks in front of the key do not count, like sort -b; without it keys compare byte by byte
+        bool skip_blanks = false;
+        // 1-based, the key runs from the start of this field to the end of the line
+        size_t key_field = LineSortConstant::WHOLE_LINE_FIELD;
+        char delimiter = LineSortConstant::NO_DELIMITER;
+    };
+
+    // Stable sort of lines by a key, the way sort(1) -s does it.
+    // Only views of the lines and their keys are sorted, in parallel chunks merged pairwise, so lines are
+    // never copied.
+    class LineSorter {
+    public:
+        // parse "[-n] [-r] [-b] [-k N] [-t D]", flags may be combined like -nrb
+        static SortOptions ParseOptions(const std::string &options);
+
+        // order[i] is the index in lines of the line which goes to position i
+        static std::vector<size_t> SortedOrder(const std::vector<std::string_view> &lines, const SortOptions &options);
+
+        // the part of line sort compares, without the trailing newline
+        static std::string_view ExtractKey(std::string_view line, const SortOptions &options);
+
+        // whether line sorts before the lines whose key starts with key, so that a range sorted with options
+        // holds the lines for which this is true first; a text key is compared as a prefix in both orders
+        static bool KeyBefore(std::string_view line, std::string_view key, const SortOptions &options);
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "flat_line_store.h"
+#include "line_store.h"
+
+namespace MyEd {
+
+    // The sequence of lines behind File, FileSnapshot and CharRange, chosen at compile time so that layouts can
+    // be benchmarked against each other without touching them:
+    //   default                          LineStore, chunks under a persistent root (edits and copies are cheap,
+    //                                    chunks can be spilled under a memory budget)
+    //   -DMYED_WITH_FLAT_LINE_STORE      FlatLineStore, one contiguous vector (fastest reads, edits of shared
+    //                                    copies and edits far from the end cost O(n))
+    //
+    // A storage is a value type whose copies are snapshots, with the public interface of LineStore:
+    // Size, Empty, GetVersion, ByteOffset, At, LineAt, IdAt, LinesIn, Locate, Insert, Erase, Splice, Move,
+    // Reorder, Clear and ForEach, and the chunk access of FindChunk, GetChunkBegin, GetChunkLineCount and
+    // PinChunk used by CharRange. Lines are always made by LineStore::MakeLine.
+#ifdef MYED_WITH_FLAT_LINE_STORE
+    using LineStorage = FlatLineStore;
+#else
+    using LineStorage = LineStore;
+#endif
+}
@@ -0,0 +1,477 @@
+#include "line_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "chunk_cache.h"
+#include "line_interner.h"
+
+namespace MyEd {
+    namespace {
+        constexpr const char *EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE = "Line index out of range.";
+
+        std::atomic<uint64_t> g_next_version{1};
+
+        std::atomic<LineId> g_next_line_id{NO_LINE_ID + 1};
+
+        uint64_t NextVersion() {
+            return g_next_version.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // first of count consecutive fresh ids
+        LineId NextLineIds(size_t count) {
+            return g_next_line_id.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        // spill file record of a line: id, length, text; ropes are written flat and cut again when read back
+        void AppendRecord(std::string &data, const LineEntry &entry) {
+            uint64_t header[2] = {entry.id, entry.text->Size()};
+            data.append(reinterpret_cast<const char *>(header), sizeof(header));
+            entry.text->AppendTo(data);
+        }
+
+        size_t ReadRecord(const std::string &data, size_t pos, LineEntry &entry) {
+            uint64_t header[2];
+            std::memcpy(header, data.data() + pos, sizeof(header));
+            pos += sizeof(header);
+            entry.id = header[0];
+            entry.text = LineStore::MakeLine(std::string(data, pos, header[1]));
+            return pos + header[1];
+        }
+    }
+
+    ////////////////////////////////// LineChunk //////////////////////////////////
+    LineChunk::LineChunk(Entries &&entries)
+            : m_line_count(entries.size()),
+              m_bytes(CountBytes_(entries)),
+              m_entries(std::make_shared<const Entries>(std::move(entries))),
+              m_has_spill_copy(false),
+              m_spill_offset(0),
+              m_spill_length(0),
+              m_cached(false),
+              m_cached_cost(0) {
+        if (ChunkCache::Instance().IsEnabled()) {
+            ChunkCache::Instance().Touch_(*this);
+        }
+    }
+
+    LineChunk::~LineChunk() {
+        ChunkCache::Instance().Remove_(*this);
+    }
+
+    size_t LineChunk::GetLineCount() const {
+        return m_line_count;
+    }
+
+    uint64_t LineChunk::GetBytes() const {
+        return m_bytes;
+    }
+
+    std::shared_ptr<const LineChunk::Entries> LineChunk::Pin(bool *paged_in) const {
+        if (!ChunkCache::Instance().MaySpill()) {
+            // m_entries is never reset, copies of it need no lock
+            if (paged_in != nullptr) {
+                *paged_in = false;
+            }
+            return m_entries;
+        }
+        std::shared_ptr<const Entries> entries;
+        bool loaded = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_entries) {
+                std::string data(m_spill_length, '\0');
+                ChunkCache::Instance().ReadSpill_(m_spill_offset, data);
+                auto read_entries = std::make_shared<Entries>(m_line_count);
+                size_t pos = 0;
+                for (LineEntry &entry: *read_entries) {
+                    pos = ReadRecord(data, pos, entry);
+                }
+                m_entries = std::move(read_entries);
+                loaded = true;
+            }
+            entries = m_entries;
+        }
+        if (ChunkCache::Instance().IsEnabled()) {
+            ChunkCache::Instance().Touch_(*this);
+        }
+        if (paged_in != nullptr) {
+            *paged_in = loaded;
+        }
+        return entries;
+    }
+
+    void LineChunk::ReadAhead() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_entries) {
+            ChunkCache::Instance().AdviseSpill_(m_spill_offset, m_spill_length);
+        }
+    }
+
+    bool LineChunk::Spill_() const {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        // busy, or pinned by a reader
+        if (!lock.owns_lock() || !m_entries || m_entries.use_count() > 1) {
+            return false;
+        }
+        if (!m_has_spill_copy) {
+            std::string data;
+            data.reserve(m_bytes + m_line_count * sizeof(uint64_t) * 2);
+            for (const LineEntry &entry: *m_entries) {
+                AppendRecord(data, entry);
+            }
+            if (!ChunkCache::Instance().WriteSpill_(data, m_spill_offset)) {
+                return false;
+            }
+            m_spill_length = data.size();
+            m_has_spill_copy = true;
+        }
+        m_entries.reset();
+        return true;
+    }
+
+    void LineChunk::UpdateCost_() const {
+        ChunkCache::Instance().Resize_(*this);
+    }
+
+    uint64_t LineChunk::GetCost_() const {
+        return m_bytes + m_line_count * ChunkCacheConstant::LINE_OVERHEAD;
+    }
+
+    uint64_t LineChunk::CountBytes_(const Entries &entries) {
+        uint64_t bytes = 0;
+        for (const LineEntry &entry: entries) {
+            bytes += entry.text->Size();
+        }
+        return bytes;
+    }
+
+    ////////////////////////////////// LineStore //////////////////////////////////
+    LineStore::LineStore() : m_root(std::make_shared<Root>()) {}
+
+    ////////////////////////////////// Public //////////////////////////////////
+    size_t LineStore::Size() const {
+        return m_root->line_prefix.back();
+    }
+
+    bool LineStore::Empty() const {
+        return Size() == 0;
+    }
+
+    uint64_t LineStore::GetVersion() const {
+        return m_root->version;
+    }
+
+    uint64_t LineStore::ByteOffset(size_t index) const {
+        if (index > Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        if (index == Size()) {
+            return m_root->byte_prefix.back();
+        }
+        size_t chunk_index = FindChunk(index);
+        uint64_t offset = m_root->byte_prefix[chunk_index];
+        std::shared_ptr<const LineChunk::Entries> entries = PinChunk(chunk_index);
+        for (size_t i = 0; i < index - m_root->line_prefix[chunk_index]; ++i) {
+            offset += (*entries)[i].text->Size();
+        }
+        return offset;
+    }
+
+    std::string LineStore::At(size_t index) const {
+        return LineAt(index)->ToString();
+    }
+
+    Line LineStore::LineAt(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        size_t chunk_index = FindChunk(index);
+        return (*PinChunk(chunk_index))[index - m_root->line_prefix[chunk_index]].text;
+    }
+
+    LineId LineStore::IdAt(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        size_t chunk_index = FindChunk(index);
+        return (*PinChunk(chunk_index))[index - m_root->line_prefix[chunk_index]].id;
+    }
+
+    std::vector<Line> LineStore::LinesIn(size_t index, size_t count) const {
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        std::vector<Line> lines;
+        lines.reserve(count);
+        if (count == 0) {
+            return lines;
+        }
+        for (LineEntry &entry: CopyEntries_(index, count)) {
+            lines.push_back(std::move(entry.text));
+        }
+        return lines;
+    }
+
+    bool LineStore::Locate(LineHandle &handle) const {
+        if (handle.id == NO_LINE_ID || Empty()) {
+            return false;
+        }
+        if (handle.index < Size() && IdAt(handle.index) == handle.id) {
+            return true;
+        }
+        // the index went stale, e.g. the handle was kept by a copy edited in other ways: look around it first
+        size_t hint_chunk = FindChunk(std::min(handle.index, Size() - 1));
+        auto search_chunk = [this, &handle](size_t chunk_index) {
+            std::shared_ptr<const LineChunk::Entries> entries = PinChunk(chunk_index);
+            for (size_t i = 0; i < entries->size(); ++i) {
+                if ((*entries)[i].id == handle.id) {
+                    handle.index = m_root->line_prefix[chunk_index] + i;
+                    return true;
+                }
+            }
+            return false;
+        };
+        if (search_chunk(hint_chunk)) {
+            return true;
+        }
+        for (size_t chunk_index = 0; chunk_index < m_root->chunks.size(); ++chunk_index) {
+            if (chunk_index != hint_chunk && search_chunk(chunk_index)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void LineStore::Insert(size_t index, std::vector<Line> &&lines) {
+        Splice(index, 0, std::move(lines));
+    }
+
+    void LineStore::Erase(size_t index, size_t count) {
+        Splice(index, count, {});
+    }
+
+    void LineStore::Splice(size_t index, size_t count, std::vector<Line> &&lines) {
+        LineChunk::Entries entries;
+        entries.reserve(lines.size());
+        LineId id = NextLineIds(lines.size());
+        for (auto &line: lines) {
+            entries.push_back({id++, std::move(line)});
+        }
+        SpliceEntries_(index, count, std::move(entries));
+    }
+
+    void LineStore::Move(size_t index, size_t count, size_t dest) {
+        if (index > Size() || count > Size() - index || dest > Size() - count) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        if (count == 0 || dest == index) {
+            return;
+        }
+        LineChunk::Entries entries = CopyEntries_(index, count);
+        SpliceEntries_(index, count, {});
+        SpliceEntries_(dest, 0, std::move(entries));
+    }
+
+    void LineStore::Reorder(size_t index, const std::vector<size_t> &order) {
+        size_t count = order.size();
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        std::vector<size_t> new_offsets(count, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (order[i] >= count || new_offsets[order[i]] != count) {
+                throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+            }
+            new_offsets[order[i]] = i;
+        }
+        // old lines are read in order, so that touching their payloads walks memory sequentially
+        LineChunk::Entries entries(count);
+        size_t chunk_index = FindChunk(index);
+        size_t offset = index - m_root->line_prefix[chunk_index];
+        for (size_t old_offset = 0; old_offset < count; ++chunk_index, offset = 0) {
+            std::shared_ptr<const LineChunk::Entries> chunk_entries = PinChunk(chunk_index);
+            for (; offset < chunk_entries->size() && old_offset < count; ++offset, ++old_offset) {
+                entries[new_offsets[old_offset]] = (*chunk_entries)[offset];
+            }
+        }
+        SpliceEntries_(index, count, std::move(entries));
+    }
+
+    void LineStore::Clear() {
+        auto root = std::make_shared<Root>();
+        root->version = NextVersion();
+        m_root = std::move(root);
+    }
+
+    size_t LineStore::FindChunk(size_t index) const {
+        const std::vector<size_t> &prefix = m_root->line_prefix;
+        auto itr = std::upper_bound(prefix.begin(), prefix.end(), index);
+        size_t chunk_index = static_cast<size_t>(itr - prefix.begin()) - 1;
+        // index == Size() belongs to the last chunk, so that appending extends it
+        return std::min(chunk_index, m_root->chunks.size() - 1);
+    }
+
+    size_t LineStore::GetChunkBegin(size_t chunk_index) const {
+        return m_root->line_prefix[chunk_index];
+    }
+
+    size_t LineStore::GetChunkLineCount(size_t chunk_index) const {
+        return m_root->chunks[chunk_index]->GetLineCount();
+    }
+
+    std::shared_ptr<const LineChunk::Entries> LineStore::PinChunk(size_t chunk_index) const {
+        bool paged_in = false;
+        std::shared_ptr<const LineChunk::Entries> entries = m_root->chunks[chunk_index]->Pin(&paged_in);
+        // a chunk which had to be paged in is most likely part of a range read, its successors come next
+        if (paged_in) {
+            size_t end = std::min(m_root->chunks.size(), chunk_index + 1 + LineStoreConstant::READ_AHEAD_CHUNKS);
+            for (size_t i = chunk_index + 1; i < end; ++i) {
+                m_root->chunks[i]->ReadAhead();
+            }
+        }
+        return entries;
+    }
+
+    Line LineStore::MakeLine(std::string &&text) {
+        if (LineInterner::Instance().IsEnabled()) {
+            return LineInterner::Instance().Intern(std::move(text));
+        }
+        return std::make_shared<const LineText>(std::move(text));
+    }
+
+    Line LineStore::MakeLine(const std::string &text) {
+        return MakeLine(std::string(text));
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    LineChunk::Entries LineStore::CopyEntries_(size_t index, size_t count) const {
+        LineChunk::Entries entries;
+        entries.reserve(count);
+        size_t chunk_index = FindChunk(index);
+        size_t offset = index - m_root->line_prefix[chunk_index];
+        while (entries.size() < count) {
+            std::shared_ptr<const LineChunk::Entries> chunk_entries = PinChunk(chunk_index);
+            for (; offset < chunk_entries->size() && entries.size() < count; ++offset) {
+                entries.push_back((*chunk_entries)[offset]);
+            }
+            ++chunk_index;
+            offset = 0;
+        }
+        return entries;
+    }
+
+    LineStore::Root &LineStore::MutableRoot_() {
+        if (m_root.use_count() == 1) {
+            // pairs with the release done by a reader thread dropping the last other reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return const_cast<Root &>(*m_root);
+        }
+        auto root = std::make_shared<Root>(*m_root);
+        m_root = root;
+        return *root;
+    }
+
+    void LineStore::SpliceEntries_(size_t index, size_t count, LineChunk::Entries &&entries) {
+        if (index > Size() || count > Size() - index) {
+            throw std::out_of_range(EXCEPTION_MESSAGE_INDEX_OUT_OF_RANGE);
+        }
+        if (count == 0 && entries.empty()) {
+            return;
+        }
+
+        Root &root = MutableRoot_();
+        root.version = NextVersion();
+        if (root.chunks.empty()) {
+            root.chunks = Pack_(std::move(entries));
+            UpdatePrefixes_(root, 0);
+            return;
+        }
+
+        size_t first = FindChunk(index);
+        size_t last = count == 0 ? first : FindChunk(index + count - 1);
+        size_t first_offset = index - root.line_prefix[first];
+        size_t last_end = index + count - root.line_prefix[last];
+        size_t new_size = first_offset + entries.size() + (root.chunks[last]->GetLineCount() - last_end);
+
+        // the common single line edit on a chunk nobody else shares is done in place
+        bool edited = false;
+        if (first == last && root.chunks[first].use_count() == 1 &&
+            new_size <= LineStoreConstant::CHUNK_CAPACITY && new_size >= LineStoreConstant::CHUNK_MIN_FILL) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            edited = const_cast<LineChunk &>(*root.chunks[first]).EditInPlace(
+                    [first_offset, last_end, &entries](LineChunk::Entries &chunk_entries) {
+                        chunk_entries.erase(chunk_entries.begin() + static_cast<std::ptrdiff_t>(first_offset),
+                                            chunk_entries.begin() + static_cast<std::ptrdiff_t>(last_end));
+                        chunk_entries.insert(chunk_entries.begin() + static_cast<std::ptrdiff_t>(first_offset),
+                                             std::make_move_iterator(entries.begin()),
+                                             std::make_move_iterator(entries.end()));
+                    });
+        }
+        if (!edited) {
+            std::shared_ptr<const LineChunk::Entries> first_entries = PinChunk(first);
+            std::shared_ptr<const LineChunk::Entries> last_entries = PinChunk(last);
+            LineChunk::Entries merged;
+            merged.reserve(new_size);
+            merged.insert(merged.end(), first_entries->begin(),
+                          first_entries->begin() + static_cast<std::ptrdiff_t>(first_offset));
+            merged.insert(merged.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+            merged.insert(merged.end(), last_entries->begin() + static_cast<std::ptrdiff_t>(last_end),
+                          last_entries->end());
+
+            // keep chunks reasonably full so the chunk table does not degrade after many small edits
+            if (merged.size() < LineStoreConstant::CHUNK_MIN_FILL) {
+                if (last + 1 < root.chunks.size() &&
+                    merged.size() + root.chunks[last + 1]->GetLineCount() <= LineStoreConstant::CHUNK_CAPACITY) {
+                    std::shared_ptr<const LineChunk::Entries> next_entries = PinChunk(last + 1);
+                    merged.insert(merged.end(), next_entries->begin(), next_entries->end());
+                    ++last;
+                } else if (first > 0 &&
+                           merged.size() + root.chunks[first - 1]->GetLineCount() <= LineStoreConstant::CHUNK_CAPACITY) {
+                    std::shared_ptr<const LineChunk::Entries> prev_entries = PinChunk(first - 1);
+                    merged.insert(merged.begin(), prev_entries->begin(), prev_entries->end());
+                    --first;
+                }
+            }
+
+            std::vector<std::shared_ptr<const LineChunk>> packed = Pack_(std::move(merged));
+            root.chunks.erase(root.chunks.begin() + static_cast<std::ptrdiff_t>(first),
+                              root.chunks.begin() + static_cast<std::ptrdiff_t>(last + 1));
+            root.chunks.insert(root.chunks.begin() + static_cast<std::ptrdiff_t>(first),
+                               std::make_move_iterator(packed.begin()), std::make_move_iterator(packed.end()));
+        }
+
+        UpdatePrefixes_(root, first);
+    }
+
+    void LineStore::UpdatePrefixes_(Root &root, size_t first_chunk) {
+        root.line_prefix.resize(root.chunks.size() + 1);
+        root.byte_prefix.resize(root.chunks.size() + 1);
+        for (size_t i = first_chunk; i < root.chunks.size(); ++i) {
+            root.line_prefix[i + 1] = root.line_prefix[i] + root.chunks[i]->GetLineCount();
+            root.byte_prefix[i + 1] = root.byte_prefix[i] + root.chunks[i]->GetBytes();
+        }
+    }
+
+    std::vector<std::shared_ptr<const LineChunk>> LineStore::Pack_(LineChunk::Entries &&entries) {
+        std::vector<std::shared_ptr<const LineChunk>> chunks;
+        if (entries.empty()) {
+            return chunks;
+        }
+        size_t chunk_count = (entries.size() + LineStoreConstant::CHUNK_CAPACITY - 1) / LineStoreConstant::CHUNK_CAPACITY;
+        size_t base_size = entries.size() / chunk_count;
+        size_t extra = entries.size() % chunk_count;
+        chunks.reserve(chunk_count);
+        auto itr = entries.begin();
+        for (size_t i = 0; i < chunk_count; ++i) {
+            auto size = static_cast<std::ptrdiff_t>(base_size + (i < extra ? 1 : 0));
+            LineChunk::Entries chunk_entries(std::make_move_iterator(itr), std::make_move_iterator(itr + size));
+            itr += size;
+            chunks.push_back(std::make_shared<const LineChunk>(std::move(chunk_entries)));
+        }
+        return chunks;
+    }
+}
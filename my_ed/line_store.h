@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "line_text.h"
+
+namespace MyEd {
+
+    class LineStoreConstant {
+    public:
+        // lines per chunk, an edit copies at most one chunk plus the chunk table
+        constexpr static const size_t CHUNK_CAPACITY = 1024;
+        // chunks smaller than this are merged with a neighbour after an edit
+        constexpr static const size_t CHUNK_MIN_FILL = CHUNK_CAPACITY / 4;
+        constexpr static const size_t MAX_LINE_COUNT = std::numeric_limits<size_t>::max() / 2;
+        // spilled chunks after one which had to be paged back in that are announced for reading
+        constexpr static const size_t READ_AHEAD_CHUNKS = 8;
+    };
+
+    // immutable, shareable line payload
+    using Line = std::shared_ptr<const LineText>;
+    // identifies one line of a store for as long as it exists, whatever is inserted or erased around it.
+    // Copies of a store share the ids, a line copied to another place gets a new one.
+    using LineId = uint64_t;
+    constexpr const LineId NO_LINE_ID = 0;
+
+    // remembers a line by its id, index is where it was last seen and is checked before it is trusted
+    struct LineHandle {
+        LineId id = NO_LINE_ID;
+        size_t index = 0;
+    };
+
+    struct LineEntry {
+        LineId id = NO_LINE_ID;
+        Line text;
+    };
+
+    // Immutable block of consecutive lines of a LineStore.
+    // Under a memory budget (see ChunkCache) the entries of a chunk nobody is reading may be spilled to disk,
+    // Pin() pages them back in.
+    class LineChunk {
+        friend class ChunkCache;
+
+    public:
+        using Entries = std::vector<LineEntry>;
+
+    private:
+        size_t m_line_count;
+        uint64_t m_bytes;
+
+        mutable std::mutex m_mutex;
+        // null while spilled
+        mutable std::shared_ptr<const Entries> m_entries;
+        mutable bool m_has_spill_copy;
+        mutable uint64_t m_spill_offset;
+        mutable uint64_t m_spill_length;
+
+        // guarded by the ChunkCache lock
+        mutable std::list<const LineChunk *>::iterator m_lru_position;
+        mutable bool m_cached;
+        mutable uint64_t m_cached_cost;
+    public:
+        explicit LineChunk(Entries &&entries);
+        ~LineChunk();
+
+        LineChunk(const LineChunk &) = delete;
+        LineChunk &operator=(const LineChunk &) = delete;
+
+        [[nodiscard]] size_t GetLineCount() const;
+        [[nodiscard]] uint64_t GetBytes() const;
+
+        // the entries stay in memory as long as the returned pointer is alive.
+        // paged_in is set when they had to be read back from the spill file.
+        std::shared_ptr<const Entries> Pin(bool *paged_in = nullptr) const;
+        // let the kernel start reading the entries if they are spilled
+        void ReadAhead() const;
+
+        // call func(Entries &) on the entries of a chunk which is not shared with anyone, false when it is
+        template<typename Func>
+        bool EditInPlace(Func &&func) {
+            std::shared_ptr<const Entries> pinned = Pin();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // the chunk's reference and ours
+                if (m_entries.use_count() != 2) {
+                    return false;
+                }
+                auto &entries = const_cast<Entries &>(*m_entries);
+                func(entries);
+                m_line_count = entries.size();
+                m_bytes = CountBytes_(entries);
+                m_has_spill_copy = false;
+            }
+            UpdateCost_();
+            return true;
+        }
+
+    private:
+        // write the entries to the spill file unless they are there already and drop them from memory.
+        // Called by ChunkCache with its lock held, false when the chunk is in use.
+        bool Spill_() const;
+        void UpdateCost_() const;
+        [[nodiscard]] uint64_t GetCost_() const;
+        static uint64_t CountBytes_(const Entries &entries);
+    };
+
+    // Persistent sequence of lines.
+    // Lines are grouped into immutable chunks referenced from an immutable root, so copying a LineStore
+    // is O(1) and a copy is a snapshot which never changes, whatever happens to the original afterwards.
+    // Writers copy the root and the touched chunks unless they are the only owner, in which case they are
+    // updated in place. Readers never lock the store: a snapshot only ever reads immutable data, the only
+    // lock is the one of a chunk while it is pinned.
+    class LineStore {
+    private:
+        struct Root {
+            std::vector<std::shared_ptr<const LineChunk>> chunks;
+            // line_prefix[i] is the number of lines before chunks[i], line_prefix.back() is the line count
+            std::vector<size_t> line_prefix{0};
+            // byte_prefix[i] is the total length of the lines before chunks[i]
+            std::vector<uint64_t> byte_prefix{0};
+            uint64_t version = 0;
+        };
+
+        std::shared_ptr<const Root> m_root;
+    public:
+        LineStore();
+        // copies are O(1) snapshots; no move operations, so a moved-from store still holds a valid root
+        LineStore(const LineStore &) = default;
+        LineStore &operator=(const LineStore &) = default;
+
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] bool Empty() const;
+        // increases on every modification, equal versions of copies mean equal content
+        [[nodiscard]] uint64_t GetVersion() const;
+
+        // total length of the lines before index, index may be Size()
+        [[nodiscard]] uint64_t ByteOffset(size_t index) const;
+
+        // 0-based
+        [[nodiscard]] std::string At(size_t index) const;
+        [[nodiscard]] Line LineAt(size_t index) const;
+        [[nodiscard]] LineId IdAt(size_t index) const;
+        // the payloads of [index, index + count)
+        [[nodiscard]] std::vector<Line> LinesIn(size_t index, size_t count) const;
+
+        // point handle.index at the line with handle.id, O(log n) while the index is up to date.
+        // Returns false when the line is not in this store.
+        bool Locate(LineHandle &handle) const;
+
+        void Insert(size_t index, std::vector<Line> &&lines);
+        void Erase(size_t index, size_t count);
+        // replace [index, index + count) with lines in one modification
+        void Splice(size_t index, size_t count, std::vector<Line> &&lines);
+        // take [index, index + count) out and put it back before what then is dest, keeping the line ids
+        void Move(size_t index, size_t count, size_t dest);
+        // permute [index, index + order.size()) so that the line at index + order[i] goes to index + i,
+        // keeping the line ids
+        void Reorder(size_t index, const std::vector<size_t> &order);
+        void Clear();
+
+        // call func(const LineText &) for every line of [from, to)
+        template<typename Func>
+        void ForEach(size_t from, size_t to, Func &&func) const {
+            if (from >= to) {
+                return;
+            }
+            size_t chunk_index = FindChunk(from);
+            size_t offset = from - m_root->line_prefix[chunk_index];
+            while (from < to) {
+                std::shared_ptr<const LineChunk::Entries> entries = PinChunk(chunk_index);
+                for (; offset < entries->size() && from < to; ++offset, ++from) {
+                    func(*(*entries)[offset].text);
+                }
+                ++chunk_index;
+                offset = 0;
+            }
+        }
+
+        // chunks, for readers walking the lines themselves (see CharRange)
+        // the chunk holding the line at index, index == Size() belongs to the last one
+        [[nodiscard]] size_t FindChunk(size_t index) const;
+        // index of the first line of a chunk
+        [[nodiscard]] size_t GetChunkBegin(size_t chunk_index) const;
+        [[nodiscard]] size_t GetChunkLineCount(size_t chunk_index) const;
+        // pin a chunk, announcing the following ones when it had to be paged in
+        [[nodiscard]] std::shared_ptr<const LineChunk::Entries> PinChunk(size_t chunk_index) const;
+
+        // shared with the identical lines when interning is on, see LineInterner
+        static Line MakeLine(std::string &&text);
+        static Line MakeLine(const std::string &text);
+
+    private:
+        // copy the entries of [index, index + count)
+        [[nodiscard]] LineChunk::Entries CopyEntries_(size_t index, size_t count) const;
+        Root &MutableRoot_();
+        void SpliceEntries_(size_t index, size_t count, LineChunk::Entries &&entries);
+        static void UpdatePrefixes_(Root &root, size_t first_chunk);
+        static std::vector<std::shared_ptr<const LineChunk>> Pack_(LineChunk::Entries &&entries);
+    };
+}
@@ -0,0 +1,214 @@
+#include "line_text.h"
+
+#include <algorithm>
+
+namespace MyEd {
+    ////////////////////////////////// LineText //////////////////////////////////
+    LineText::LineText(std::string &&text) {
+        if (text.size() < LineTextConstant::ROPE_MIN_SIZE) {
+            m_flat = std::move(text);
+            return;
+        }
+        auto rope = std::make_unique<Rope>();
+        rope->pieces.reserve(text.size() / LineTextConstant::PIECE_SIZE + 1);
+        rope->piece_ends.reserve(rope->pieces.capacity());
+        for (size_t offset = 0; offset < text.size(); offset += LineTextConstant::PIECE_SIZE) {
+            rope->pieces.push_back(std::make_shared<const std::string>(text, offset, LineTextConstant::PIECE_SIZE));
+            rope->piece_ends.push_back(offset + rope->pieces.back()->size());
+        }
+        m_rope = std::move(rope);
+    }
+
+    size_t LineText::Size() const {
+        return IsRope() ? m_rope->piece_ends.back() : m_flat.size();
+    }
+
+    bool LineText::Empty() const {
+        return Size() == 0;
+    }
+
+    bool LineText::IsRope() const {
+        return m_rope != nullptr;
+    }
+
+    size_t LineText::GetPieceCount() const {
+        if (IsRope()) {
+            return m_rope->pieces.size();
+        }
+        return m_flat.empty() ? 0 : 1;
+    }
+
+    std::string_view LineText::GetPiece(size_t index) const {
+        return IsRope() ? std::string_view(*m_rope->pieces[index]) : std::string_view(m_flat);
+    }
+
+    std::string_view LineText::GetFlat() const {
+        return m_flat;
+    }
+
+    std::string_view LineText::GetView(std::string &storage) const {
+        if (!IsRope()) {
+            return m_flat;
+        }
+        storage = ToString();
+        return storage;
+    }
+
+    std::string LineText::ToString() const {
+        if (!IsRope()) {
+            return m_flat;
+        }
+        std::string tmp;
+        tmp.reserve(Size());
+        AppendTo(tmp);
+        return tmp;
+    }
+
+    void LineText::AppendTo(std::string &output) const {
+        ForEachPiece([&output](std::string_view piece) {
+            output.append(piece);
+        });
+    }
+
+    bool LineText::EndsWith(std::string_view suffix) const {
+        if (suffix.size() > Size()) {
+            return false;
+        }
+        for (size_t i = GetPieceCount(); !suffix.empty(); ) {
+            std::string_view piece = GetPiece(--i);
+            size_t length = std::min(piece.size(), suffix.size());
+            if (piece.substr(piece.size() - length) != suffix.substr(suffix.size() - length)) {
+                return false;
+            }
+            suffix.remove_suffix(length);
+        }
+        return true;
+    }
+
+    std::vector<size_t> LineText::FindAll(std::string_view text, size_t limit) const {
+        std::vector<size_t> found;
+        // offset at which the next occurrence may start
+        size_t next = 0;
+        // the last text.size() - 1 characters before the current piece, where an occurrence spanning
+        // into it would start
+        std::string carry;
+        size_t carry_start = 0;
+        size_t offset = 0;
+        size_t piece_count = GetPieceCount();
+        for (size_t i = 0; i < piece_count && found.size() < limit; ++i) {
+            std::string_view piece = GetPiece(i);
+            if (!carry.empty()) {
+                std::string window = carry;
+                window.append(piece.substr(0, text.size() - 1));
+                size_t pos = window.find(text, next > carry_start ? next - carry_start : 0);
+                while (pos < carry.size() && found.size() < limit) {
+                    found.push_back(carry_start + pos);
+                    next = carry_start + pos + text.size();
+                    pos = window.find(text, pos + text.size());
+                }
+            }
+            size_t pos = piece.find(text, next > offset ? next - offset : 0);
+            while (pos != std::string_view::npos && found.size() < limit) {
+                found.push_back(offset + pos);
+                next = offset + pos + text.size();
+                pos = piece.find(text, pos + text.size());
+            }
+            if (piece.size() >= text.size() - 1) {
+                carry.assign(piece.substr(piece.size() - (text.size() - 1)));
+            } else {
+                carry.append(piece);
+                carry.erase(0, carry.size() - std::min(carry.size(), text.size() - 1));
+            }
+            offset += piece.size();
+            carry_start = offset - carry.size();
+        }
+        return found;
+    }
+
+    std::ostream &operator<<(std::ostream &output_stream, const LineText &text) {
+        text.ForEachPiece([&output_stream](std::string_view piece) {
+            output_stream << piece;
+        });
+        return output_stream;
+    }
+
+    ////////////////////////////////// LineTextBuilder //////////////////////////////////
+    LineTextBuilder &LineTextBuilder::Append(std::string_view text) {
+        m_size += text.size();
+        while (!text.empty()) {
+            size_t length = std::min(text.size(), LineTextConstant::PIECE_SIZE - m_open.size());
+            m_open.append(text.substr(0, length));
+            text.remove_prefix(length);
+            if (m_open.size() == LineTextConstant::PIECE_SIZE) {
+                CloseOpenPiece_();
+            }
+        }
+        return *this;
+    }
+
+    LineTextBuilder &LineTextBuilder::Append(const LineText &text, size_t from, size_t to) {
+        if (!text.IsRope()) {
+            return Append(text.GetFlat().substr(from, to - from));
+        }
+        const LineText::Rope &rope = *text.m_rope;
+        auto itr = std::upper_bound(rope.piece_ends.begin(), rope.piece_ends.end(), from);
+        for (size_t i = itr - rope.piece_ends.begin(); i < rope.pieces.size(); ++i) {
+            size_t start = i == 0 ? 0 : rope.piece_ends[i - 1];
+            size_t end = rope.piece_ends[i];
+            if (start >= to) {
+                break;
+            }
+            size_t length = end - start;
+            // whole pieces are shared unless they are small enough to be gathered with what came before
+            bool whole = from <= start && end <= to;
+            if (whole && (length >= LineTextConstant::PIECE_SIZE / 2 ||
+                          m_open.size() + length > LineTextConstant::PIECE_SIZE)) {
+                CloseOpenPiece_();
+                m_pieces.push_back(rope.pieces[i]);
+                m_size += length;
+                continue;
+            }
+            size_t first = std::max(from, start);
+            Append(text.GetPiece(i).substr(first - start, std::min(to, end) - first));
+        }
+        return *this;
+    }
+
+    size_t LineTextBuilder::Size() const {
+        return m_size;
+    }
+
+    std::shared_ptr<const LineText> LineTextBuilder::Build() {
+        auto text = std::make_shared<LineText>();
+        if (m_size < LineTextConstant::ROPE_MIN_SIZE) {
+            text->m_flat.reserve(m_size);
+            for (const std::shared_ptr<const std::string> &piece: m_pieces) {
+                text->m_flat.append(*piece);
+            }
+            text->m_flat.append(m_open);
+        } else {
+            CloseOpenPiece_();
+            auto rope = std::make_unique<LineText::Rope>();
+            size_t offset = 0;
+            rope->piece_ends.reserve(m_pieces.size());
+            for (const std::shared_ptr<const std::string> &piece: m_pieces) {
+                offset += piece->size();
+                rope->piece_ends.push_back(offset);
+            }
+            rope->pieces = std::move(m_pieces);
+            text->m_rope = std::move(rope);
+        }
+        m_pieces.clear();
+        m_open.clear();
+        m_size = 0;
+        return text;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void LineTextBuilder::CloseOpenPiece_() {
+        if (!m_open.empty()) {
+            m_pieces.push_back(std::make_shared<const std::string>(std::move(m_open)));
+            m_open.clear();
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MyEd {
+
+    class LineTextConstant {
+    public:
+        // lines at least this long are stored as a rope of pieces instead of one string
+        constexpr static const size_t ROPE_MIN_SIZE = 1 << 20;
+        // size of the pieces a rope is cut into, an edit of a rope copies at most a piece around each change
+        constexpr static const size_t PIECE_SIZE = 1 << 16;
+    };
+
+    // Immutable text of one line.
+    // Ordinary lines are one flat string. Gigantic ones (e.g. a minified file on a single line) are a rope of
+    // immutable, shared pieces, so that replacing part of them or joining them with other lines builds a new
+    // line out of the old pieces and only copies what changed (see LineTextBuilder).
+    // Either way the text is read piece by piece; a flat, non-empty text is a single piece.
+    class LineText {
+        friend class LineTextBuilder;
+
+    private:
+        struct Rope {
+            std::vector<std::shared_ptr<const std::string>> pieces;
+            // piece_ends[i] is the offset one past the end of pieces[i]
+            std::vector<size_t> piece_ends;
+        };
+
+        std::string m_flat;
+        // null unless the text is a rope, kept out of line so that ordinary lines stay small
+        std::unique_ptr<const Rope> m_rope;
+    public:
+        LineText() = default;
+        // texts of ROPE_MIN_SIZE and more are cut into pieces
+        explicit LineText(std::string &&text);
+
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] bool Empty() const;
+        [[nodiscard]] bool IsRope() const;
+
+        [[nodiscard]] size_t GetPieceCount() const;
+        [[nodiscard]] std::string_view GetPiece(size_t index) const;
+        // the whole text of a flat line without copying it, not for ropes
+        [[nodiscard]] std::string_view GetFlat() const;
+        // the whole text in one view: a flat line's own, a rope is copied into storage to be viewed there
+        [[nodiscard]] std::string_view GetView(std::string &storage) const;
+
+        // call func(std::string_view) for every piece in order
+        template<typename Func>
+        void ForEachPiece(Func &&func) const {
+            size_t piece_count = GetPieceCount();
+            for (size_t i = 0; i < piece_count; ++i) {
+                func(GetPiece(i));
+            }
+        }
+
+        [[nodiscard]] std::string ToString() const;
+        void AppendTo(std::string &output) const;
+        [[nodiscard]] bool EndsWith(std::string_view suffix) const;
+
+        // offsets of the first limit non-overlapping occurrences of text, searched from left to right.
+        // Occurrences may span pieces; text must not be empty.
+        [[nodiscard]] std::vector<size_t> FindAll(std::string_view text, size_t limit) const;
+    };
+
+    std::ostream &operator<<(std::ostream &output_stream, const LineText &text);
+
+    // Assembles a LineText from fresh text and ranges of existing ones.
+    // Whole pieces of a rope are shared rather than copied, small bits are gathered into new pieces.
+    class LineTextBuilder {
+    private:
+        std::vector<std::shared_ptr<const std::string>> m_pieces;
+        // the piece being filled, at most PIECE_SIZE long
+        std::string m_open;
+        size_t m_size = 0;
+    public:
+        LineTextBuilder &Append(std::string_view text);
+        // [from, to) of text
+        LineTextBuilder &Append(const LineText &text, size_t from, size_t to);
+
+        [[nodiscard]] size_t Size() const;
+
+        // flat when shorter than ROPE_MIN_SIZE, leaves the builder empty
+        std::shared_ptr<const LineText> Build();
+
+    private:
+        void CloseOpenPiece_();
+    };
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace MyEd {
+
+    // Values made from strings, keeping the capacity most recently used ones.
+    // Values are shared, so one which is evicted stays valid for whoever still holds it.
+    // Not thread-safe, e.g. one per thread.
+    template<typename Value>
+    class LruCache {
+    private:
+        using Entries = std::list<std::pair<std::string, std::shared_ptr<Value>>>;
+
+        size_t m_capacity;
+        // most recently used first
+        Entries m_entries;
+        std::unordered_map<std::string, typename Entries::iterator> m_index;
+    public:
+        explicit LruCache(size_t capacity) : m_capacity(capacity) {}
+
+        // the value of key, made by make() (returning a std::shared_ptr<Value>) when it is not there.
+        // Nothing is cached when make() throws.
+        template<typename Make>
+        std::shared_ptr<Value> Get(const std::string &key, Make &&make) {
+            auto itr = m_index.find(key);
+            if (itr != m_index.end()) {
+                m_entries.splice(m_entries.begin(), m_entries, itr->second);
+                return itr->second->second;
+            }
+            std::shared_ptr<Value> value = make();
+            m_entries.emplace_front(key, value);
+            m_index.emplace(key, m_entries.begin());
+            if (m_entries.size() > m_capacity) {
+                m_index.erase(m_entries.back().first);
+                m_entries.pop_back();
+            }
+            return value;
+        }
+    };
+}
@@ -1,43 +1,202 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "batch_runner.h"
+#include "chunk_cache.h"
 #include "editor.h"
+#include "line_interner.h"
+#include "pipelined_io.h"
+#include "server.h"
+#include "session_record.h"
 
 static const char *FILE_OPEN_FAILED_INFO = "File does not exist, opened a new file.";
-static const char *DEFAULT_COMMAND = "+p";
+static const char *SERVE_OPTION = "--serve";
+static const char *MEMORY_BUDGET_OPTION = "--memory-budget";
+static const char *INTERN_OPTION = "--intern";
+static const char *JOBS_OPTION = "-j";
+static const char *SCRIPT_OPTION = "--script";
+static const char *RECORD_OPTION = "--record";
+static const char *REPLAY_OPTION = "--replay";
 
 void Usage(const std::string &proc) {
-    std::cout << "Usage: " << proc << " [file_name]" << std::endl;
+    std::string options = std::string(" [") + MEMORY_BUDGET_OPTION + " size] [" + INTERN_OPTION + "]";
+    MyEd::OutputSink::Stdout() << "Usage: " << proc << options << " [file_name]" << '\n'
+                               << "       " << proc << options << " " << SERVE_OPTION << " socket_path" << '\n'
+                               << "       " << proc << options << " [" << JOBS_OPTION << " jobs] " << SCRIPT_OPTION
+                               << " script_file [file_name...]" << '\n'
+                               << "       (without file names they are read from standard input, one per line)" << '\n'
+                               << "       " << proc << options << " " << RECORD_OPTION << " recording_file [file_name]"
+                               << '\n'
+                               << "       " << proc << options << " " << REPLAY_OPTION << " recording_file file_name"
+                               << '\n';
+}
+
+int Serve(const std::string &socket_path) {
+    try {
+        MyEd::Server server(socket_path);
+        server.Run();
+    } catch (const std::runtime_error &ex) {
+        MyEd::OutputSink::Stdout() << ex.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// run a recorded session against the file and report how the time of every command changed
+int Replay(const std::string &recording_file_name, const std::string &file_name) {
+    try {
+        return MyEd::SessionReplayer::Replay(recording_file_name, file_name, MyEd::OutputSink::Stdout()) ? 0 : 1;
+    } catch (const std::runtime_error &ex) {
+        MyEd::OutputSink::Stdout() << ex.what() << '\n';
+        return 1;
+    }
+}
+
+// run the script against every file on jobs workers, argv holds [-j jobs] --script script_file [file_name...]
+int RunBatch(int argc, char *argv[], const std::string &proc) {
+    size_t jobs = std::thread::hardware_concurrency();
+    std::string script_file_name;
+    int arg_index = 0;
+    for (; arg_index + 1 < argc; arg_index += 2) {
+        std::string option = argv[arg_index];
+        if (option == JOBS_OPTION) {
+            try {
+                jobs = std::stoul(argv[arg_index + 1]);
+            } catch (const std::logic_error &) {
+                jobs = 0;
+            }
+            if (jobs == 0) {
+                Usage(proc);
+                return 1;
+            }
+        } else if (option == SCRIPT_OPTION) {
+            script_file_name = argv[arg_index + 1];
+        } else {
+            break;
+        }
+    }
+    if (script_file_name.empty()) {
+        Usage(proc);
+        return 1;
+    }
+
+    std::vector<std::string> file_names(argv + arg_index, argv + argc);
+    if (file_names.empty()) {
+        std::string file_name;
+        while (std::getline(std::cin, file_name)) {
+            if (!file_name.empty()) {
+                file_names.push_back(file_name);
+            }
+        }
+    }
+
+    try {
+        MyEd::BatchRunner runner(MyEd::BatchRunner::ReadScript(script_file_name), std::move(file_names), jobs);
+        return runner.Run(MyEd::OutputSink::Stdout()) ? 0 : 1;
+    } catch (const std::runtime_error &ex) {
+        MyEd::OutputSink::Stdout() << ex.what() << '\n';
+        return 1;
+    }
 }
 
 int main(int argc, char *argv[]) {
+    // all output goes through OutputSink, std::cin can keep its own buffer
+    std::ios::sync_with_stdio(false);
+
+    // options for every mode come first, the remaining arguments are read as if they were not there
+    while (argc > 1) {
+        std::string option = argv[1];
+        if (option == MEMORY_BUDGET_OPTION) {
+            if (argc < 3) {
+                Usage(argv[0]);
+                exit(1);
+            }
+            try {
+                MyEd::ChunkCache::Instance().SetBudget(MyEd::ChunkCache::ParseSize(argv[2]));
+            } catch (const std::runtime_error &ex) {
+                MyEd::OutputSink::Stdout() << ex.what() << '\n';
+                exit(1);
+            }
+            argv[2] = argv[0];
+            argc -= 2;
+            argv += 2;
+        } else if (option == INTERN_OPTION) {
+            MyEd::LineInterner::Instance().SetEnabled(true);
+            argv[1] = argv[0];
+            --argc;
+            ++argv;
+        } else {
+            break;
+        }
+    }
+
+    if (argc > 1 && (std::string(argv[1]) == JOBS_OPTION || std::string(argv[1]) == SCRIPT_OPTION)) {
+        return RunBatch(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && std::string(argv[1]) == SERVE_OPTION) {
+        if (argc != 3) {
+            Usage(argv[0]);
+            exit(1);
+        }
+        return Serve(argv[2]);
+    }
+    if (argc > 1 && std::string(argv[1]) == REPLAY_OPTION) {
+        if (argc != 4) {
+            Usage(argv[0]);
+            exit(1);
+        }
+        return Replay(argv[2], argv[3]);
+    }
+    // the commands of the session, their input and timings are written to the recording
+    std::string record_file_name;
+    if (argc > 1 && std::string(argv[1]) == RECORD_OPTION) {
+        if (argc < 3) {
+            Usage(argv[0]);
+            exit(1);
+        }
+        record_file_name = argv[2];
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
     if (argc > 2) {
         Usage(argv[0]);
         exit(1);
     }
 
-    std::unique_ptr<MyEd::Editor> up_ed(new MyEd::Editor);
+    // commands are read ahead and the output is written out on threads of their own, while the editor works
+    MyEd::PipelinedInputStreamBuffer input_buffer(MyEd::PipelinedIoConstant::STDIN_FD);
+    std::istream input_stream(&input_buffer);
+    MyEd::PipelinedOutputSink output_sink(MyEd::OutputSinkConstant::STDOUT_FD);
+    std::unique_ptr<MyEd::Editor> up_ed(new MyEd::Editor(input_stream, output_sink));
+    std::unique_ptr<MyEd::SessionRecorder> recorder;
+    if (!record_file_name.empty()) {
+        try {
+            recorder = std::make_unique<MyEd::SessionRecorder>(record_file_name);
+        } catch (const std::runtime_error &ex) {
+            output_sink << ex.what() << '\n';
+            return 1;
+        }
+        recorder->Attach(input_stream);
+        up_ed->SetRecorder(recorder.get());
+    }
     if (argc > 1) {
-        bool is_load_success = up_ed->Init(argv[1]);
-        if (!is_load_success) {
-            std::cout << FILE_OPEN_FAILED_INFO << std::endl;
+        try {
+            bool is_load_success = up_ed->Init(argv[1]);
+            if (!is_load_success) {
+                output_sink << FILE_OPEN_FAILED_INFO << '\n';
+            }
+        } catch (const std::runtime_error &ex) {
+            output_sink << ex.what() << '\n';
         }
     } else {
         up_ed->Init();
     }
 
-    std::string command;
-    do {
-        std::cin.clear();
-        std::getline(std::cin, command);
-        if (std::cin.eof()) {
-            break;
-        }
-        if (command == MyEd::EditorConstants::EMPTY_STRING) {
-            command = DEFAULT_COMMAND;
-        }
-    } while (up_ed->InputCommand(command));
+    up_ed->Run();
 
     up_ed->Destroys();
 
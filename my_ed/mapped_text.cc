@@ -0,0 +1,59 @@
+#include "mapped_text.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "compression.h"
+
+namespace MyEd {
+    MappedText::MappedText(const std::string &file_name) : m_data(nullptr), m_size(0), m_mapped(false) {
+        {
+            InputFileStream stream(file_name);
+            if (!stream.IsOpen()) {
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CANNOT_OPEN_FILE);
+            }
+            if (stream.GetFormat() != CompressionFormat::NONE) {
+                std::vector<char> buffer(CompressionConstant::STREAM_BUFFER_SIZE);
+                while (stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || stream.gcount() > 0) {
+                    m_decoded.append(buffer.data(), static_cast<size_t>(stream.gcount()));
+                }
+                m_data = m_decoded.data();
+                m_size = m_decoded.size();
+                return;
+            }
+        }
+        int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CANNOT_OPEN_FILE);
+        }
+        struct stat buffer{};
+        if (fstat(fd, &buffer) == 0 && buffer.st_size > 0) {
+            void *data = mmap(nullptr, static_cast<size_t>(buffer.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(CompressionConstant::EXCEPTION_MESSAGE_CANNOT_OPEN_FILE);
+            }
+            m_data = static_cast<const char *>(data);
+            m_size = static_cast<size_t>(buffer.st_size);
+            m_mapped = true;
+        }
+        // the mapping stays valid without the descriptor
+        close(fd);
+    }
+
+    MappedText::~MappedText() {
+        if (m_mapped) {
+            munmap(const_cast<char *>(m_data), m_size);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    std::string_view MappedText::GetText() const {
+        return {m_data, m_size};
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace MyEd {
+
+    // The whole content of a file in memory, to be read in place: a plain file is mapped, so that only the
+    // pages which are looked at are read, a compressed one (.gz/.zst) is decompressed into a string.
+    class MappedText {
+    private:
+        const char *m_data;
+        size_t m_size;
+        bool m_mapped;
+        std::string m_decoded;
+    public:
+        // throws std::runtime_error when the file cannot be opened or decoded
+        explicit MappedText(const std::string &file_name);
+        ~MappedText();
+
+        MappedText(const MappedText &) = delete;
+        MappedText &operator=(const MappedText &) = delete;
+
+        [[nodiscard]] std::string_view GetText() const;
+    };
+}
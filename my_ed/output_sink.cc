@@ -0,0 +1,114 @@
+#include "output_sink.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "line_text.h"
+#include "trace.h"
+
+namespace MyEd {
+    ////////////////////////////////// OutputSink //////////////////////////////////
+    OutputSink::OutputSink() : m_buffer(OutputSinkConstant::BUFFER_SIZE), m_size(0) {}
+
+    OutputSink &OutputSink::Append(std::string_view text) {
+        if (text.size() > m_buffer.size() - m_size) {
+            Flush();
+            // nothing to gain from copying a block as big as the buffer itself
+            if (text.size() >= m_buffer.size()) {
+                Write_(text.data(), text.size());
+                return *this;
+            }
+        }
+        std::memcpy(m_buffer.data() + m_size, text.data(), text.size());
+        m_size += text.size();
+        return *this;
+    }
+
+    OutputSink &OutputSink::Append(char ch) {
+        if (m_size == m_buffer.size()) {
+            Flush();
+        }
+        m_buffer[m_size++] = ch;
+        return *this;
+    }
+
+    OutputSink &OutputSink::operator<<(std::string_view text) {
+        return Append(text);
+    }
+
+    OutputSink &OutputSink::operator<<(const std::string &text) {
+        return Append(std::string_view(text));
+    }
+
+    OutputSink &OutputSink::operator<<(const LineText &text) {
+        text.ForEachPiece([this](std::string_view piece) {
+            Append(piece);
+        });
+        return *this;
+    }
+
+    OutputSink &OutputSink::operator<<(const char *text) {
+        return Append(std::string_view(text));
+    }
+
+    OutputSink &OutputSink::operator<<(char ch) {
+        return Append(ch);
+    }
+
+    OutputSink &OutputSink::operator<<(bool value) {
+        return Append(value ? '1' : '0');
+    }
+
+    void OutputSink::Flush() {
+        if (m_size == 0) {
+            return;
+        }
+        size_t size = m_size;
+        m_size = 0;
+        Write_(m_buffer.data(), size);
+    }
+
+    OutputSink &OutputSink::Stdout() {
+        // flushed by its destructor at exit at the latest
+        static FdOutputSink stdout_sink(OutputSinkConstant::STDOUT_FD);
+        return stdout_sink;
+    }
+
+    ////////////////////////////////// FdOutputSink //////////////////////////////////
+    FdOutputSink::FdOutputSink(int fd) : m_fd(fd), m_failed(false) {}
+
+    FdOutputSink::~FdOutputSink() {
+        Flush();
+    }
+
+    void FdOutputSink::Write_(const char *data, size_t size) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "FdOutputSink::Write_");
+        // like a failed std::ostream, a broken output silently drops everything after the failure
+        while (size > 0 && !m_failed) {
+            ssize_t written = write(m_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                m_failed = true;
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    ////////////////////////////////// StringOutputSink //////////////////////////////////
+    std::string StringOutputSink::TakeString() {
+        Flush();
+        std::string tmp;
+        tmp.swap(m_string);
+        return tmp;
+    }
+
+    void StringOutputSink::Write_(const char *data, size_t size) {
+        m_string.append(data, size);
+    }
+}
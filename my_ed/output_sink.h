@@ -0,0 +1,100 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace MyEd {
+
+    class LineText;
+
+    class OutputSinkConstant {
+    public:
+        constexpr static const size_t BUFFER_SIZE = 1 << 20;
+        // longest decimal representation of a 64-bit integer plus sign
+        constexpr static const size_t MAX_INTEGER_LENGTH = 21;
+        constexpr static const int STDOUT_FD = 1;
+    };
+
+    // Buffered output used by every print path of the editor.
+    // Text and numbers (formatted with std::to_chars) are collected in one large buffer which is emitted by a
+    // single big write when it is full or when Flush() is called, i.e. before waiting for user input and at exit.
+    class OutputSink {
+    private:
+        std::vector<char> m_buffer;
+        size_t m_size;
+    public:
+        OutputSink();
+        virtual ~OutputSink() = default;
+
+        OutputSink(const OutputSink &) = delete;
+        OutputSink &operator=(const OutputSink &) = delete;
+
+        OutputSink &Append(std::string_view text);
+        OutputSink &Append(char ch);
+
+        template<typename Integer>
+        OutputSink &AppendInteger(Integer value) {
+            if (m_buffer.size() - m_size < OutputSinkConstant::MAX_INTEGER_LENGTH) {
+                Flush();
+            }
+            std::to_chars_result result = std::to_chars(m_buffer.data() + m_size, m_buffer.data() + m_buffer.size(),
+                                                        value);
+            m_size = static_cast<size_t>(result.ptr - m_buffer.data());
+            return *this;
+        }
+
+        OutputSink &operator<<(std::string_view text);
+        OutputSink &operator<<(const std::string &text);
+        OutputSink &operator<<(const LineText &text);
+        OutputSink &operator<<(const char *text);
+        OutputSink &operator<<(char ch);
+        // printed as 1/0 like std::ostream does by default
+        OutputSink &operator<<(bool value);
+
+        template<typename Integer, std::enable_if_t<std::is_integral_v<Integer> &&
+                                                    !std::is_same_v<Integer, bool> &&
+                                                    !std::is_same_v<Integer, char>, int> = 0>
+        OutputSink &operator<<(Integer value) {
+            return AppendInteger(value);
+        }
+
+        void Flush();
+
+        // process-wide sink writing to standard output
+        static OutputSink &Stdout();
+
+    protected:
+        // emit size bytes, called with large blocks only
+        virtual void Write_(const char *data, size_t size) = 0;
+    };
+
+    // writes to a file descriptor
+    class FdOutputSink : public OutputSink {
+    private:
+        int m_fd;
+        bool m_failed;
+    public:
+        explicit FdOutputSink(int fd);
+        ~FdOutputSink() override;
+
+    protected:
+        void Write_(const char *data, size_t size) override;
+    };
+
+    // collects everything in memory, e.g. the response to a server request
+    class StringOutputSink : public OutputSink {
+    private:
+        std::string m_string;
+    public:
+        ~StringOutputSink() override = default;
+
+        // flush and hand out the collected text, leaving the sink empty
+        std::string TakeString();
+
+    protected:
+        void Write_(const char *data, size_t size) override;
+    };
+}
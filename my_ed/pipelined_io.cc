@@ -0,0 +1,129 @@
+#include "pipelined_io.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+
+#include "trace.h"
+
+namespace MyEd {
+    ////////////////////////////////// PipelinedInputStreamBuffer //////////////////////////////////
+    PipelinedInputStreamBuffer::PipelinedInputStreamBuffer(int fd)
+            : m_fd(fd),
+              m_stop_fd(eventfd(0, EFD_CLOEXEC)),
+              m_ring(PipelinedIoConstant::INPUT_RING_SIZE),
+              m_peeked(0) {
+        m_thread = std::thread(&PipelinedInputStreamBuffer::ReadInput_, this);
+    }
+
+    PipelinedInputStreamBuffer::~PipelinedInputStreamBuffer() {
+        // the thread may be waiting for room in the ring or for input which never comes
+        m_ring.Close();
+        if (m_stop_fd >= 0) {
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t written = write(m_stop_fd, &one, sizeof(one));
+        }
+        m_thread.join();
+        if (m_stop_fd >= 0) {
+            close(m_stop_fd);
+        }
+    }
+
+    ////////////////////////////////// Protected //////////////////////////////////
+    PipelinedInputStreamBuffer::int_type PipelinedInputStreamBuffer::underflow() {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "PipelinedInputStreamBuffer::underflow");
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        m_ring.Consume(m_peeked);
+        const char *data = nullptr;
+        m_peeked = m_ring.Peek(data);
+        if (m_peeked == 0) {
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+        // the get area is only read from, std::streambuf just wants it writable for putback
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + m_peeked);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize PipelinedInputStreamBuffer::showmanyc() {
+        return static_cast<std::streamsize>(m_ring.GetReadableSize()) -
+               static_cast<std::streamsize>(m_peeked) + (egptr() - gptr());
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void PipelinedInputStreamBuffer::ReadInput_() {
+        char buffer[PipelinedIoConstant::READ_SIZE];
+        while (true) {
+            pollfd poll_fds[] = {{m_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}};
+            // without an eventfd the thread just reads, and the input has to end before the editor does
+            nfds_t poll_fd_count = m_stop_fd >= 0 ? 2 : 1;
+            if (poll(poll_fds, poll_fd_count, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (poll_fd_count == 2 && poll_fds[1].revents != 0) {
+                break;
+            }
+            ssize_t size;
+            {
+                MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "PipelinedInputStreamBuffer::ReadInput_");
+                size = read(m_fd, buffer, sizeof(buffer));
+            }
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0 || !m_ring.Push(buffer, static_cast<size_t>(size))) {
+                break;
+            }
+        }
+        m_ring.Close();
+    }
+
+    ////////////////////////////////// PipelinedOutputSink //////////////////////////////////
+    PipelinedOutputSink::PipelinedOutputSink(int fd) : m_fd(fd), m_ring(PipelinedIoConstant::OUTPUT_RING_SIZE) {
+        m_thread = std::thread(&PipelinedOutputSink::WriteOutput_, this);
+    }
+
+    PipelinedOutputSink::~PipelinedOutputSink() {
+        Flush();
+        m_ring.Close();
+        m_thread.join();
+    }
+
+    ////////////////////////////////// Protected //////////////////////////////////
+    void PipelinedOutputSink::Write_(const char *data, size_t size) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "PipelinedOutputSink::Write_");
+        m_ring.Push(data, size);
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void PipelinedOutputSink::WriteOutput_() {
+        bool failed = false;
+        const char *data = nullptr;
+        for (size_t size = m_ring.Peek(data); size != 0; size = m_ring.Peek(data)) {
+            MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "PipelinedOutputSink::WriteOutput_");
+            // like a failed std::ostream, a broken output silently drops everything after the failure
+            size_t done = 0;
+            while (done < size && !failed) {
+                ssize_t written = write(m_fd, data + done, size - done);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    failed = true;
+                    break;
+                }
+                done += static_cast<size_t>(written);
+            }
+            m_ring.Consume(size);
+        }
+    }
+}
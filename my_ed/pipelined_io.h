@@ -0,0 +1,65 @@
+#pragma once
+
+#include <streambuf>
+#include <thread>
+
+#include "output_sink.h"
+#include "spsc_ring.h"
+
+namespace MyEd {
+
+    class PipelinedIoConstant {
+    public:
+        constexpr static const size_t INPUT_RING_SIZE = 1 << 20;
+        constexpr static const size_t OUTPUT_RING_SIZE = 1 << 23;
+        // bytes the input thread asks read(2) for at a time
+        constexpr static const size_t READ_SIZE = 1 << 16;
+        constexpr static const int STDIN_FD = 0;
+    };
+
+    // std::streambuf reading a file descriptor on a thread of its own.
+    // The thread reads ahead into a SpscByteRing, so that the next commands are already there when the editor
+    // is done with the current one; the editor reads them straight out of the ring.
+    class PipelinedInputStreamBuffer : public std::streambuf {
+    private:
+        int m_fd;
+        // tells the input thread to stop waiting for input
+        int m_stop_fd;
+        SpscByteRing m_ring;
+        // bytes of the ring handed out as the get area
+        size_t m_peeked;
+        std::thread m_thread;
+    public:
+        explicit PipelinedInputStreamBuffer(int fd);
+        ~PipelinedInputStreamBuffer() override;
+
+    protected:
+        int_type underflow() override;
+        // what is there without waiting, -1 at the end of the input
+        std::streamsize showmanyc() override;
+
+    private:
+        void ReadInput_();
+    };
+
+    // OutputSink writing to a file descriptor on a thread of its own.
+    // Full buffers go into a SpscByteRing which the output thread writes out, so that printing many lines to a
+    // slow terminal or pipe overlaps with the commands which follow. The output keeps its order; the sink only
+    // waits for the thread when the ring is full and when it is destroyed.
+    class PipelinedOutputSink : public OutputSink {
+    private:
+        int m_fd;
+        SpscByteRing m_ring;
+        std::thread m_thread;
+    public:
+        explicit PipelinedOutputSink(int fd);
+        // writes out everything
+        ~PipelinedOutputSink() override;
+
+    protected:
+        void Write_(const char *data, size_t size) override;
+
+    private:
+        void WriteOutput_();
+    };
+}
@@ -0,0 +1,1019 @@
+#include "regex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+namespace MyEd {
+    namespace {
+        constexpr const size_t UNBOUNDED = std::numeric_limits<size_t>::max();
+        // groups nested deeper than this are refused, the parser and the compiler recurse into them
+        constexpr const size_t MAX_NESTING = 1000;
+
+        // kinds of the byte before a position, all assertions need to know about it
+        constexpr const uint8_t FLAG_LINE_BEGIN = 1;
+        constexpr const uint8_t FLAG_WORD = 2;
+
+        bool IsWordByte(int byte) {
+            return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') ||
+                   byte == '_';
+        }
+
+        std::bitset<256> CharsWhere(bool (*predicate)(int)) {
+            std::bitset<256> chars;
+            for (int byte = 0; byte < 256; ++byte) {
+                chars[byte] = predicate(byte);
+            }
+            return chars;
+        }
+
+        bool IsDigitByte(int byte) {
+            return byte >= '0' && byte <= '9';
+        }
+
+        bool IsSpaceByte(int byte) {
+            return byte == ' ' || (byte >= '\t' && byte <= '\r');
+        }
+
+        // the classes of the form [:name:] inside brackets, over ASCII like in the C locale
+        struct BracketClass {
+            const char *name;
+            bool (*predicate)(int);
+        };
+
+        const BracketClass BRACKET_CLASSES[] = {
+                {"alnum",  [](int byte) { return byte < 128 && std::isalnum(byte) != 0; }},
+                {"alpha",  [](int byte) { return byte < 128 && std::isalpha(byte) != 0; }},
+                {"blank",  [](int byte) { return byte == ' ' || byte == '\t'; }},
+                {"cntrl",  [](int byte) { return byte < 128 && std::iscntrl(byte) != 0; }},
+                {"digit",  IsDigitByte},
+                {"d",      IsDigitByte},
+                {"graph",  [](int byte) { return byte < 128 && std::isgraph(byte) != 0; }},
+                {"lower",  [](int byte) { return byte < 128 && std::islower(byte) != 0; }},
+                {"print",  [](int byte) { return byte < 128 && std::isprint(byte) != 0; }},
+                {"punct",  [](int byte) { return byte < 128 && std::ispunct(byte) != 0; }},
+                {"space",  IsSpaceByte},
+                {"s",      IsSpaceByte},
+                {"upper",  [](int byte) { return byte < 128 && std::isupper(byte) != 0; }},
+                {"w",      IsWordByte},
+                {"xdigit", [](int byte) { return byte < 128 && std::isxdigit(byte) != 0; }},
+        };
+
+        bool AssertionHolds(RegexAssertion assertion, bool prev_line_begin, bool prev_word, int next_byte) {
+            bool next_word = next_byte >= 0 && IsWordByte(next_byte);
+            switch (assertion) {
+                case RegexAssertion::LINE_BEGIN:
+                    return prev_line_begin;
+                case RegexAssertion::LINE_END:
+                    return next_byte < 0 || next_byte == '\n';
+                case RegexAssertion::WORD_BOUNDARY:
+                    return prev_word != next_word;
+                case RegexAssertion::NOT_WORD_BOUNDARY:
+                    return prev_word == next_word;
+            }
+            return false;
+        }
+
+        struct Node {
+            enum class Kind {
+                EMPTY,
+                CHAR_SET,
+                CONCAT,
+                ALTERNATE,
+                REPEAT,
+                GROUP,
+                ASSERT
+            };
+
+            Kind kind = Kind::EMPTY;
+            std::bitset<256> chars;
+            std::vector<std::unique_ptr<Node>> children;
+            size_t min = 0;
+            size_t max = 0;
+            bool greedy = true;
+            // 1-based index of a capture group, 0 for (?:)
+            size_t group = 0;
+            RegexAssertion assertion = RegexAssertion::LINE_BEGIN;
+        };
+
+        std::unique_ptr<Node> MakeNode(Node::Kind kind) {
+            auto node = std::make_unique<Node>();
+            node->kind = kind;
+            return node;
+        }
+
+        // recursive descent over the ECMAScript grammar
+        class Parser {
+        private:
+            const std::string &m_pattern;
+            size_t m_pos;
+            size_t m_group_count;
+            size_t m_depth;
+        public:
+            explicit Parser(const std::string &pattern) : m_pattern(pattern), m_pos(0), m_group_count(0), m_depth(0) {}
+
+            std::unique_ptr<Node> Parse() {
+                std::unique_ptr<Node> node = ParseAlternation_();
+                if (m_pos != m_pattern.size()) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                return node;
+            }
+
+            [[nodiscard]] size_t GetGroupCount() const {
+                return m_group_count;
+            }
+
+        private:
+            [[noreturn]] void Fail_(const char *message) const {
+                throw std::runtime_error(message + m_pattern);
+            }
+
+            [[nodiscard]] bool AtEnd_() const {
+                return m_pos >= m_pattern.size();
+            }
+
+            [[nodiscard]] char Peek_() const {
+                return m_pattern[m_pos];
+            }
+
+            std::unique_ptr<Node> ParseAlternation_() {
+                std::unique_ptr<Node> first = ParseConcat_();
+                if (AtEnd_() || Peek_() != '|') {
+                    return first;
+                }
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::ALTERNATE);
+                node->children.push_back(std::move(first));
+                while (!AtEnd_() && Peek_() == '|') {
+                    ++m_pos;
+                    node->children.push_back(ParseConcat_());
+                }
+                return node;
+            }
+
+            std::unique_ptr<Node> ParseConcat_() {
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::CONCAT);
+                while (!AtEnd_() && Peek_() != '|' && Peek_() != ')') {
+                    node->children.push_back(ParseRepeat_());
+                }
+                return node;
+            }
+
+            std::unique_ptr<Node> ParseRepeat_() {
+                std::unique_ptr<Node> atom = ParseAtom_();
+                size_t min;
+                size_t max;
+                if (!ParseQuantifier_(min, max)) {
+                    return atom;
+                }
+                if (atom->kind == Node::Kind::ASSERT) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::REPEAT);
+                node->min = min;
+                node->max = max;
+                if (!AtEnd_() && Peek_() == '?') {
+                    node->greedy = false;
+                    ++m_pos;
+                }
+                node->children.push_back(std::move(atom));
+                // a quantifier of a quantifier has nothing to repeat
+                if (ParseQuantifier_(min, max)) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                return node;
+            }
+
+            // *, +, ? or {n}, {n,}, {n,m}; a { which starts none of them is an ordinary character
+            bool ParseQuantifier_(size_t &min, size_t &max) {
+                if (AtEnd_()) {
+                    return false;
+                }
+                switch (Peek_()) {
+                    case '*':
+                        ++m_pos;
+                        min = 0;
+                        max = UNBOUNDED;
+                        return true;
+                    case '+':
+                        ++m_pos;
+                        min = 1;
+                        max = UNBOUNDED;
+                        return true;
+                    case '?':
+                        ++m_pos;
+                        min = 0;
+                        max = 1;
+                        return true;
+                    case '{':
+                        return ParseCounts_(min, max);
+                    default:
+                        return false;
+                }
+            }
+
+            bool ParseCounts_(size_t &min, size_t &max) {
+                size_t pos = m_pos + 1;
+                auto parse_number = [this, &pos](size_t &number) {
+                    size_t begin = pos;
+                    number = 0;
+                    for (; pos < m_pattern.size() && IsDigitByte(m_pattern[pos]); ++pos) {
+                        // anything this large is refused when it is compiled
+                        number = std::min(number * 10 + static_cast<size_t>(m_pattern[pos] - '0'),
+                                          RegexConstant::MAX_PROGRAM_SIZE);
+                    }
+                    return pos != begin;
+                };
+                if (!parse_number(min)) {
+                    return false;
+                }
+                max = min;
+                if (pos < m_pattern.size() && m_pattern[pos] == ',') {
+                    ++pos;
+                    if (!parse_number(max)) {
+                        max = UNBOUNDED;
+                    }
+                }
+                if (pos >= m_pattern.size() || m_pattern[pos] != '}') {
+                    return false;
+                }
+                if (max < min) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                m_pos = pos + 1;
+                return true;
+            }
+
+            std::unique_ptr<Node> ParseAtom_() {
+                char ch = Peek_();
+                ++m_pos;
+                switch (ch) {
+                    case '(':
+                        return ParseGroup_();
+                    case '[':
+                        return ParseClass_();
+                    case '.': {
+                        std::unique_ptr<Node> node = MakeNode(Node::Kind::CHAR_SET);
+                        node->chars.set();
+                        node->chars.reset('\n');
+                        node->chars.reset('\r');
+                        return node;
+                    }
+                    case '^':
+                    case '$': {
+                        std::unique_ptr<Node> node = MakeNode(Node::Kind::ASSERT);
+                        node->assertion = ch == '^' ? RegexAssertion::LINE_BEGIN : RegexAssertion::LINE_END;
+                        return node;
+                    }
+                    case '\\':
+                        return ParseEscape_();
+                    case '*':
+                    case '+':
+                    case '?':
+                        Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                    case '{': {
+                        size_t min;
+                        size_t max;
+                        --m_pos;
+                        if (ParseCounts_(min, max)) {
+                            Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                        }
+                        ++m_pos;
+                        return Literal_(ch);
+                    }
+                    default:
+                        return Literal_(ch);
+                }
+            }
+
+            static std::unique_ptr<Node> Literal_(char ch) {
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::CHAR_SET);
+                node->chars.set(static_cast<uint8_t>(ch));
+                return node;
+            }
+
+            std::unique_ptr<Node> ParseGroup_() {
+                if (++m_depth > MAX_NESTING) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_TOO_BIG);
+                }
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::GROUP);
+                if (!AtEnd_() && Peek_() == '?') {
+                    if (m_pos + 1 < m_pattern.size() && m_pattern[m_pos + 1] == ':') {
+                        m_pos += 2;
+                    } else {
+                        Fail_(RegexConstant::EXCEPTION_MESSAGE_UNSUPPORTED);
+                    }
+                } else {
+                    node->group = ++m_group_count;
+                }
+                node->children.push_back(ParseAlternation_());
+                if (AtEnd_() || Peek_() != ')') {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                ++m_pos;
+                --m_depth;
+                return node;
+            }
+
+            std::unique_ptr<Node> ParseEscape_() {
+                if (AtEnd_()) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                char ch = Peek_();
+                if (ch == 'b' || ch == 'B') {
+                    ++m_pos;
+                    std::unique_ptr<Node> node = MakeNode(Node::Kind::ASSERT);
+                    node->assertion = ch == 'b' ? RegexAssertion::WORD_BOUNDARY : RegexAssertion::NOT_WORD_BOUNDARY;
+                    return node;
+                }
+                if (ch >= '1' && ch <= '9') {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_UNSUPPORTED);
+                }
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::CHAR_SET);
+                node->chars = ParseEscapedChars_(false);
+                return node;
+            }
+
+            // the characters of the escape sequence at m_pos, the one after the backslash
+            std::bitset<256> ParseEscapedChars_(bool in_class) {
+                char ch = Peek_();
+                ++m_pos;
+                std::bitset<256> chars;
+                switch (ch) {
+                    case 'd':
+                        return CharsWhere(IsDigitByte);
+                    case 'D':
+                        return ~CharsWhere(IsDigitByte);
+                    case 'w':
+                        return CharsWhere(IsWordByte);
+                    case 'W':
+                        return ~CharsWhere(IsWordByte);
+                    case 's':
+                        return CharsWhere(IsSpaceByte);
+                    case 'S':
+                        return ~CharsWhere(IsSpaceByte);
+                    case 'n':
+                        chars.set('\n');
+                        return chars;
+                    case 't':
+                        chars.set('\t');
+                        return chars;
+                    case 'r':
+                        chars.set('\r');
+                        return chars;
+                    case 'f':
+                        chars.set('\f');
+                        return chars;
+                    case 'v':
+                        chars.set('\v');
+                        return chars;
+                    case '0':
+                        chars.set(0);
+                        return chars;
+                    case 'b':
+                        // only reaches here inside a class, where it is a backspace
+                        chars.set('\b');
+                        return chars;
+                    case 'x': {
+                        int value = 0;
+                        for (int i = 0; i < 2; ++i) {
+                            int digit = AtEnd_() ? -1 : HexValue_(Peek_());
+                            if (digit < 0) {
+                                Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                            }
+                            value = value * 16 + digit;
+                            ++m_pos;
+                        }
+                        chars.set(static_cast<size_t>(value));
+                        return chars;
+                    }
+                    case 'u': {
+                        int value = 0;
+                        for (int i = 0; i < 4; ++i) {
+                            int digit = AtEnd_() ? -1 : HexValue_(Peek_());
+                            if (digit < 0) {
+                                Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                            }
+                            value = value * 16 + digit;
+                            ++m_pos;
+                        }
+                        // text is matched byte by byte, other code points take more than one
+                        if (value >= 0x80) {
+                            Fail_(RegexConstant::EXCEPTION_MESSAGE_UNSUPPORTED);
+                        }
+                        chars.set(static_cast<size_t>(value));
+                        return chars;
+                    }
+                    case 'c':
+                        if (AtEnd_() || !std::isalpha(static_cast<unsigned char>(Peek_()))) {
+                            Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                        }
+                        chars.set(static_cast<uint8_t>(m_pattern[m_pos++]) % 32);
+                        return chars;
+                    default:
+                        if (!in_class && ch >= '1' && ch <= '9') {
+                            Fail_(RegexConstant::EXCEPTION_MESSAGE_UNSUPPORTED);
+                        }
+                        chars.set(static_cast<uint8_t>(ch));
+                        return chars;
+                }
+            }
+
+            static int HexValue_(char ch) {
+                if (ch >= '0' && ch <= '9') {
+                    return ch - '0';
+                }
+                if (ch >= 'a' && ch <= 'f') {
+                    return ch - 'a' + 10;
+                }
+                if (ch >= 'A' && ch <= 'F') {
+                    return ch - 'A' + 10;
+                }
+                return -1;
+            }
+
+            std::unique_ptr<Node> ParseClass_() {
+                std::unique_ptr<Node> node = MakeNode(Node::Kind::CHAR_SET);
+                bool negated = !AtEnd_() && Peek_() == '^';
+                if (negated) {
+                    ++m_pos;
+                }
+                while (!AtEnd_() && Peek_() != ']') {
+                    bool first_named = AtBracketClass_();
+                    bool single;
+                    std::bitset<256> first = ParseClassAtom_(single);
+                    bool range = m_pos + 1 < m_pattern.size() && Peek_() == '-' && m_pattern[m_pos + 1] != ']';
+                    // unlike \d, a [:name:] class cannot be the end of a range
+                    if (range && (first_named || AtBracketClass_(m_pos + 1))) {
+                        Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                    }
+                    if (single && range) {
+                        ++m_pos;
+                        bool last_single;
+                        std::bitset<256> last = ParseClassAtom_(last_single);
+                        if (last_single) {
+                            size_t from = FirstOf_(first);
+                            size_t to = FirstOf_(last);
+                            if (from > to) {
+                                Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                            }
+                            for (size_t byte = from; byte <= to; ++byte) {
+                                node->chars.set(byte);
+                            }
+                            continue;
+                        }
+                        // like [a-\d], a dash next to a class stands for itself
+                        node->chars |= last;
+                        node->chars.set('-');
+                    }
+                    node->chars |= first;
+                }
+                if (AtEnd_()) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                ++m_pos;
+                if (negated) {
+                    node->chars.flip();
+                }
+                return node;
+            }
+
+            // whether a class like [:digit:] starts at pos
+            [[nodiscard]] bool AtBracketClass_(size_t pos) const {
+                return pos + 1 < m_pattern.size() && m_pattern[pos] == '[' && m_pattern[pos + 1] == ':';
+            }
+
+            [[nodiscard]] bool AtBracketClass_() const {
+                return AtBracketClass_(m_pos);
+            }
+
+            // single is false for the classes like \d and [:digit:]
+            std::bitset<256> ParseClassAtom_(bool &single) {
+                char ch = Peek_();
+                ++m_pos;
+                if (ch == '[' && !AtEnd_() && (Peek_() == ':' || Peek_() == '=' || Peek_() == '.')) {
+                    return ParseBracketExpression_(single);
+                }
+                if (ch != '\\') {
+                    single = true;
+                    std::bitset<256> chars;
+                    chars.set(static_cast<uint8_t>(ch));
+                    return chars;
+                }
+                if (AtEnd_()) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                std::bitset<256> chars = ParseEscapedChars_(true);
+                single = chars.count() == 1;
+                return chars;
+            }
+
+            // [:name:], [=c=] or [.c.] at m_pos, the one after the opening bracket
+            std::bitset<256> ParseBracketExpression_(bool &single) {
+                char kind = Peek_();
+                size_t begin = m_pos + 1;
+                size_t end = begin;
+                while (end + 1 < m_pattern.size() && !(m_pattern[end] == kind && m_pattern[end + 1] == ']')) {
+                    ++end;
+                }
+                if (end + 1 >= m_pattern.size()) {
+                    Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+                }
+                std::string_view name(m_pattern.data() + begin, end - begin);
+                m_pos = end + 2;
+                std::bitset<256> chars;
+                if (kind != ':') {
+                    // equivalence classes and collating elements of more than one character need a locale
+                    if (name.size() != 1) {
+                        Fail_(RegexConstant::EXCEPTION_MESSAGE_UNSUPPORTED);
+                    }
+                    single = true;
+                    chars.set(static_cast<uint8_t>(name.front()));
+                    return chars;
+                }
+                for (const BracketClass &bracket_class: BRACKET_CLASSES) {
+                    if (name == bracket_class.name) {
+                        single = false;
+                        return CharsWhere(bracket_class.predicate);
+                    }
+                }
+                Fail_(RegexConstant::EXCEPTION_MESSAGE_INVALID);
+            }
+
+            static size_t FirstOf_(const std::bitset<256> &chars) {
+                size_t byte = 0;
+                while (!chars[byte]) {
+                    ++byte;
+                }
+                return byte;
+            }
+        };
+
+        // emits the program back to front: the code of a node is made knowing where it goes on afterwards
+        class Compiler {
+        private:
+            RegexProgram &m_program;
+            const std::string &m_pattern;
+            bool m_reverse;
+        public:
+            Compiler(RegexProgram &program, const std::string &pattern, bool reverse)
+                    : m_program(program), m_pattern(pattern), m_reverse(reverse) {}
+
+            uint32_t Emit(RegexOp op, uint32_t arg, uint32_t out, uint32_t out1) {
+                if (m_program.instructions.size() >= RegexConstant::MAX_PROGRAM_SIZE) {
+                    throw std::runtime_error(RegexConstant::EXCEPTION_MESSAGE_TOO_BIG + m_pattern);
+                }
+                m_program.instructions.push_back({op, arg, out, out1});
+                return static_cast<uint32_t>(m_program.instructions.size() - 1);
+            }
+
+            uint32_t EmitCharSet(const std::bitset<256> &chars, uint32_t next) {
+                m_program.char_sets.push_back(chars);
+                return Emit(RegexOp::CHAR_SET, static_cast<uint32_t>(m_program.char_sets.size() - 1), next, 0);
+            }
+
+            // start of the code matching node and going on at next
+            uint32_t Compile(const Node &node, uint32_t next) {
+                switch (node.kind) {
+                    case Node::Kind::EMPTY:
+                        return next;
+                    case Node::Kind::CHAR_SET:
+                        return EmitCharSet(node.chars, next);
+                    case Node::Kind::CONCAT:
+                        // the reversed pattern matches the parts the other way round
+                        if (m_reverse) {
+                            for (const auto &child: node.children) {
+                                next = Compile(*child, next);
+                            }
+                        } else {
+                            for (auto itr = node.children.rbegin(); itr != node.children.rend(); ++itr) {
+                                next = Compile(**itr, next);
+                            }
+                        }
+                        return next;
+                    case Node::Kind::ALTERNATE: {
+                        std::vector<uint32_t> starts;
+                        for (const auto &child: node.children) {
+                            starts.push_back(Compile(*child, next));
+                        }
+                        uint32_t start = starts.back();
+                        for (size_t i = starts.size() - 1; i-- > 0;) {
+                            start = Emit(RegexOp::SPLIT, 0, starts[i], start);
+                        }
+                        return start;
+                    }
+                    case Node::Kind::GROUP:
+                        if (node.group == 0 || m_reverse) {
+                            return Compile(*node.children[0], next);
+                        } else {
+                            uint32_t end = Emit(RegexOp::SAVE, static_cast<uint32_t>(2 * node.group + 1), next, 0);
+                            uint32_t body = Compile(*node.children[0], end);
+                            return Emit(RegexOp::SAVE, static_cast<uint32_t>(2 * node.group), body, 0);
+                        }
+                    case Node::Kind::ASSERT: {
+                        RegexAssertion assertion = node.assertion;
+                        if (m_reverse && assertion == RegexAssertion::LINE_BEGIN) {
+                            assertion = RegexAssertion::LINE_END;
+                        } else if (m_reverse && assertion == RegexAssertion::LINE_END) {
+                            assertion = RegexAssertion::LINE_BEGIN;
+                        }
+                        return Emit(RegexOp::ASSERT, static_cast<uint32_t>(assertion), next, 0);
+                    }
+                    case Node::Kind::REPEAT:
+                        return CompileRepeat_(node, next);
+                }
+                return next;
+            }
+
+        private:
+            uint32_t Branch_(bool greedy, uint32_t body, uint32_t skip) {
+                return greedy ? Emit(RegexOp::SPLIT, 0, body, skip) : Emit(RegexOp::SPLIT, 0, skip, body);
+            }
+
+            uint32_t CompileRepeat_(const Node &node, uint32_t next) {
+                const Node &child = *node.children[0];
+                uint32_t tail = next;
+                size_t copies = node.min;
+                if (node.max == UNBOUNDED) {
+                    // the loop is emitted first, so that its body can go back to it
+                    uint32_t loop = Emit(RegexOp::SPLIT, 0, 0, 0);
+                    uint32_t body = Compile(child, loop);
+                    RegexInstruction &instruction = m_program.instructions[loop];
+                    instruction.out = node.greedy ? body : next;
+                    instruction.out1 = node.greedy ? next : body;
+                    // x{n,} is n - 1 times x and then x+, which enters the loop through its body
+                    tail = node.min == 0 ? loop : body;
+                    copies = node.min == 0 ? 0 : node.min - 1;
+                } else {
+                    // x{n,m} is n times x and then (x(x(...)?)?)? with m - n optional ones
+                    for (size_t i = node.min; i < node.max; ++i) {
+                        tail = Branch_(node.greedy, Compile(child, tail), next);
+                    }
+                }
+                for (size_t i = 0; i < copies; ++i) {
+                    tail = Compile(child, tail);
+                }
+                return tail;
+            }
+        };
+
+        // leftmost-first match of program anchored at begin, with the positions of its capture slots
+        bool RunPikeVm(const RegexProgram &program, uint32_t start, std::string_view text, size_t begin,
+                       std::vector<size_t> &slots) {
+            struct Thread {
+                uint32_t pc;
+                std::vector<size_t> slots;
+            };
+            struct Frame {
+                uint32_t pc;
+                // a slot to restore instead of an instruction to follow
+                bool restore;
+                uint32_t slot;
+                size_t value;
+            };
+            std::vector<uint32_t> visited(program.instructions.size(), 0);
+            uint32_t generation = 0;
+            std::vector<Frame> stack;
+            auto byte_at = [&text](size_t pos) {
+                return pos < text.size() ? static_cast<int>(static_cast<uint8_t>(text[pos])) : RegexConstant::NO_BYTE;
+            };
+            // follow the instructions which consume nothing from pc at pos, in priority order
+            auto add_thread = [&](std::vector<Thread> &threads, uint32_t pc, std::vector<size_t> thread_slots,
+                                  size_t pos) {
+                int prev_byte = pos > 0 ? byte_at(pos - 1) : RegexConstant::NO_BYTE;
+                int next_byte = byte_at(pos);
+                bool prev_line_begin = prev_byte < 0 || prev_byte == '\n';
+                bool prev_word = prev_byte >= 0 && IsWordByte(prev_byte);
+                stack.push_back({pc, false, 0, 0});
+                while (!stack.empty()) {
+                    Frame frame = stack.back();
+                    stack.pop_back();
+                    if (frame.restore) {
+                        thread_slots[frame.slot] = frame.value;
+                        continue;
+                    }
+                    if (visited[frame.pc] == generation) {
+                        continue;
+                    }
+                    visited[frame.pc] = generation;
+                    const RegexInstruction &instruction = program.instructions[frame.pc];
+                    switch (instruction.op) {
+                        case RegexOp::JUMP:
+                            stack.push_back({instruction.out, false, 0, 0});
+                            break;
+                        case RegexOp::SPLIT:
+                            stack.push_back({instruction.out1, false, 0, 0});
+                            stack.push_back({instruction.out, false, 0, 0});
+                            break;
+                        case RegexOp::SAVE:
+                            stack.push_back({0, true, instruction.arg, thread_slots[instruction.arg]});
+                            thread_slots[instruction.arg] = pos;
+                            stack.push_back({instruction.out, false, 0, 0});
+                            break;
+                        case RegexOp::ASSERT:
+                            if (AssertionHolds(static_cast<RegexAssertion>(instruction.arg), prev_line_begin,
+                                               prev_word, next_byte)) {
+                                stack.push_back({instruction.out, false, 0, 0});
+                            }
+                            break;
+                        case RegexOp::CHAR_SET:
+                        case RegexOp::MATCH:
+                            threads.push_back({frame.pc, thread_slots});
+                            break;
+                    }
+                }
+            };
+
+            std::vector<Thread> current;
+            std::vector<Thread> next;
+            ++generation;
+            add_thread(current, start, std::vector<size_t>(slots.size(), std::string::npos), begin);
+            bool matched = false;
+            for (size_t pos = begin; !current.empty(); ++pos) {
+                int byte = byte_at(pos);
+                ++generation;
+                for (Thread &thread: current) {
+                    const RegexInstruction &instruction = program.instructions[thread.pc];
+                    if (instruction.op == RegexOp::MATCH) {
+                        // threads of lower priority are never tried
+                        slots = std::move(thread.slots);
+                        slots[0] = begin;
+                        slots[1] = pos;
+                        matched = true;
+                        break;
+                    }
+                    if (byte >= 0 && program.char_sets[instruction.arg][static_cast<size_t>(byte)]) {
+                        add_thread(next, instruction.out, std::move(thread.slots), pos + 1);
+                    }
+                }
+                current.swap(next);
+                next.clear();
+                if (byte < 0) {
+                    break;
+                }
+            }
+            return matched;
+        }
+    }
+
+    ////////////////////////////////// RegexDfa //////////////////////////////////
+    RegexDfa::RegexDfa(const RegexProgram &program, bool longest, const std::array<uint8_t, 256> &byte_classes,
+                       size_t class_count)
+            : m_program(program),
+              m_longest(longest),
+              m_byte_classes(byte_classes),
+              m_class_count(class_count),
+              m_starts(),
+              m_visited(program.instructions.size(), 0),
+              m_generation(0) {
+        m_starts.fill(nullptr);
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    const RegexDfa::State *RegexDfa::GetStart(int prev_byte) {
+        uint8_t flags = FlagsOf_(prev_byte);
+        if (m_starts[flags] == nullptr) {
+            const State *start = Intern_({m_program.start}, flags, false);
+            m_starts[flags] = start;
+        }
+        return m_starts[flags];
+    }
+
+    bool RegexDfa::Scan(const State *&state, const char *data, size_t size, size_t &match_end) {
+        const State *current = state;
+        for (size_t i = 0; i < size; ++i) {
+            current = Step(current, static_cast<uint8_t>(data[i]));
+            if (current->match) {
+                match_end = i;
+            }
+            if (IsDead(current)) {
+                state = current;
+                return false;
+            }
+        }
+        state = current;
+        return true;
+    }
+
+    bool RegexDfa::ScanBackward(const State *&state, const char *data, size_t size, size_t &match_end) {
+        const State *current = state;
+        for (size_t i = size; i-- > 0;) {
+            current = Step(current, static_cast<uint8_t>(data[i]));
+            if (current->match) {
+                match_end = i + 1;
+            }
+            if (IsDead(current)) {
+                state = current;
+                return false;
+            }
+        }
+        state = current;
+        return true;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    const RegexDfa::State *RegexDfa::ComputeNext_(const State *state, int byte, size_t byte_class) {
+        bool prev_line_begin = (state->flags & FLAG_LINE_BEGIN) != 0;
+        bool prev_word = (state->flags & FLAG_WORD) != 0;
+        if (++m_generation == 0) {
+            std::fill(m_visited.begin(), m_visited.end(), 0);
+            m_generation = 1;
+        }
+        // the threads in priority order follow what consumes nothing, those which may consume byte move past
+        // it, and a match drops all threads after it unless the longest match is wanted
+        std::vector<uint32_t> threads;
+        bool match = false;
+        bool cut = false;
+        for (size_t i = 0; i < state->threads.size() && !cut; ++i) {
+            m_stack.push_back(state->threads[i]);
+            while (!m_stack.empty()) {
+                uint32_t pc = m_stack.back();
+                m_stack.pop_back();
+                if (m_visited[pc] == m_generation) {
+                    continue;
+                }
+                m_visited[pc] = m_generation;
+                const RegexInstruction &instruction = m_program.instructions[pc];
+                switch (instruction.op) {
+                    case RegexOp::CHAR_SET:
+                        if (byte >= 0 && m_program.char_sets[instruction.arg][static_cast<size_t>(byte)]) {
+                            threads.push_back(instruction.out);
+                        }
+                        break;
+                    case RegexOp::SPLIT:
+                        m_stack.push_back(instruction.out1);
+                        m_stack.push_back(instruction.out);
+                        break;
+                    case RegexOp::JUMP:
+                    case RegexOp::SAVE:
+                        m_stack.push_back(instruction.out);
+                        break;
+                    case RegexOp::ASSERT:
+                        if (AssertionHolds(static_cast<RegexAssertion>(instruction.arg), prev_line_begin, prev_word,
+                                           byte)) {
+                            m_stack.push_back(instruction.out);
+                        }
+                        break;
+                    case RegexOp::MATCH:
+                        match = true;
+                        if (!m_longest) {
+                            m_stack.clear();
+                            cut = true;
+                        }
+                        break;
+                }
+            }
+        }
+        // the same thread reached twice only counts once, as the first time
+        std::vector<uint32_t> unique_threads;
+        unique_threads.reserve(threads.size());
+        if (++m_generation == 0) {
+            std::fill(m_visited.begin(), m_visited.end(), 0);
+            m_generation = 1;
+        }
+        for (uint32_t pc: threads) {
+            if (m_visited[pc] != m_generation) {
+                m_visited[pc] = m_generation;
+                unique_threads.push_back(pc);
+            }
+        }
+
+        size_t state_count = m_states.size();
+        const State *next = Intern_(std::move(unique_threads), FlagsOf_(byte), match);
+        // unless all states were just dropped, state among them
+        bool dropped = state_count >= RegexConstant::MAX_DFA_STATES && m_states.size() == 1;
+        if (!dropped) {
+            state->next[byte_class] = next;
+        }
+        return next;
+    }
+
+    const RegexDfa::State *RegexDfa::Intern_(std::vector<uint32_t> &&threads, uint8_t flags, bool match) {
+        std::string key(reinterpret_cast<const char *>(threads.data()), threads.size() * sizeof(uint32_t));
+        key.push_back(static_cast<char>(flags));
+        key.push_back(static_cast<char>(match));
+        auto itr = m_index.find(key);
+        if (itr != m_index.end()) {
+            return itr->second;
+        }
+        if (m_states.size() >= RegexConstant::MAX_DFA_STATES) {
+            m_index.clear();
+            m_states.clear();
+            m_starts.fill(nullptr);
+        }
+        m_states.push_back({std::move(threads), flags, match, std::vector<const State *>(m_class_count + 1, nullptr)});
+        const State *state = &m_states.back();
+        m_index.emplace(std::move(key), state);
+        return state;
+    }
+
+    uint8_t RegexDfa::FlagsOf_(int byte) {
+        uint8_t flags = 0;
+        if (byte < 0 || byte == '\n') {
+            flags |= FLAG_LINE_BEGIN;
+        }
+        if (byte >= 0 && IsWordByte(byte)) {
+            flags |= FLAG_WORD;
+        }
+        return flags;
+    }
+
+    ////////////////////////////////// Regex //////////////////////////////////
+    Regex::Regex(const std::string &pattern) : m_pattern_start(0), m_group_count(0), m_byte_classes(), m_class_count(0) {
+        Parser parser(pattern);
+        std::unique_ptr<Node> root = parser.Parse();
+        m_group_count = parser.GetGroupCount();
+
+        Compiler forward(m_forward, pattern, false);
+        m_pattern_start = forward.Compile(*root, forward.Emit(RegexOp::MATCH, 0, 0, 0));
+        // .*? in front, tried after every thread which started before
+        uint32_t loop = forward.Emit(RegexOp::SPLIT, 0, m_pattern_start, 0);
+        m_forward.instructions[loop].out1 = forward.EmitCharSet(std::bitset<256>().set(), loop);
+        m_forward.start = loop;
+
+        Compiler reverse(m_reverse, pattern, true);
+        m_reverse.start = reverse.Compile(*root, reverse.Emit(RegexOp::MATCH, 0, 0, 0));
+
+        // bytes no char set and no assertion tells apart share their transitions
+        std::vector<std::bitset<256>> sets = m_forward.char_sets;
+        sets.push_back(CharsWhere(IsWordByte));
+        sets.push_back(std::bitset<256>().set('\n'));
+        std::bitset<256> boundaries;
+        for (const auto &chars: sets) {
+            for (size_t byte = 1; byte < 256; ++byte) {
+                if (chars[byte] != chars[byte - 1]) {
+                    boundaries.set(byte);
+                }
+            }
+        }
+        for (size_t byte = 1; byte < 256; ++byte) {
+            m_byte_classes[byte] = static_cast<uint8_t>(m_byte_classes[byte - 1] + (boundaries[byte] ? 1 : 0));
+        }
+        m_class_count = static_cast<size_t>(m_byte_classes[255]) + 1;
+
+        m_forward_dfa = std::make_unique<RegexDfa>(m_forward, false, m_byte_classes, m_class_count);
+        m_reverse_dfa = std::make_unique<RegexDfa>(m_reverse, true, m_byte_classes, m_class_count);
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    size_t Regex::GetGroupCount() const {
+        return m_group_count;
+    }
+
+    bool Regex::Search(std::string_view text, size_t from, size_t &match_begin, size_t &match_end) {
+        auto byte_at = [&text](size_t pos) {
+            return static_cast<int>(static_cast<uint8_t>(text[pos]));
+        };
+        size_t size = text.size() - from;
+        size_t end = std::string::npos;
+        const RegexDfa::State *state = m_forward_dfa->GetStart(from > 0 ? byte_at(from - 1) : RegexConstant::NO_BYTE);
+        if (m_forward_dfa->Scan(state, text.data() + from, size, end)) {
+            if (m_forward_dfa->Step(state, RegexConstant::NO_BYTE)->match) {
+                end = size;
+            }
+        }
+        if (end == std::string::npos) {
+            return false;
+        }
+
+        // the leftmost match is the longest one of the reversed pattern ending where it does
+        size_t begin = end;
+        state = m_reverse_dfa->GetStart(from + end < text.size() ? byte_at(from + end) : RegexConstant::NO_BYTE);
+        if (m_reverse_dfa->ScanBackward(state, text.data() + from, end, begin)) {
+            if (m_reverse_dfa->Step(state, from > 0 ? byte_at(from - 1) : RegexConstant::NO_BYTE)->match) {
+                begin = 0;
+            }
+        }
+        match_begin = from + begin;
+        match_end = from + end;
+        return true;
+    }
+
+    void Regex::GetGroups(std::string_view text, size_t match_begin, std::vector<size_t> &groups) const {
+        groups.assign(2 * (m_group_count + 1), std::string::npos);
+        RunPikeVm(m_forward, m_pattern_start, text, match_begin, groups);
+    }
+
+    RegexDfa &Regex::GetForwardDfa() {
+        return *m_forward_dfa;
+    }
+
+    RegexDfa &Regex::GetReverseDfa() {
+        return *m_reverse_dfa;
+    }
+
+    ////////////////////////////////// RegexCache //////////////////////////////////
+    RegexCache::RegexCache() : m_cache(RegexConstant::CACHE_SIZE) {}
+
+    RegexCache &RegexCache::Instance() {
+        thread_local RegexCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<Regex> RegexCache::Get(const std::string &pattern) {
+        return m_cache.Get(pattern, [&pattern]() {
+            return std::make_shared<Regex>(pattern);
+        });
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "lru_cache.h"
+
+namespace MyEd {
+
+    class RegexConstant {
+    public:
+        // compiled patterns kept per thread
+        constexpr static const size_t CACHE_SIZE = 64;
+        // states one automaton keeps before it drops them all and builds them again as they are reached
+        constexpr static const size_t MAX_DFA_STATES = 4096;
+        // instructions of a compiled pattern, bounds what counted repetitions expand to
+        constexpr static const size_t MAX_PROGRAM_SIZE = 1 << 16;
+        // the byte before the start or after the end of the text
+        constexpr static const int NO_BYTE = -1;
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_INVALID = "Invalid regular expression: ";
+        constexpr static inline const char *EXCEPTION_MESSAGE_UNSUPPORTED =
+                "Back references, lookarounds and characters beyond ASCII are not supported: ";
+        constexpr static inline const char *EXCEPTION_MESSAGE_TOO_BIG = "Regular expression too big: ";
+    };
+
+    enum class RegexOp : uint8_t {
+        // consume a byte of char_sets[arg]
+        CHAR_SET,
+        // go on at out, and with lower priority at out1
+        SPLIT,
+        JUMP,
+        // remember the position in capture slot arg
+        SAVE,
+        // go on only where RegexAssertion arg holds
+        ASSERT,
+        MATCH
+    };
+
+    enum class RegexAssertion : uint8_t {
+        LINE_BEGIN,
+        LINE_END,
+        WORD_BOUNDARY,
+        NOT_WORD_BOUNDARY
+    };
+
+    struct RegexInstruction {
+        RegexOp op;
+        uint32_t arg;
+        uint32_t out;
+        uint32_t out1;
+    };
+
+    // Thompson NFA of a pattern, run either as a lazily built DFA or, for capture groups, as a Pike VM
+    struct RegexProgram {
+        std::vector<RegexInstruction> instructions;
+        std::vector<std::bitset<256>> char_sets;
+        uint32_t start = 0;
+    };
+
+    // DFA built from a RegexProgram while it runs: a state is the ordered list of NFA threads alive at a
+    // position, and a transition is only worked out the first time it is taken, so that no pattern costs more
+    // than linear time, and a text takes one table lookup per byte once its states are known.
+    // Assertions depend on the bytes around a position, so a state also knows the kind of byte which led to it.
+    // With leftmost-first priorities, threads of lower priority than a match are dropped, as a backtracking
+    // engine would never try them; otherwise every thread goes on to find the longest match.
+    class RegexDfa {
+    public:
+        struct State {
+            std::vector<uint32_t> threads;
+            uint8_t flags;
+            // a match ended right before the byte which led to this state
+            bool match;
+            // per byte class and one for the end of the text, null until taken for the first time
+            mutable std::vector<const State *> next;
+        };
+
+    private:
+        const RegexProgram &m_program;
+        bool m_longest;
+        const std::array<uint8_t, 256> &m_byte_classes;
+        size_t m_class_count;
+        std::deque<State> m_states;
+        std::unordered_map<std::string, const State *> m_index;
+        // per kind of byte before the start
+        std::array<const State *, 4> m_starts;
+        // scratch of the closure
+        std::vector<uint32_t> m_visited;
+        uint32_t m_generation;
+        std::vector<uint32_t> m_stack;
+    public:
+        RegexDfa(const RegexProgram &program, bool longest, const std::array<uint8_t, 256> &byte_classes,
+                 size_t class_count);
+
+        RegexDfa(const RegexDfa &) = delete;
+        RegexDfa &operator=(const RegexDfa &) = delete;
+
+        // the state before the first byte, prev_byte is the one before it or NO_BYTE
+        const State *GetStart(int prev_byte);
+        // the state after byte, NO_BYTE for the end of the text. States from before are invalid afterwards.
+        const State *Step(const State *state, int byte) {
+            size_t byte_class = byte < 0 ? m_class_count : m_byte_classes[static_cast<uint8_t>(byte)];
+            const State *next = state->next[byte_class];
+            return next != nullptr ? next : ComputeNext_(state, byte, byte_class);
+        }
+
+        // step over size bytes from data, or from data + size - 1 down to data when backward.
+        // match_end is set to the offset of the last match ended before a byte (after it when backward).
+        // Returns false as soon as no further match is possible.
+        bool Scan(const State *&state, const char *data, size_t size, size_t &match_end);
+        bool ScanBackward(const State *&state, const char *data, size_t size, size_t &match_end);
+
+        static bool IsDead(const State *state) {
+            return state->threads.empty();
+        }
+
+    private:
+        const State *ComputeNext_(const State *state, int byte, size_t byte_class);
+        // add the state or find the one there is, dropping all states first when there are too many
+        const State *Intern_(std::vector<uint32_t> &&threads, uint8_t flags, bool match);
+        static uint8_t FlagsOf_(int byte);
+    };
+
+    // Regular expression in the ECMAScript syntax, without back references and lookarounds, found in linear
+    // time: a forward DFA finds where the leftmost match ends, a DFA of the reversed pattern where it starts.
+    // ^ and $ match at line boundaries. Not thread-safe, the automata are built while they run.
+    // Where a quantified group can match the empty string, e.g. (a*?)+, the match may differ from the one a
+    // backtracking engine finds, as threads are never tried twice at a position.
+    class Regex {
+    private:
+        // with a lowest priority .*? in front, so that it finds matches anywhere
+        RegexProgram m_forward;
+        RegexProgram m_reverse;
+        // where the pattern itself starts in m_forward
+        uint32_t m_pattern_start;
+        size_t m_group_count;
+        std::array<uint8_t, 256> m_byte_classes;
+        size_t m_class_count;
+        std::unique_ptr<RegexDfa> m_forward_dfa;
+        std::unique_ptr<RegexDfa> m_reverse_dfa;
+    public:
+        // throws std::runtime_error for patterns which are invalid or not supported
+        explicit Regex(const std::string &pattern);
+
+        Regex(const Regex &) = delete;
+        Regex &operator=(const Regex &) = delete;
+
+        [[nodiscard]] size_t GetGroupCount() const;
+
+        // the leftmost match in text starting at or after from, [match_begin, match_end)
+        bool Search(std::string_view text, size_t from, size_t &match_begin, size_t &match_end);
+        // offsets of the groups of the match at match_begin, groups[2 * i] and groups[2 * i + 1] for group i
+        // (0 is the whole match), std::string::npos for groups which did not take part
+        void GetGroups(std::string_view text, size_t match_begin, std::vector<size_t> &groups) const;
+
+        // finds match ends, for searches over text in pieces
+        RegexDfa &GetForwardDfa();
+        // finds the start of a match from its end, running backward
+        RegexDfa &GetReverseDfa();
+    };
+
+    // compiled patterns most recently used on this thread
+    class RegexCache {
+    private:
+        LruCache<Regex> m_cache;
+
+        RegexCache();
+    public:
+        // one per thread
+        static RegexCache &Instance();
+
+        std::shared_ptr<Regex> Get(const std::string &pattern);
+    };
+}
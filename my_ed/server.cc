@@ -0,0 +1,306 @@
+#include "server.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace MyEd {
+    namespace {
+        volatile std::sig_atomic_t g_stop_requested = 0;
+
+        void RequestStop(int) {
+            g_stop_requested = 1;
+        }
+    }
+
+    Server::Server(std::string socket_path)
+            : m_socket_path(std::move(socket_path)),
+              m_listen_fd(-1),
+              m_epoll_fd(-1),
+              m_running(false) {}
+
+    Server::~Server() {
+        for (auto &connection: m_connections) {
+            close(connection.first);
+        }
+        for (auto &buffer: m_buffers) {
+            buffer.second->editor->Destroys();
+        }
+        if (m_listen_fd >= 0) {
+            close(m_listen_fd);
+            unlink(m_socket_path.c_str());
+        }
+        if (m_epoll_fd >= 0) {
+            close(m_epoll_fd);
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    void Server::Run() {
+        // no SA_RESTART, epoll_wait has to return EINTR so that the loop sees the request
+        struct sigaction action{};
+        action.sa_handler = RequestStop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        Listen_();
+        m_running = true;
+        epoll_event events[ServerConstant::MAX_EVENTS];
+        while (m_running && g_stop_requested == 0) {
+            int event_count = epoll_wait(m_epoll_fd, events, ServerConstant::MAX_EVENTS, -1);
+            if (event_count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string(ServerConstant::EXCEPTION_MESSAGE_SOCKET_FAILED) +
+                                         std::strerror(errno));
+            }
+            for (int i = 0; i < event_count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == m_listen_fd) {
+                    Accept_();
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    Read_(fd);
+                }
+                if (m_connections.count(fd) != 0 && (events[i].events & EPOLLOUT)) {
+                    Write_(fd);
+                }
+            }
+        }
+
+        // best effort to deliver what is already queued, e.g. the answer to SHUTDOWN
+        std::vector<int> fds;
+        for (auto &connection: m_connections) {
+            fds.push_back(connection.first);
+        }
+        for (int fd: fds) {
+            Write_(fd);
+        }
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    void Server::Listen_() {
+        sockaddr_un address{};
+        if (m_socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error(std::string(ServerConstant::EXCEPTION_MESSAGE_SOCKET_FAILED) +
+                                     std::strerror(ENAMETOOLONG));
+        }
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, m_socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_listen_fd < 0 || m_epoll_fd < 0) {
+            throw std::runtime_error(std::string(ServerConstant::EXCEPTION_MESSAGE_SOCKET_FAILED) +
+                                     std::strerror(errno));
+        }
+        // a stale socket file of a previous run would make bind fail
+        unlink(m_socket_path.c_str());
+        if (bind(m_listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            listen(m_listen_fd, ServerConstant::LISTEN_BACKLOG) < 0) {
+            throw std::runtime_error(std::string(ServerConstant::EXCEPTION_MESSAGE_SOCKET_FAILED) +
+                                     std::strerror(errno));
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = m_listen_fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &event);
+    }
+
+    void Server::Accept_() {
+        while (true) {
+            int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            m_connections.emplace(fd, Connection());
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+
+    void Server::Read_(int fd) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "Server::Read_");
+        Connection &connection = m_connections[fd];
+        char buffer[ServerConstant::READ_BUFFER_SIZE];
+        while (true) {
+            ssize_t read_size = read(fd, buffer, sizeof(buffer));
+            if (read_size > 0) {
+                connection.in_buffer.append(buffer, static_cast<size_t>(read_size));
+                continue;
+            }
+            if (read_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (read_size < 0 && errno == EINTR) {
+                continue;
+            }
+            // peer finished sending (or failed), answer what it has sent and close afterwards
+            connection.closing = true;
+            break;
+        }
+        HandleRequests_(connection);
+        Write_(fd);
+    }
+
+    void Server::Write_(int fd) {
+        MYED_TRACE_SCOPE(TraceConstant::CATEGORY_IO, "Server::Write_");
+        auto itr = m_connections.find(fd);
+        if (itr == m_connections.end()) {
+            return;
+        }
+        Connection &connection = itr->second;
+        while (connection.out_offset < connection.out_buffer.size()) {
+            ssize_t written = send(fd, connection.out_buffer.data() + connection.out_offset,
+                                   connection.out_buffer.size() - connection.out_offset, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                Close_(fd);
+                return;
+            }
+            connection.out_offset += static_cast<size_t>(written);
+        }
+        if (connection.out_offset == connection.out_buffer.size()) {
+            connection.out_buffer.clear();
+            connection.out_offset = 0;
+            if (connection.closing) {
+                Close_(fd);
+                return;
+            }
+        }
+        UpdateInterest_(fd);
+    }
+
+    void Server::Close_(int fd) {
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        m_connections.erase(fd);
+    }
+
+    void Server::UpdateInterest_(int fd) {
+        const Connection &connection = m_connections[fd];
+        epoll_event event{};
+        event.events = connection.closing ? 0 : EPOLLIN | EPOLLRDHUP;
+        if (!connection.out_buffer.empty()) {
+            event.events |= EPOLLOUT;
+        }
+        event.data.fd = fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    void Server::HandleRequests_(Connection &connection) {
+        std::string &in_buffer = connection.in_buffer;
+        size_t pos = 0;
+        while (true) {
+            size_t header_end = in_buffer.find('\n', pos);
+            if (header_end == std::string::npos) {
+                break;
+            }
+            std::string header = in_buffer.substr(pos, header_end - pos);
+
+            if (StringUtil::Match(header, ServerConstant::REQUEST_SHUTDOWN)) {
+                m_running = false;
+                AppendResponse_(connection, ServerConstant::RESPONSE_OK, EditorConstants::EMPTY_STRING);
+                pos = header_end + 1;
+                continue;
+            }
+
+            std::smatch smatch_header;
+            size_t line_count = 0;
+            bool good_header = StringUtil::Match(header, ServerConstant::REQUEST_BATCH, smatch_header);
+            if (good_header) {
+                const std::string count = smatch_header[1];
+                auto result = std::from_chars(count.data(), count.data() + count.size(), line_count);
+                good_header = result.ec == std::errc() && result.ptr == count.data() + count.size() &&
+                              line_count <= ServerConstant::MAX_BATCH_LINE_COUNT;
+            }
+            if (!good_header) {
+                // the stream cannot be resynchronized after a bad header
+                AppendResponse_(connection, ServerConstant::RESPONSE_ERROR, ServerConstant::STR_BAD_REQUEST);
+                connection.closing = true;
+                pos = in_buffer.size();
+                break;
+            }
+
+            // wait until the whole batch has arrived
+            size_t payload_end = header_end + 1;
+            bool complete = true;
+            for (size_t i = 0; i < line_count; ++i) {
+                size_t line_end = in_buffer.find('\n', payload_end);
+                if (line_end == std::string::npos) {
+                    complete = false;
+                    break;
+                }
+                payload_end = line_end + 1;
+            }
+            if (!complete) {
+                break;
+            }
+
+            try {
+                std::string output = ExecuteBatch_(smatch_header[2], in_buffer.substr(header_end + 1,
+                                                                                      payload_end - header_end - 1));
+                AppendResponse_(connection, ServerConstant::RESPONSE_OK, output);
+            } catch (const std::exception &ex) {
+                AppendResponse_(connection, ServerConstant::RESPONSE_ERROR, ex.what());
+            }
+            pos = payload_end;
+        }
+        in_buffer.erase(0, pos);
+    }
+
+    std::string Server::ExecuteBatch_(const std::string &file_name, const std::string &payload) {
+        std::string prologue;
+        auto itr = m_buffers.find(file_name);
+        if (itr == m_buffers.end()) {
+            // the file is loaded and parsed once, later batches reuse the resident editor
+            auto buffer = std::make_unique<ResidentBuffer>();
+            buffer->editor = std::make_unique<Editor>(buffer->input, buffer->output);
+            if (!buffer->editor->Init(file_name)) {
+                prologue = std::string(ServerConstant::STR_FILE_OPEN_FAILED) + "\n";
+            }
+            itr = m_buffers.emplace(file_name, std::move(buffer)).first;
+        }
+
+        ResidentBuffer &buffer = *itr->second;
+        buffer.input.clear();
+        buffer.input.str(payload);
+        buffer.output << prologue;
+        bool keep_editor = buffer.editor->Run();
+        std::string output = buffer.output.TakeString();
+        if (!keep_editor) {
+            // q or Q unloads the buffer
+            buffer.editor->Destroys();
+            m_buffers.erase(itr);
+        }
+        return output;
+    }
+
+    void Server::AppendResponse_(Connection &connection, const char *status, const std::string &body) {
+        connection.out_buffer.append(status);
+        connection.out_buffer.append(std::to_string(body.size()));
+        connection.out_buffer.push_back('\n');
+        connection.out_buffer.append(body);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "editor.h"
+
+namespace MyEd {
+
+    class ServerConstant {
+    public:
+        constexpr static const int LISTEN_BACKLOG = 128;
+        constexpr static const int MAX_EVENTS = 64;
+        constexpr static const size_t READ_BUFFER_SIZE = 1 << 16;
+        // most lines a batch may announce, larger counts are bad requests
+        constexpr static const size_t MAX_BATCH_LINE_COUNT = 1 << 24;
+
+        // BATCH <line_count> <file_name>\n followed by line_count lines of commands and inserted text
+        constexpr static inline const char *REQUEST_BATCH = R"(^BATCH (\d+) ([\s\S]+)$)";
+        // stops the server once every pending response is sent
+        constexpr static inline const char *REQUEST_SHUTDOWN = "^SHUTDOWN$";
+        // OK <byte_count>\n followed by the output of the batch
+        constexpr static inline const char *RESPONSE_OK = "OK ";
+        constexpr static inline const char *RESPONSE_ERROR = "ERR ";
+
+        constexpr static inline const char *STR_BAD_REQUEST = "Bad request.";
+        constexpr static inline const char *STR_FILE_OPEN_FAILED = "File does not exist, opened a new file.";
+        constexpr static inline const char *EXCEPTION_MESSAGE_SOCKET_FAILED = "Cannot listen on socket: ";
+    };
+
+    // Daemon which keeps Editor instances resident, one per file name, and executes command batches sent by
+    // any number of clients over a Unix domain socket.
+    // A single epoll loop owns all editors, so batches against one buffer are executed one after another and
+    // never interleave. Clients may pipeline batches, responses come back in request order.
+    class Server {
+    private:
+        struct Connection {
+            std::string in_buffer;
+            std::string out_buffer;
+            size_t out_offset = 0;
+            bool closing = false;
+        };
+
+        struct ResidentBuffer {
+            std::istringstream input;
+            StringOutputSink output;
+            std::unique_ptr<Editor> editor;
+        };
+
+        std::string m_socket_path;
+        int m_listen_fd;
+        int m_epoll_fd;
+        bool m_running;
+        std::unordered_map<int, Connection> m_connections;
+        std::unordered_map<std::string, std::unique_ptr<ResidentBuffer>> m_buffers;
+    public:
+        explicit Server(std::string socket_path);
+        ~Server();
+
+        Server(const Server &) = delete;
+        Server &operator=(const Server &) = delete;
+
+        // serve until SIGINT/SIGTERM or a SHUTDOWN request
+        void Run();
+
+    private:
+        void Listen_();
+        void Accept_();
+        void Read_(int fd);
+        void Write_(int fd);
+        void Close_(int fd);
+        void UpdateInterest_(int fd);
+
+        // execute every complete request of the connection input, queueing responses in order
+        void HandleRequests_(Connection &connection);
+        std::string ExecuteBatch_(const std::string &file_name, const std::string &payload);
+
+        static void AppendResponse_(Connection &connection, const char *status, const std::string &body);
+    };
+}
@@ -0,0 +1,273 @@
+#include "session_record.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "editor.h"
+
+namespace MyEd {
+    namespace {
+        void WriteNumber(std::ostream &output, uint64_t number) {
+            do {
+                auto byte = static_cast<uint8_t>(number & 0x7f);
+                number >>= 7;
+                if (number != 0) {
+                    byte |= 0x80;
+                }
+                output.put(static_cast<char>(byte));
+            } while (number != 0);
+        }
+
+        bool ReadNumber(std::string_view &data, uint64_t &number) {
+            number = 0;
+            for (unsigned shift = 0; shift < 64 && !data.empty(); shift += 7) {
+                auto byte = static_cast<uint8_t>(data.front());
+                data.remove_prefix(1);
+                number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool ReadString(std::string_view &data, std::string &text) {
+            uint64_t size = 0;
+            if (!ReadNumber(data, size) || size > data.size()) {
+                return false;
+            }
+            text.assign(data.data(), static_cast<size_t>(size));
+            data.remove_prefix(static_cast<size_t>(size));
+            return true;
+        }
+
+        std::string FormatMilliseconds(uint64_t duration_ns) {
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(3) << std::setw(14) << static_cast<double>(duration_ns) / 1e6;
+            return text.str();
+        }
+
+        // change from the recorded to the replayed time in percent
+        std::string FormatDelta(uint64_t recorded_ns, uint64_t replayed_ns) {
+            std::ostringstream text;
+            if (recorded_ns == 0) {
+                text << std::setw(10) << SessionRecordConstant::STR_NO_DELTA;
+            } else {
+                double delta = (static_cast<double>(replayed_ns) - static_cast<double>(recorded_ns)) * 100 /
+                               static_cast<double>(recorded_ns);
+                text << std::fixed << std::setprecision(1) << std::showpos << std::setw(9) << delta << '%';
+            }
+            return text.str();
+        }
+    }
+
+    ////////////////////////////////// RecordingStreamBuffer //////////////////////////////////
+    RecordingStreamBuffer::RecordingStreamBuffer(std::streambuf *source)
+            : m_source(source),
+              m_buffer(SessionRecordConstant::INPUT_BUFFER_SIZE),
+              m_mark(nullptr),
+              m_wait_ns(0) {}
+
+    std::streambuf *RecordingStreamBuffer::GetSource() const {
+        return m_source;
+    }
+
+    std::string RecordingStreamBuffer::TakeConsumed() {
+        if (m_mark != nullptr) {
+            m_consumed.append(m_mark, gptr());
+            m_mark = gptr();
+        }
+        std::string consumed;
+        consumed.swap(m_consumed);
+        return consumed;
+    }
+
+    uint64_t RecordingStreamBuffer::TakeWaitTime() {
+        uint64_t wait_ns = m_wait_ns;
+        m_wait_ns = 0;
+        return wait_ns;
+    }
+
+    ////////////////////////////////// Protected //////////////////////////////////
+    RecordingStreamBuffer::int_type RecordingStreamBuffer::underflow() {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (m_mark != nullptr) {
+            m_consumed.append(m_mark, gptr());
+        }
+        // wait for one byte, then take what came with it
+        bool waits = m_source->in_avail() == 0;
+        auto start = std::chrono::steady_clock::now();
+        int_type ch = m_source->sbumpc();
+        if (waits) {
+            m_wait_ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return ch;
+        }
+        m_buffer[0] = traits_type::to_char_type(ch);
+        std::streamsize count = 1;
+        std::streamsize available = m_source->in_avail();
+        if (available > 0) {
+            count += m_source->sgetn(m_buffer.data() + 1,
+                                     std::min(available, static_cast<std::streamsize>(m_buffer.size() - 1)));
+        }
+        setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + count);
+        m_mark = m_buffer.data();
+        return ch;
+    }
+
+    std::streamsize RecordingStreamBuffer::showmanyc() {
+        return m_source->in_avail();
+    }
+
+    ////////////////////////////////// SessionRecorder //////////////////////////////////
+    SessionRecorder::SessionRecorder() : m_input(nullptr) {}
+
+    SessionRecorder::SessionRecorder(const std::string &file_name)
+            : m_file(file_name, std::ios::binary | std::ios::trunc),
+              m_input(nullptr) {
+        if (!m_file) {
+            throw std::runtime_error(std::string(SessionRecordConstant::EXCEPTION_MESSAGE_CANNOT_WRITE_RECORDING) +
+                                     file_name + ": " + std::strerror(errno));
+        }
+        m_file << SessionRecordConstant::MAGIC;
+        m_file.flush();
+    }
+
+    SessionRecorder::~SessionRecorder() {
+        if (m_input != nullptr) {
+            m_input->rdbuf(m_input_buffer->GetSource());
+        }
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    void SessionRecorder::Attach(std::istream &input) {
+        if (m_input != nullptr) {
+            m_input->rdbuf(m_input_buffer->GetSource());
+        }
+        m_input_buffer = std::make_unique<RecordingStreamBuffer>(input.rdbuf());
+        input.rdbuf(m_input_buffer.get());
+        m_input = &input;
+    }
+
+    std::string SessionRecorder::TakeInput() {
+        return m_input_buffer == nullptr ? std::string() : m_input_buffer->TakeConsumed();
+    }
+
+    uint64_t SessionRecorder::TakeWaitTime() {
+        return m_input_buffer == nullptr ? 0 : m_input_buffer->TakeWaitTime();
+    }
+
+    void SessionRecorder::Record(const std::string &command, const std::string &input, uint64_t duration_ns) {
+        if (!m_file.is_open()) {
+            m_commands.push_back({command, input, duration_ns});
+            return;
+        }
+        WriteNumber(m_file, duration_ns);
+        WriteNumber(m_file, command.size());
+        m_file << command;
+        WriteNumber(m_file, input.size());
+        m_file << input;
+        // written out right away, so that a crash does not lose the commands which led to it
+        m_file.flush();
+    }
+
+    const std::vector<RecordedCommand> &SessionRecorder::GetCommands() const {
+        return m_commands;
+    }
+
+    std::vector<RecordedCommand> SessionRecorder::Load(const std::string &file_name) {
+        std::ifstream file(file_name, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error(std::string(SessionRecordConstant::EXCEPTION_MESSAGE_CANNOT_READ_RECORDING) +
+                                     file_name + ": " + std::strerror(errno));
+        }
+        std::string content(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+        std::string_view data(content);
+        std::string_view magic(SessionRecordConstant::MAGIC);
+        if (data.substr(0, magic.size()) != magic) {
+            throw std::runtime_error(std::string(SessionRecordConstant::EXCEPTION_MESSAGE_CANNOT_READ_RECORDING) +
+                                     file_name);
+        }
+        data.remove_prefix(magic.size());
+        std::vector<RecordedCommand> commands;
+        while (!data.empty()) {
+            RecordedCommand recorded;
+            if (!ReadNumber(data, recorded.duration_ns) || !ReadString(data, recorded.command) ||
+                !ReadString(data, recorded.input)) {
+                // the end of a recording cut short
+                break;
+            }
+            commands.push_back(std::move(recorded));
+        }
+        return commands;
+    }
+
+    ////////////////////////////////// SessionReplayer //////////////////////////////////
+    bool SessionReplayer::Replay(const std::string &recording_file_name, const std::string &file_name,
+                                 OutputSink &report) {
+        std::vector<RecordedCommand> recorded = SessionRecorder::Load(recording_file_name);
+        std::string script;
+        for (const RecordedCommand &command: recorded) {
+            script.append(command.command).append(1, '\n').append(command.input);
+        }
+
+        std::istringstream input(script);
+        int null_fd = open(SessionRecordConstant::NULL_DEVICE, O_WRONLY | O_CLOEXEC);
+        bool loaded;
+        SessionRecorder recorder;
+        {
+            FdOutputSink output(null_fd);
+            Editor editor(input, output);
+            recorder.Attach(input);
+            editor.SetRecorder(&recorder);
+            loaded = editor.Init(file_name);
+            editor.Run();
+            editor.Destroys();
+        }
+        if (null_fd >= 0) {
+            close(null_fd);
+        }
+
+        const std::vector<RecordedCommand> &replayed = recorder.GetCommands();
+        size_t count = std::min(recorded.size(), replayed.size());
+        uint64_t recorded_total = 0;
+        uint64_t replayed_total = 0;
+        size_t diverged = count;
+        report << SessionRecordConstant::STR_REPORT_HEADER << '\n';
+        for (size_t i = 0; i < count; ++i) {
+            if (recorded[i].command != replayed[i].command) {
+                diverged = i;
+                break;
+            }
+            recorded_total += recorded[i].duration_ns;
+            replayed_total += replayed[i].duration_ns;
+            std::ostringstream index;
+            index << std::setw(8) << i + 1;
+            report << index.str() << FormatMilliseconds(recorded[i].duration_ns)
+                   << FormatMilliseconds(replayed[i].duration_ns)
+                   << FormatDelta(recorded[i].duration_ns, replayed[i].duration_ns) << "  " << recorded[i].command
+                   << '\n';
+        }
+        report << SessionRecordConstant::STR_REPORT_TOTAL << FormatMilliseconds(recorded_total)
+               << FormatMilliseconds(replayed_total) << FormatDelta(recorded_total, replayed_total) << '\n';
+        bool same_commands = diverged == count && recorded.size() == replayed.size();
+        if (!same_commands) {
+            report << SessionRecordConstant::STR_DIVERGED << diverged + 1 << '\n';
+        }
+        report.Flush();
+        return loaded && same_commands;
+    }
+}
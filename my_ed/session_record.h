@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "output_sink.h"
+
+namespace MyEd {
+
+    class SessionRecordConstant {
+    public:
+        // first bytes of a recording, the version is bumped when the format changes
+        constexpr static inline const char *MAGIC = "MYED-SESSION 1\n";
+        // bytes of input passed through at a time
+        constexpr static const size_t INPUT_BUFFER_SIZE = 1 << 16;
+        constexpr static inline const char *NULL_DEVICE = "/dev/null";
+
+        constexpr static inline const char *STR_REPORT_HEADER = "       #   recorded ms   replayed ms     delta  command";
+        constexpr static inline const char *STR_REPORT_TOTAL = "   total";
+        constexpr static inline const char *STR_NO_DELTA = "n/a";
+        constexpr static inline const char *STR_DIVERGED = "The replay ran a different command at #";
+
+        constexpr static inline const char *EXCEPTION_MESSAGE_CANNOT_WRITE_RECORDING = "Cannot write recording: ";
+        constexpr static inline const char *EXCEPTION_MESSAGE_CANNOT_READ_RECORDING = "Cannot read recording: ";
+    };
+
+    // a command passed to Editor::InputCommand, with the input it read (inserted text, answers) and the time it took,
+    // not counting the time it waited for that input
+    struct RecordedCommand {
+        std::string command;
+        std::string input;
+        uint64_t duration_ns;
+    };
+
+    // streambuf passing the input of another one through, keeping the bytes which were read from it.
+    // It reads no more than the source has ready, so that interactive input is not held back.
+    class RecordingStreamBuffer : public std::streambuf {
+    private:
+        std::streambuf *m_source;
+        std::vector<char> m_buffer;
+        std::string m_consumed;
+        // start of the bytes of the get area not yet moved to m_consumed
+        char *m_mark;
+        // nanoseconds spent waiting for input which was not there yet
+        uint64_t m_wait_ns;
+    public:
+        explicit RecordingStreamBuffer(std::streambuf *source);
+
+        [[nodiscard]] std::streambuf *GetSource() const;
+        // bytes read since the last call
+        std::string TakeConsumed();
+        // time spent waiting for input since the last call, in nanoseconds
+        uint64_t TakeWaitTime();
+
+    protected:
+        int_type underflow() override;
+        std::streamsize showmanyc() override;
+    };
+
+    // Records the commands of a session, see Editor::SetRecorder.
+    // A recording is MAGIC followed by one entry per command: the duration in nanoseconds, then the command and
+    // its input, each as a length and the bytes; numbers are written as LEB128 varints. Entries are written as
+    // they come, so a recording cut short by a crash still holds what happened before it.
+    class SessionRecorder {
+    private:
+        std::ofstream m_file;
+        // kept when there is no file to write to
+        std::vector<RecordedCommand> m_commands;
+        std::istream *m_input;
+        std::unique_ptr<RecordingStreamBuffer> m_input_buffer;
+    public:
+        // records in memory only
+        SessionRecorder();
+        // throws std::runtime_error when the file cannot be written
+        explicit SessionRecorder(const std::string &file_name);
+        // gives the attached stream its own buffer back
+        ~SessionRecorder();
+
+        SessionRecorder(const SessionRecorder &) = delete;
+        SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+        // keep what is read from input from now on
+        void Attach(std::istream &input);
+        // input read from the attached stream since the last call
+        std::string TakeInput();
+        // nanoseconds spent waiting for the attached stream since the last call, e.g. while the user typed
+        // inserted text; they do not count for the time of a command
+        uint64_t TakeWaitTime();
+        void Record(const std::string &command, const std::string &input, uint64_t duration_ns);
+
+        [[nodiscard]] const std::vector<RecordedCommand> &GetCommands() const;
+
+        // throws std::runtime_error when the file cannot be read or is not a recording
+        static std::vector<RecordedCommand> Load(const std::string &file_name);
+    };
+
+    // Runs a recorded session again, against a given file, to compare the time every command takes with the
+    // recorded time. The commands and their input are fed to an Editor in the order they were recorded, their
+    // output goes to NULL_DEVICE. Commands which write files write them like in the recorded session, so the
+    // file to replay against is better a copy.
+    class SessionReplayer {
+    public:
+        // prints the latency of every command to report, false when the file could not be loaded or the
+        // replay did not run the recorded commands
+        static bool Replay(const std::string &recording_file_name, const std::string &file_name, OutputSink &report);
+    };
+}
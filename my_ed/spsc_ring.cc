@@ -0,0 +1,99 @@
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace MyEd {
+    SpscByteRing::SpscByteRing(size_t capacity) : m_capacity(1), m_head(0), m_tail(0), m_closed(false),
+                                                  m_sleepers(0) {
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_data = std::make_unique<char[]>(m_capacity);
+    }
+
+    ////////////////////////////////// Public //////////////////////////////////
+    bool SpscByteRing::Push(const char *data, size_t size) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        while (size > 0) {
+            Wait_([this, tail]() {
+                return tail - m_head.load(std::memory_order_acquire) < m_capacity ||
+                       m_closed.load(std::memory_order_acquire);
+            });
+            if (m_closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            size_t free_size = m_capacity - static_cast<size_t>(tail - m_head.load(std::memory_order_acquire));
+            size_t offset = static_cast<size_t>(tail) & (m_capacity - 1);
+            // up to the end of the memory, the rest goes to its start in the next round
+            size_t copy_size = std::min({size, free_size, m_capacity - offset});
+            std::memcpy(m_data.get() + offset, data, copy_size);
+            data += copy_size;
+            size -= copy_size;
+            tail += copy_size;
+            m_tail.store(tail, std::memory_order_release);
+            Wake_();
+        }
+        return true;
+    }
+
+    void SpscByteRing::Close() {
+        m_closed.store(true, std::memory_order_release);
+        Wake_();
+    }
+
+    size_t SpscByteRing::Peek(const char *&data) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        Wait_([this, head]() {
+            return m_tail.load(std::memory_order_acquire) != head || m_closed.load(std::memory_order_acquire);
+        });
+        // bytes pushed before closing are still handed out
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        size_t offset = static_cast<size_t>(head) & (m_capacity - 1);
+        data = m_data.get() + offset;
+        return std::min(static_cast<size_t>(tail - head), m_capacity - offset);
+    }
+
+    void SpscByteRing::Consume(size_t size) {
+        m_head.store(m_head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+        Wake_();
+    }
+
+    int64_t SpscByteRing::GetReadableSize() const {
+        // closed is read first: bytes pushed before closing are seen with it
+        bool closed = m_closed.load(std::memory_order_acquire);
+        auto size = static_cast<int64_t>(m_tail.load(std::memory_order_acquire) -
+                                         m_head.load(std::memory_order_relaxed));
+        return size == 0 && closed ? -1 : size;
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    template<typename Ready>
+    void SpscByteRing::Wait_(Ready &&ready) {
+        for (int i = 0; i < SpscRingConstant::SPIN_COUNT; ++i) {
+            if (ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        // announce the sleep before the last look, so that the other side either publishes before that look or
+        // sees the announcement after publishing (see Wake_)
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, ready);
+        }
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void SpscByteRing::Wake_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) != 0) {
+            // taking the mutex makes sure the sleeper is either still before its last look or already waiting
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_all();
+        }
+    }
+}
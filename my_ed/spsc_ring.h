@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace MyEd {
+
+    class SpscRingConstant {
+    public:
+        // attempts to find the other side done before going to sleep
+        constexpr static const int SPIN_COUNT = 64;
+        // keeps the producer and the consumer position on cache lines of their own
+        constexpr static const size_t CACHE_LINE_SIZE = 64;
+    };
+
+    // Bounded single-producer single-consumer queue of bytes between two threads.
+    // The sides only exchange the positions they have reached, through two atomics; a side which finds the ring
+    // full (empty) spins for a moment and then sleeps until the other side moves on. The mutex and condition
+    // variable behind the sleeping are only touched when a side actually sleeps.
+    // The consumer reads the bytes in place (Peek, then Consume), so handing them on costs no copy.
+    class SpscByteRing {
+    private:
+        std::unique_ptr<char[]> m_data;
+        // a power of two
+        size_t m_capacity;
+        // bytes consumed so far, only moved by the consumer
+        alignas(SpscRingConstant::CACHE_LINE_SIZE) std::atomic<uint64_t> m_head;
+        // bytes produced so far, only moved by the producer
+        alignas(SpscRingConstant::CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail;
+        alignas(SpscRingConstant::CACHE_LINE_SIZE) std::atomic<bool> m_closed;
+        std::atomic<int> m_sleepers;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+    public:
+        // capacity is rounded up to a power of two
+        explicit SpscByteRing(size_t capacity);
+
+        SpscByteRing(const SpscByteRing &) = delete;
+        SpscByteRing &operator=(const SpscByteRing &) = delete;
+
+        // producer: queue all of data, waiting for room; false if the ring was closed meanwhile
+        bool Push(const char *data, size_t size);
+        // either side: nothing more is pushed, a waiting side wakes up
+        void Close();
+
+        // consumer: wait for bytes and point data to the ones which follow each other in memory, 0 once the
+        // ring is closed and empty. They stay valid until Consume.
+        size_t Peek(const char *&data);
+        // consumer: done with the first size bytes
+        void Consume(size_t size);
+        // consumer: bytes there without waiting, -1 once the ring is closed and empty
+        [[nodiscard]] int64_t GetReadableSize() const;
+
+    private:
+        // wait until ready() holds
+        template<typename Ready>
+        void Wait_(Ready &&ready);
+        // the other side may be waiting for what was just published
+        void Wake_();
+    };
+}
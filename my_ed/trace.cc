@@ -0,0 +1,131 @@
+#include "trace.h"
+
+#ifdef MYED_WITH_TRACE
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+namespace MyEd {
+    ////////////////////////////////// Tracer //////////////////////////////////
+    Tracer::Tracer() : m_start_time(std::chrono::steady_clock::now()), m_written(false) {
+        const char *file_name = std::getenv(TraceConstant::FILE_NAME_ENV_VAR);
+        if (file_name != nullptr) {
+            m_file_name = file_name;
+        }
+    }
+
+    Tracer &Tracer::GetInstance() {
+        static Tracer *tracer = []() {
+            auto *new_tracer = new Tracer();
+            if (new_tracer->IsEnabled()) {
+                std::atexit(&Tracer::WriteFileAtExit_);
+            }
+            return new_tracer;
+        }();
+        return *tracer;
+    }
+
+    bool Tracer::IsEnabled() const {
+        return !m_file_name.empty();
+    }
+
+    uint64_t Tracer::GetTime() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start_time).count());
+    }
+
+    void Tracer::Record(const char *category, const char *name, std::string detail, uint64_t start, uint64_t end) {
+        uint64_t thread_id = GetThreadId_();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_written) {
+            return;
+        }
+        m_events.push_back({category, name, std::move(detail), thread_id, start, end - start});
+    }
+
+    ////////////////////////////////// Private //////////////////////////////////
+    uint64_t Tracer::GetThreadId_() {
+        static std::atomic<uint64_t> next_thread_id(1);
+        thread_local uint64_t thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+        return thread_id;
+    }
+
+    void Tracer::WriteFileAtExit_() {
+        GetInstance().WriteFile_();
+    }
+
+    void Tracer::WriteFile_() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_written = true;
+        FILE *file = std::fopen(m_file_name.c_str(), "w");
+        if (file == nullptr) {
+            return;
+        }
+        auto write_string = [file](const std::string &str) {
+            std::fputc('"', file);
+            for (char ch: str) {
+                auto byte = static_cast<unsigned char>(ch);
+                if (ch == '"' || ch == '\\') {
+                    std::fputc('\\', file);
+                    std::fputc(ch, file);
+                } else if (byte < 0x20) {
+                    std::fprintf(file, "\\u%04x", byte);
+                } else {
+                    std::fputc(ch, file);
+                }
+            }
+            std::fputc('"', file);
+        };
+        auto pid = static_cast<long>(getpid());
+        std::fputs("{\"traceEvents\":[", file);
+        for (size_t i = 0; i < m_events.size(); ++i) {
+            const Event &event = m_events[i];
+            // the format counts in microseconds, fractions keep the nanoseconds
+            std::fprintf(file, "%s\n{\"name\":", i == 0 ? "" : ",");
+            write_string(event.name);
+            std::fputs(",\"cat\":", file);
+            write_string(event.category);
+            std::fprintf(file, ",\"ph\":\"X\",\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64
+                               ",\"pid\":%ld,\"tid\":%" PRIu64,
+                         event.start / 1000, event.start % 1000, event.duration / 1000, event.duration % 1000,
+                         pid, event.thread_id);
+            if (!event.detail.empty()) {
+                std::fputs(",\"args\":{\"detail\":", file);
+                write_string(event.detail);
+                std::fputc('}', file);
+            }
+            std::fputc('}', file);
+        }
+        std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
+        std::fclose(file);
+        m_events.clear();
+        m_events.shrink_to_fit();
+    }
+
+    ////////////////////////////////// TraceScope //////////////////////////////////
+    TraceScope::TraceScope(const char *category, const char *name) : TraceScope(category, name, std::string()) {}
+
+    TraceScope::TraceScope(const char *category, const char *name, std::string detail)
+            : m_category(category),
+              m_name(name),
+              m_detail(std::move(detail)),
+              m_start(0),
+              m_enabled(Tracer::GetInstance().IsEnabled()) {
+        if (m_enabled) {
+            m_start = Tracer::GetInstance().GetTime();
+        }
+    }
+
+    TraceScope::~TraceScope() {
+        if (m_enabled) {
+            Tracer &tracer = Tracer::GetInstance();
+            tracer.Record(m_category, m_name, std::move(m_detail), m_start, tracer.GetTime());
+        }
+    }
+}
+
+#endif
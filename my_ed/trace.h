@@ -0,0 +1,100 @@
+#pragma once
+
+// Trace points around commands, File operations and I/O, written out in the Chrome trace event format so that
+// a session can be opened in chrome://tracing or ui.perfetto.dev.
+// They are only compiled in with -DMYED_WITH_TRACE, and only record anything when the environment variable
+// named by TraceConstant::FILE_NAME_ENV_VAR names the file to write the trace to. Without MYED_WITH_TRACE the
+// macros expand to nothing, arguments included.
+
+#ifdef MYED_WITH_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MyEd {
+
+    class TraceConstant {
+    public:
+        constexpr static inline const char *FILE_NAME_ENV_VAR = "MYED_TRACE_FILE";
+        constexpr static inline const char *CATEGORY_EDITOR = "editor";
+        constexpr static inline const char *CATEGORY_PARSE = "parse";
+        constexpr static inline const char *CATEGORY_FILE = "file";
+        constexpr static inline const char *CATEGORY_IO = "io";
+    };
+
+    // Process-wide collector of the recorded spans; the trace file is written at exit.
+    // The tracer itself is never destroyed, so that threads and static objects which outlive the writing can
+    // still pass trace points; what they record is dropped.
+    class Tracer {
+    private:
+        struct Event {
+            // string literals, so only the pointers are kept
+            const char *category;
+            const char *name;
+            std::string detail;
+            uint64_t thread_id;
+            // nanoseconds since the tracer started
+            uint64_t start;
+            uint64_t duration;
+        };
+
+        std::string m_file_name;
+        std::chrono::steady_clock::time_point m_start_time;
+        std::mutex m_mutex;
+        std::vector<Event> m_events;
+        bool m_written;
+
+        Tracer();
+    public:
+        Tracer(const Tracer &) = delete;
+        Tracer &operator=(const Tracer &) = delete;
+
+        static Tracer &GetInstance();
+
+        [[nodiscard]] bool IsEnabled() const;
+        [[nodiscard]] uint64_t GetTime() const;
+        void Record(const char *category, const char *name, std::string detail, uint64_t start, uint64_t end);
+
+    private:
+        // small numbers are easier to tell apart in a trace viewer than the ids of the system
+        static uint64_t GetThreadId_();
+        // registered with std::atexit
+        static void WriteFileAtExit_();
+        void WriteFile_();
+    };
+
+    // Records the time from its construction to its destruction as one span.
+    class TraceScope {
+    private:
+        const char *m_category;
+        const char *m_name;
+        std::string m_detail;
+        uint64_t m_start;
+        bool m_enabled;
+    public:
+        TraceScope(const char *category, const char *name);
+        TraceScope(const char *category, const char *name, std::string detail);
+        TraceScope(const TraceScope &) = delete;
+        TraceScope &operator=(const TraceScope &) = delete;
+        ~TraceScope();
+    };
+}
+
+#define MYED_TRACE_CONCAT_IMPL_(a, b) a##b
+#define MYED_TRACE_CONCAT_(a, b) MYED_TRACE_CONCAT_IMPL_(a, b)
+// a span from here to the end of the enclosing block
+#define MYED_TRACE_SCOPE(category, name) \
+    MyEd::TraceScope MYED_TRACE_CONCAT_(trace_scope_, __LINE__)(category, name)
+// the same, with a string shown as the detail of the span, e.g. the command
+#define MYED_TRACE_SCOPE_DETAIL(category, name, detail) \
+    MyEd::TraceScope MYED_TRACE_CONCAT_(trace_scope_, __LINE__)(category, name, detail)
+
+#else
+
+#define MYED_TRACE_SCOPE(category, name) static_cast<void>(0)
+#define MYED_TRACE_SCOPE_DETAIL(category, name, detail) static_cast<void>(0)
+
+#endif